@@ -0,0 +1,451 @@
+#include <sstream>
+#include <fstream>
+#include <set>
+#include <algorithm>
+#include "Assembler.h"
+#include "ModuleCache.h"
+#include "ProgramEditor.h"
+#include "DeadCodeEliminator.h"
+#include "PeepholeOptimizer.h"
+#include "DataflowOptimizer.h"
+#include "SubroutineInliner.h"
+#include "CodeOutliner.h"
+#include "BlockLayout.h"
+#include "Parser.h"
+
+namespace Assembler {
+	// Return the directory part of fileName, including its trailing slash, or an empty string if it has none.
+	static std::string getDirectory(const std::string &fileName) {
+		std::size_t slash = fileName.find_last_of("/\\");
+		return slash == std::string::npos ? "" : fileName.substr(0, slash + 1);
+	}
+
+	// Return true iff fileName is an absolute path (on either Unix or Windows).
+	static bool isAbsolutePath(const std::string &fileName) {
+		return fileName.size() > 0 && (fileName[0] == '/' || fileName[0] == '\\' || 
+			(fileName.size() > 1 && fileName[1] == ':'));
+	}
+
+	// Return the positive whole number written in text (the limit given to a ;bound or ;budget directive). Throws an
+	// exception if text isn't one.
+	static unsigned int parseLimit(const std::string &text) {
+		if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 9 ||
+			std::stoul(text) == 0) {
+			throw std::runtime_error("Expected a positive whole number, not " + text + ".");
+		}
+		return (unsigned int)std::stoul(text);
+	}
+
+	// Copy lines (from the file fileName, empty for the main source) into expanded, replacing each ;include 
+	// directive with the expanded lines of the file it names. includeStack holds the files currently being 
+	// included (to catch circular includes) and alreadyIncluded every file included so far (so that each is only
+	// included once).
+	static void expandIncludesFrom(const std::vector<SourceLine> &lines, const std::string &fileName, 
+			ModuleCache &moduleCache, std::vector<std::string> &includeStack, 
+			std::set<std::string> &alreadyIncluded, std::vector<SourceLine> &expanded, Result &result) {
+		for (const SourceLine &line : lines) {
+			// Pass everything except includes straight through, noting which file it came from.
+			if (line.parsedLine.size() == 0 || line.parsedLine[0] != ";include") {
+				expanded.push_back(line);
+				expanded.back().fileName = fileName;
+				continue;
+			}
+
+			try {
+				// Check that we were given a single, quoted file name.
+				if (line.parsedLine.size() != 2 || line.parsedLine[1].size() < 2 || 
+					line.parsedLine[1].front() != '"' || line.parsedLine[1].back() != '"') {
+					throw std::runtime_error("Include directive expects a single quoted file name.");
+				}
+
+				// Files are found relative to the file including them.
+				std::string includedFileName = line.parsedLine[1].substr(1, line.parsedLine[1].size() - 2);
+				if (!isAbsolutePath(includedFileName)) {
+					includedFileName = getDirectory(includeStack.back()) + includedFileName;
+				}
+
+				// Make sure we're not trying to include a file that's already in the middle of being 
+				// included, which would go on forever.
+				if (std::find(includeStack.begin(), includeStack.end(), includedFileName) != 
+					includeStack.end()) {
+					throw std::runtime_error("Circular include of " + includedFileName + ".");
+				}
+				// Each file is only ever included once.
+				if (alreadyIncluded.find(includedFileName) != alreadyIncluded.end()) {
+					continue;
+				}
+
+				// Read in the file.
+				std::ifstream includedFile(includedFileName);
+				if (!includedFile.good()) {
+					throw std::runtime_error("Could not open included file " + includedFileName + ".");
+				}
+				std::ostringstream contents;
+				contents << includedFile.rdbuf();
+
+				// Fetch it parsed from the cache, then expand any includes of its own.
+				IncludedFile included = {includedFileName, 0u};
+				std::shared_ptr<const std::vector<SourceLine> > module = 
+					moduleCache.getModule(contents.str(), included.contentHash);
+				alreadyIncluded.insert(includedFileName);
+				result.includedFiles.push_back(included);
+				includeStack.push_back(includedFileName);
+				expandIncludesFrom(*module, includedFileName, moduleCache, includeStack, alreadyIncluded,
+					expanded, result);
+				includeStack.pop_back();
+			}
+			catch (std::exception &e) {
+				result.diagnostics.push_back({"Directive error", line.lineNumber, e.what(), fileName});
+			}
+		}
+	}
+
+	// Second pass over the lines, actually translating instructions into machine code using the labels and 
+	// constants found by the first pass. Any problems are added to the diagnostics of result. Jumps are recorded as
+	// relocations iff doRecordRelocations is set.
+	static void translateInstructions(const std::vector<SourceLine> &lines, InstructionWriter &writer, 
+			bool doRecordRelocations, Result &result) {
+		for (const SourceLine &line : lines) {
+			// If line is empty, a label, or a directive, move on.
+			if (!isInstruction(line)) {
+				continue;
+			}
+
+			// Attempt to translate line into machine code. If attempt fails, record the problem and keep
+			// going so that every bad line gets reported at once.
+			Instruction translatedLine;
+			try {
+				writer.writeInstruction(translatedLine, line.parsedLine);
+			}
+			catch (std::exception &e) {
+				result.diagnostics.push_back({"Error", line.lineNumber, e.what(), line.fileName});
+				continue;
+			}
+			if (doRecordRelocations) {
+				for (const std::string &label : writer.getLabelReferences()) {
+					result.relocations.push_back({(unsigned int)result.machineCode.size(), label});
+				}
+			}
+			if (!writer.getAddressReferences().empty()) {
+				result.usesLabelAddresses = true;
+			}
+			result.machineCode.push_back(translatedLine);
+			result.sourceLocations.push_back({line.lineNumber, line.text, line.fileName});
+		}
+	}
+
+	// Return true iff the program was assembled without any problems.
+	bool Result::succeeded() const {
+		return this->diagnostics.size() == 0;
+	}
+
+	// Assemble the Shroom16 assembly program held in source (the full contents of a .asm file) into machine
+	// code. Never throws or exits on a bad program; all problems are reported through the diagnostics of the
+	// returned result instead.
+	Result assemble(const std::string &source, const Options &options) {
+		Result result;
+		// Every assembly gets its own writer, and with it its own labels and constants.
+		InstructionWriter writer;
+		writer.setAllowUndefinedLabels(options.relocatable);
+
+		// Break the source down into its components, pulling in any included files.
+		std::vector<SourceLine> lines;
+		tokenize(source, lines);
+		expandIncludes(lines, options, result);
+
+		// First pass through source; find and define constants and labels. If anything went wrong here, the
+		// second pass would only report a pile of undefined labels and constants, so stop now.
+		findConstantsAndLabels(lines, writer, result);
+		if (!result.succeeded()) {
+			return result;
+		}
+
+		// Fill in the program's initial data and check the loop bounds and budgets, now that every label is known.
+		fillDataMemory(lines, writer, options, result);
+		checkLimitLabels(lines, writer, result);
+
+		// Second pass over source, actually translate insturctions into machine code.
+		translateInstructions(lines, writer, needsRelocations(options), result);
+
+		finishResult(writer, options, result);
+		return result;
+	}
+
+	// Break source down into lines and parse each of them, overwriting lines.
+	void tokenize(const std::string &source, std::vector<SourceLine> &lines) {
+		lines.clear();
+		std::istringstream sourceStream(source);
+		// Current line of source.
+		std::string line;
+		// Keeps track of line number.
+		unsigned int lineNumber = 0;
+		while (std::getline(sourceStream, line)) {
+			// Increment line number.
+			lineNumber++;
+
+			// Remove comment from line.
+			Parser::stripComment(line);
+
+			// Parse line to examine its formatted components.
+			lines.push_back({lineNumber, line, {}, ""});
+			Parser::parseLine(line, lines.back().parsedLine);
+		}
+	}
+
+	// Replace every ;include directive in lines with the lines of the file it names, parsed (or fetched from the
+	// options' module cache), and with any includes of its own replaced in turn. Every file is only included once
+	// per program, no matter how many times it's named. Any problems (e.g. missing files or circular includes) are
+	// added to the diagnostics of result, and every file included is recorded in result.
+	void expandIncludes(std::vector<SourceLine> &lines, const Options &options, Result &result) {
+		// Use our own cache if we weren't given one to share.
+		ModuleCache ownModuleCache;
+		ModuleCache &moduleCache = options.moduleCache != nullptr ? *options.moduleCache : ownModuleCache;
+
+		// The main source sits at the bottom of the include stack, so that its includes are found relative to
+		// it.
+		std::vector<std::string> includeStack(1u, options.sourceFileName);
+		std::set<std::string> alreadyIncluded;
+		std::vector<SourceLine> expanded;
+		expandIncludesFrom(lines, "", moduleCache, includeStack, alreadyIncluded, expanded, result);
+		lines.swap(expanded);
+	}
+
+	// Pass over the lines recording constants and labels as they come up into writer. This can be thought of as
+	// the first pass over the source code. Any problems are added to the diagnostics of result.
+	void findConstantsAndLabels(const std::vector<SourceLine> &lines, InstructionWriter &writer, Result &result) {
+		// Keeps track of which instruction we're currently on, starting at zero.
+		unsigned int instructionNumber = 0;
+		for (const SourceLine &line : lines) {
+			const std::vector<std::string> &parsedLine = line.parsedLine;
+
+			// If line is empty, move on.
+			if (parsedLine.size() == 0) {
+				continue;
+			}
+
+			// Try to add label, if applicable.
+			try {
+				// If line is a label (labels start with ':'), add it along with current instruction number
+				// to map, then move on.
+				if (parsedLine[0][0] == ':') {
+					writer.defineLabel(parsedLine[0].substr(1, parsedLine[0].size() - 1),
+						instructionNumber);
+					continue;
+				}
+			}
+			catch (std::exception &e) {
+				result.diagnostics.push_back({"Error", line.lineNumber, e.what(), line.fileName});
+				continue;
+			}
+
+			try {
+				// If line is a directive, see if it's a constant definition, add to map if it is, then
+				// move on either way.
+				if (parsedLine[0][0] == ';') {
+					if (parsedLine[0] == ";const") {
+						// Check if complete constant definition was given, if not throw excpetion.
+						if (parsedLine.size() != 3) {
+							throw std::runtime_error("Invalid number of directive arguments.");
+						}
+
+						// Attempt to define constant.
+						writer.defineConstant(parsedLine[1], parsedLine[2]);
+					}
+					// Loop bounds and budgets don't change the program, they're only recorded for estimating how
+					// long it takes to run.
+					else if (parsedLine[0] == ";bound" || parsedLine[0] == ";budget") {
+						if (parsedLine.size() != 3) {
+							throw std::runtime_error("Invalid number of directive arguments.");
+						}
+						unsigned int limit = parseLimit(parsedLine[2]);
+						if (parsedLine[0] == ";bound") {
+							result.loopBounds[parsedLine[1]] = limit;
+						}
+						else {
+							result.budgets[parsedLine[1]] = limit;
+						}
+					}
+					// Initial data is only filled in once every label is known (see fillDataMemory()).
+					else if (parsedLine[0] == ";data" || parsedLine[0] == ";word") {
+					}
+					else {
+						// Otherwise, we have an undefined directive.
+						throw std::runtime_error("Unknown directive " + parsedLine[0] + ".");
+					}
+					continue;
+				}
+			}
+			catch (std::exception &e) {
+				result.diagnostics.push_back({"Directive error", line.lineNumber, e.what(), line.fileName});
+				continue;
+			}
+
+			// Otherwise, line is a instruction that will make it to instruction memory, and we need to
+			// increment our position.
+			instructionNumber++;
+		}
+	}
+
+	// Pass over the lines filling in the initial contents of data memory given by ;data and ;word directives into
+	// result, using the labels and constants found by the first pass in writer. ;data <address> moves on to address,
+	// and ;word <value> ... sets the words from there on, one after the other, starting from address zero. Any
+	// problems (e.g. data for addresses past the end of data memory, or set twice) are added to the diagnostics of
+	// result.
+	void fillDataMemory(const std::vector<SourceLine> &lines, InstructionWriter &writer, const Options &options,
+			Result &result) {
+		// Address the next word goes to, and which addresses have been set so far.
+		std::int64_t address = 0;
+		std::vector<bool> isSet;
+		for (const SourceLine &line : lines) {
+			const std::vector<std::string> &parsedLine = line.parsedLine;
+			if (parsedLine.size() == 0 || (parsedLine[0] != ";data" && parsedLine[0] != ";word")) {
+				continue;
+			}
+
+			try {
+				// Relocatable code has no data memory of its own, since it can't know what its neighbours put there.
+				if (options.relocatable) {
+					throw std::runtime_error("Data can only be given for whole programs, not relocatable code.");
+				}
+				if (parsedLine[0] == ";data") {
+					if (parsedLine.size() != 2) {
+						throw std::runtime_error("Invalid number of directive arguments.");
+					}
+					address = writer.evaluateValue(parsedLine[1], WORD_SIZE);
+					if (address < 0 || address >= (std::int64_t)DATA_MEMORY_SIZE) {
+						throw std::runtime_error("Data address " + parsedLine[1] + " is outside of data memory.");
+					}
+				}
+				else {
+					if (parsedLine.size() < 2) {
+						throw std::runtime_error("Invalid number of directive arguments.");
+					}
+					for (std::size_t i = 1; i < parsedLine.size(); i++) {
+						std::int64_t value = writer.evaluateValue(parsedLine[i], WORD_SIZE);
+						if (!writer.getAddressReferences().empty()) {
+							result.usesLabelAddresses = true;
+						}
+						if (address >= (std::int64_t)DATA_MEMORY_SIZE) {
+							throw std::runtime_error("Data runs past the end of data memory (" +
+								std::to_string(DATA_MEMORY_SIZE) + " words).");
+						}
+						if (isSet.size() > (std::size_t)address && isSet[(std::size_t)address]) {
+							throw std::runtime_error("Data address " + std::to_string(address) + " is already set.");
+						}
+						if (result.dataImage.size() <= (std::size_t)address) {
+							result.dataImage.resize((std::size_t)address + 1u, 0u);
+							isSet.resize((std::size_t)address + 1u, false);
+						}
+						result.dataImage[(std::size_t)address] = (std::uint16_t)value;
+						isSet[(std::size_t)address] = true;
+						address++;
+					}
+				}
+			}
+			catch (std::exception &e) {
+				result.diagnostics.push_back({"Directive error", line.lineNumber, e.what(), line.fileName});
+			}
+		}
+	}
+
+	// Pass over the lines checking that every ;bound and ;budget directive names a label the program defines, using
+	// the labels found by the first pass in writer. Any that don't are added to the diagnostics of result.
+	void checkLimitLabels(const std::vector<SourceLine> &lines, const InstructionWriter &writer, Result &result) {
+		const std::map<std::string, unsigned int> &labels = writer.getLabelMap();
+		for (const SourceLine &line : lines) {
+			const std::vector<std::string> &parsedLine = line.parsedLine;
+			if (parsedLine.size() != 3 || (parsedLine[0] != ";bound" && parsedLine[0] != ";budget")) {
+				continue;
+			}
+			if (labels.find(parsedLine[1]) == labels.end()) {
+				result.diagnostics.push_back({"Directive error", line.lineNumber,
+					"Unknown label " + parsedLine[1] + ".", line.fileName});
+			}
+		}
+	}
+
+	// Return true iff line is an instruction that will make it into instruction memory (i.e. it's not blank, a 
+	// label, or a directive).
+	bool isInstruction(const SourceLine &line) {
+		return line.parsedLine.size() > 0 && line.parsedLine[0][0] != ':' && line.parsedLine[0][0] != ';';
+	}
+
+	// Return true iff assembling with the given options needs every jump recorded as a relocation, either for the
+	// linker or to rework the program once it's been encoded.
+	bool needsRelocations(const Options &options) {
+		return options.relocatable || options.removeUnreachableCode || options.optimizationLevel > 0 ||
+			options.profile != nullptr;
+	}
+
+	// Record the labels and constants known to writer in result, rework the program as asked for by the options
+	// (e.g. optimizing it or removing unreachable code), and make sure the program in result will actually fit into
+	// instruction memory, adding a diagnostic if not.
+	void finishResult(const InstructionWriter &writer, const Options &options, Result &result) {
+		result.labels = writer.getLabelMap();
+		result.constants = writer.getConstantMap();
+
+		// Only whole programs can be reworked, since in relocatable code anything might be jumped to from code
+		// that hasn't been linked in yet.
+		if (result.succeeded() && !options.relocatable && !result.usesLabelAddresses &&
+			(options.optimizationLevel > 0 || options.removeUnreachableCode)) {
+			ProgramEditor editor(result);
+			// Optimizing first leaves more behind to strip (e.g. jmps that nothing falls into any more once every
+			// jump to them has been threaded past).
+			if (options.optimizationLevel > 0) {
+				result.optimizedInstructionCount = PeepholeOptimizer::optimize(editor);
+			}
+			// Deciding jumps early tends to leave jumps to the next instruction behind, so tidy up again after.
+			// Inlining comes first, so that the inlined code gets optimized to suit each place it was copied to.
+			if (options.optimizationLevel > 1) {
+				if (!options.optimizeForSize) {
+					result.inlinedCallCount = SubroutineInliner::inlineSubroutines(editor);
+				}
+				result.optimizedInstructionCount += DataflowOptimizer::optimize(editor);
+				result.optimizedInstructionCount += PeepholeOptimizer::optimize(editor);
+			}
+			if (options.removeUnreachableCode) {
+				result.removedInstructionCount = DeadCodeEliminator::removeUnreachableCode(editor);
+			}
+			// Outlining comes last, so that code that never runs or was optimized away isn't counted as repeated.
+			if (options.optimizationLevel > 0 && options.optimizeForSize) {
+				result.outlinedInstructionCount = CodeOutliner::outlineRepeatedCode(editor,
+					result.outlinedSequenceCount, result.outlinedCallCount);
+			}
+			editor.writeTo(result);
+		}
+		// Laying the program out comes last, since the profile was recorded running the program as it is now.
+		if (result.succeeded() && !options.relocatable && !result.usesLabelAddresses && options.profile != nullptr) {
+			if (ExecutionProfile::hashProgram(result.machineCode) != options.profile->programHash) {
+				result.profileIsOutdated = true;
+			}
+			else {
+				ProgramEditor editor(result);
+				result.straightenedJumpCount = BlockLayout::layOut(editor, *options.profile);
+				editor.writeTo(result);
+			}
+		}
+		// Relocations were only needed along the way for anything but relocatable code.
+		if (!options.relocatable) {
+			result.relocations.clear();
+		}
+
+		// Programs are only too large if they're still too large after being reworked.
+		if (result.machineCode.size() > INSTRUCTION_MEMORY_SIZE) {
+			result.diagnostics.push_back({"Error", 0u, "Program too large! Max size is " +
+				std::to_string(INSTRUCTION_MEMORY_SIZE) + " instructions!", ""});
+		}
+	}
+
+	// Format a diagnostic the same way the assembler always has, e.g. "Error on line 3: Undefined label foo.".
+	// Problems in included files also say which file they're in, e.g. "Error on line 3 of lib/math.asm: ...".
+	std::string formatDiagnostic(const Diagnostic &diagnostic) {
+		if (diagnostic.lineNumber == 0u) {
+			return diagnostic.category + ": " + diagnostic.message;
+		}
+		std::string location = "line " + std::to_string(diagnostic.lineNumber);
+		if (!diagnostic.fileName.empty()) {
+			location += " of " + diagnostic.fileName;
+		}
+		return diagnostic.category + " on " + location + ": " + diagnostic.message;
+	}
+}
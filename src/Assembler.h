@@ -0,0 +1,197 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include "Instruction.h"
+#include "InstructionWriter.h"
+#include "ExecutionProfile.h"
+
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+// Version of the assembler. This must be bumped any time the machine code produced for some source changes, since
+// it's used to tell apart outputs cached by older versions.
+#define ASSEMBLER_VERSION "1.4.0"
+
+class ModuleCache;
+
+// Contains the Shroom16 assembler itself, packaged up so that it can be used as a library (libshroomasm) by the
+// shroomasm command line tool, the virtual machine, or anything else that wants to turn assembly into machine code
+// without going through a file. Nothing in here is static or global, so every call to assemble() is completely
+// independent of every other call, and many programs may be assembled at the same time on different threads.
+namespace Assembler {
+	// A single problem found while assembling a program. A line number of zero means that the problem doesn't
+	// belong to any particular line of the source (e.g. the program being too large).
+	struct Diagnostic {
+		// What kind of problem this is, printed before the line number (e.g. "Error" or "Directive error").
+		std::string category;
+		// Line of the source code the problem was found on, starting from one.
+		unsigned int lineNumber;
+		// Human readable description of the problem.
+		std::string message;
+		// Name of the included file the problem was found in, or empty if it was found in the main source.
+		std::string fileName;
+	};
+
+	// Where in the source code an assembled instruction came from.
+	struct SourceLocation {
+		// Line of the source code the instruction was on, starting from one.
+		unsigned int lineNumber;
+		// Text of that line, with its comment stripped.
+		std::string text;
+		// Name of the included file the instruction came from, or empty if it came from the main source.
+		std::string fileName;
+	};
+
+	// A single line of source code, broken down into its components by the parser.
+	struct SourceLine {
+		// Line of the source code this is, starting from one.
+		unsigned int lineNumber;
+		// Text of the line, with its comment stripped.
+		std::string text;
+		// Components of the line, as output by Parser::parseLine(). Empty for blank lines.
+		std::vector<std::string> parsedLine;
+		// Name of the included file this line came from, or empty if it came from the main source.
+		std::string fileName;
+	};
+
+	// A file pulled into a program with the ;include directive.
+	struct IncludedFile {
+		// Name of the file, as found relative to the file that included it.
+		std::string fileName;
+		// Hash of the contents of the file at the time it was included.
+		std::uint64_t contentHash;
+	};
+
+	// A jump whose address has to be filled in by the linker once it's known where everything ends up. Only made
+	// when assembling relocatable code.
+	struct Relocation {
+		// Address of the jump instruction within the program.
+		unsigned int address;
+		// Label the instruction jumps to, which may be defined by this program or by another one it's linked with.
+		std::string label;
+	};
+
+	// Settings for an assembly, which can all be left as is for plain in-memory source.
+	struct Options {
+		// Name of the file the source was read from, if any. Files named by ;include directives in the main
+		// source are found relative to the directory this file is in (or the working directory, if empty).
+		std::string sourceFileName;
+		// Cache of already parsed included files to share with other assemblies, or null to give this assembly
+		// a cache of its own. The same cache may be used by many assemblies at once.
+		ModuleCache *moduleCache = nullptr;
+		// Whether to assemble relocatable code to be put together with other code by the linker, rather than a
+		// complete program. Jumps to labels that aren't defined are allowed, and every jump is recorded as a
+		// relocation.
+		bool relocatable = false;
+		// Whether to remove code that can never run (e.g. library subroutines the program never calls), to save
+		// space in instruction memory.
+		bool removeUnreachableCode = false;
+		// How hard to work at making the program run faster once it's been encoded, or 0 to leave it exactly as
+		// written. Level 1 rewrites short runs of instructions into fewer (e.g. removing addi $g0 $g0 0), and level
+		// 2 also follows values through the whole program, deciding jumps early and removing unread writes.
+		unsigned int optimizationLevel = 0;
+		// Whether to optimize for size rather than speed, moving runs of instructions repeated throughout the
+		// program out into shared subroutines (at the cost of a call and a jr every time one runs) and leaving out
+		// anything that makes the program larger. Used along with an optimizationLevel of at least 1.
+		bool optimizeForSize = false;
+		// Profile of the program running in the VM (made by shroomvm -p), or null if there isn't one. Blocks of code
+		// are laid out so that the jumps taken most often in the profile fall through instead. The profile has to
+		// have been recorded running the program assembled with all the same options but this one.
+		const ExecutionProfile::Profile *profile = nullptr;
+	};
+
+	// Everything that comes out of assembling a program. If any diagnostics were reported, the program could not
+	// be assembled and the machine code should not be used.
+	struct Result {
+		// The assembled program, one instruction per instruction memory address.
+		std::vector<Instruction> machineCode;
+		// Every problem found while assembling, in the order they were found.
+		std::vector<Diagnostic> diagnostics;
+		// Source location of every instruction in machineCode (i.e. sourceLocations[i] describes machineCode[i]).
+		std::vector<SourceLocation> sourceLocations;
+		// All labels defined by the program, mapped onto their instruction memory addresses.
+		std::map<std::string, unsigned int> labels;
+		// All constants defined by the program, mapped onto their values.
+		std::map<std::string, int> constants;
+		// Labels named by ;bound directives, mapped onto the most times the loop starting at that label can run.
+		std::map<std::string, unsigned int> loopBounds;
+		// Labels named by ;budget directives, mapped onto the most redstone ticks the routine starting at that label
+		// is meant to take.
+		std::map<std::string, unsigned int> budgets;
+		// Initial contents of data memory given by ;data and ;word directives, from address zero up to the last word
+		// set (i.e. dataImage[i] is the value of the word at address i). Words not set are zero. Empty if the program
+		// doesn't give any data.
+		std::vector<std::uint16_t> dataImage;
+		// Every file pulled into the program with ;include, in the order they were included.
+		std::vector<IncludedFile> includedFiles;
+		// Every jump the linker has to fix up, in address order. Empty unless assembling relocatable code.
+		std::vector<Relocation> relocations;
+		// Number of instructions removed because they could never run.
+		unsigned int removedInstructionCount = 0;
+		// Number of instructions removed by the optimizer.
+		unsigned int optimizedInstructionCount = 0;
+		// Number of calls replaced with a copy of the subroutine they called.
+		unsigned int inlinedCallCount = 0;
+		// Number of subroutines made out of runs of instructions repeated throughout the program, and the number of
+		// places that now call one of them instead.
+		unsigned int outlinedSequenceCount = 0;
+		unsigned int outlinedCallCount = 0;
+		// Number of instructions saved by moving repeated runs of instructions out into subroutines.
+		unsigned int outlinedInstructionCount = 0;
+		// Number of jumps turned into fall throughs by laying the program out to suit its profile.
+		unsigned int straightenedJumpCount = 0;
+		// Whether the profile given was recorded running some other version of the program, and so was ignored.
+		bool profileIsOutdated = false;
+		// Whether any immediate value was worked out from the address of a label. Such programs are never reworked
+		// (e.g. optimized or laid out to suit a profile), since that could move the label without changing the value.
+		bool usesLabelAddresses = false;
+
+		// Return true iff the program was assembled without any problems.
+		bool succeeded() const;
+	};
+
+	// Assemble the Shroom16 assembly program held in source (the full contents of a .asm file) into machine
+	// code. Never throws or exits on a bad program; all problems are reported through the diagnostics of the
+	// returned result instead.
+	Result assemble(const std::string &source, const Options &options = Options());
+
+	// The individual steps of assemble(), for anyone who wants to reuse part of the work between assemblies (e.g.
+	// the incremental assembler used by watch mode). assemble() is exactly these steps, run in order.
+	// Break source down into lines and parse each of them, overwriting lines.
+	void tokenize(const std::string &source, std::vector<SourceLine> &lines);
+	// Replace every ;include directive in lines with the lines of the file it names, parsed (or fetched from the
+	// options' module cache), and with any includes of its own replaced in turn. Every file is only included
+	// once per program, no matter how many times it's named. Any problems (e.g. missing files or circular 
+	// includes) are added to the diagnostics of result, and every file included is recorded in result.
+	void expandIncludes(std::vector<SourceLine> &lines, const Options &options, Result &result);
+	// Pass over the lines recording constants and labels as they come up into writer. This can be thought of as
+	// the first pass over the source code. Any problems are added to the diagnostics of result.
+	void findConstantsAndLabels(const std::vector<SourceLine> &lines, InstructionWriter &writer, Result &result);
+	// Pass over the lines filling in the initial contents of data memory given by ;data and ;word directives into
+	// result, using the labels and constants found by the first pass in writer. ;data <address> moves on to address,
+	// and ;word <value> ... sets the words from there on, one after the other, starting from address zero. Any
+	// problems (e.g. data for addresses past the end of data memory, or set twice) are added to the diagnostics of
+	// result.
+	void fillDataMemory(const std::vector<SourceLine> &lines, InstructionWriter &writer, const Options &options,
+		Result &result);
+	// Pass over the lines checking that every ;bound and ;budget directive names a label the program defines, using
+	// the labels found by the first pass in writer. Any that don't are added to the diagnostics of result.
+	void checkLimitLabels(const std::vector<SourceLine> &lines, const InstructionWriter &writer, Result &result);
+	// Return true iff line is an instruction that will make it into instruction memory (i.e. it's not blank, a 
+	// label, or a directive).
+	bool isInstruction(const SourceLine &line);
+	// Return true iff assembling with the given options needs every jump recorded as a relocation, either for the
+	// linker or to rework the program once it's been encoded.
+	bool needsRelocations(const Options &options);
+	// Record the labels and constants known to writer in result, rework the program as asked for by the options
+	// (e.g. optimizing it or removing unreachable code), and make sure the program in result will actually fit into
+	// instruction memory, adding a diagnostic if not.
+	void finishResult(const InstructionWriter &writer, const Options &options, Result &result);
+
+	// Format a diagnostic the same way the assembler always has, e.g. "Error on line 3: Undefined label foo.".
+	// Problems in included files also say which file they're in, e.g. "Error on line 3 of lib/math.asm: ...".
+	std::string formatDiagnostic(const Diagnostic &diagnostic);
+};
+
+#endif
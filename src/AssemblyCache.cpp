@@ -0,0 +1,182 @@
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <sstream>
+#include <cstdlib>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#include "AssemblyCache.h"
+#include "Assembler.h"
+#include "Hash.h"
+
+// Copy the file sourceFileName to destinationFileName, overwriting it if it already exists. Return true iff the 
+// copy was successful.
+static bool copyFile(const std::string &sourceFileName, const std::string &destinationFileName) {
+	std::ifstream sourceFile(sourceFileName, std::ios::binary);
+	if (!sourceFile.good()) {
+		return false;
+	}
+	std::ofstream destinationFile(destinationFileName, std::ios::binary);
+	if (!destinationFile.good()) {
+		return false;
+	}
+	destinationFile << sourceFile.rdbuf();
+	destinationFile.close();
+	return destinationFile.good();
+}
+
+// Constructs a cache stored in the given directory, creating the directory if it doesn't exist yet. Throws an
+// exception if the directory doesn't exist and could not be created.
+AssemblyCache::AssemblyCache(const std::string &directory) : directory(directory) {
+	// Make sure the directory name ends in a slash so we can tack file names onto it.
+	if (this->directory.empty()) {
+		this->directory = "./";
+	}
+	else if (this->directory.back() != '/' && this->directory.back() != '\\') {
+		this->directory.push_back('/');
+	}
+
+	// Create the directory if it doesn't exist yet.
+	struct stat info;
+	if (stat(directory.c_str(), &info) != 0) {
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+	if (stat(directory.c_str(), &info) != 0 || !(info.st_mode & S_IFDIR)) {
+		throw std::runtime_error("Could not create cache directory " + directory + "!");
+	}
+}
+
+// Return the key that an output of the given kind (e.g. ".schem") assembled from source is cached under. Anything
+// else that changes the output (e.g. assembler options) should be folded into outputKind, and where the source came
+// from and what it included (see describeContext()) into context.
+std::string AssemblyCache::computeKey(const std::string &source, const std::string &outputKind,
+	const std::string &context) {
+	std::uint64_t hash = Hash::fnv1a(source);
+	hash = Hash::fnv1a(outputKind, Hash::fnv1a("\n", hash));
+	hash = Hash::fnv1a(context, Hash::fnv1a("\n", hash));
+	hash = Hash::fnv1a(ASSEMBLER_VERSION, Hash::fnv1a("\n", hash));
+	return Hash::toHexString(hash) + outputKind;
+}
+
+// Return a description of where a program came from, for the context of its keys: the absolute path of its source
+// file inputFileName, along with the absolute path and contents hash of every file in includedFiles. Sources that are
+// the same text in different directories can include different files, so their outputs must never be mixed up.
+std::string AssemblyCache::describeContext(const std::string &inputFileName,
+	const std::vector<Assembler::IncludedFile> &includedFiles) {
+	std::string context = getAbsolutePath(inputFileName) + "\n";
+	for (const Assembler::IncludedFile &includedFile : includedFiles) {
+		context += Hash::toHexString(includedFile.contentHash) + " " + getAbsolutePath(includedFile.fileName) + "\n";
+	}
+	return context;
+}
+
+// Return the absolute path of the file fileName, or fileName itself if it can't be worked out (e.g. the file doesn't
+// exist).
+std::string AssemblyCache::getAbsolutePath(const std::string &fileName) {
+#ifdef _WIN32
+	char *absolutePath = _fullpath(nullptr, fileName.c_str(), 0);
+#else
+	char *absolutePath = realpath(fileName.c_str(), nullptr);
+#endif
+	if (absolutePath == nullptr) {
+		return fileName;
+	}
+	std::string result(absolutePath);
+	free(absolutePath);
+	return result;
+}
+
+// If an output with the given key is in the cache, copy it to destinationFileName and return true. Otherwise return
+// false. Throws an exception if the output is cached but could not be copied.
+bool AssemblyCache::fetch(const std::string &key, const std::string &destinationFileName) const {
+	// Check if there is anything cached under this key at all.
+	std::string cachedFileName = this->getCachedFileName(key);
+	struct stat info;
+	if (stat(cachedFileName.c_str(), &info) != 0) {
+		return false;
+	}
+
+	// If there is, it's a hit, so copy it out.
+	if (!copyFile(cachedFileName, destinationFileName)) {
+		throw std::runtime_error("Issue copying cached output to " + destinationFileName + "!");
+	}
+	return true;
+}
+
+// Add a copy of the freshly written output outputFileName to the cache under the given key. Failing to store
+// something is not an error (the next run will just have to assemble it again), so this never throws.
+void AssemblyCache::store(const std::string &key, const std::string &outputFileName) const {
+	// Copy into a temporary file unique to this thread first, then move it into place, so that nobody can ever
+	// fetch a half written file (e.g. another thread assembling the same program at the same time).
+	std::ostringstream temporaryFileName;
+	temporaryFileName << this->getCachedFileName(key) << ".tmp" << std::this_thread::get_id();
+	if (!copyFile(outputFileName, temporaryFileName.str())) {
+		std::remove(temporaryFileName.str().c_str());
+		return;
+	}
+	// Windows won't rename over an existing file, and if it exists someone else already cached it anyway.
+	if (std::rename(temporaryFileName.str().c_str(), this->getCachedFileName(key).c_str()) != 0) {
+		std::remove(temporaryFileName.str().c_str());
+	}
+}
+
+// If a list of included files is cached under the given key, and every one of those files still exists, set
+// includedFiles to them (with the hashes of their current contents) and return true. Otherwise return false. The keys
+// of a program's outputs depend on what it includes (see describeContext()), so this has to be found before they can
+// be fetched.
+bool AssemblyCache::fetchIncludes(const std::string &key, std::vector<Assembler::IncludedFile> &includedFiles) const {
+	includedFiles.clear();
+	std::ifstream listFile(this->getCachedFileName(key));
+	if (!listFile.good()) {
+		return false;
+	}
+
+	// Every line is the name of a file.
+	std::string includedFileName;
+	while (std::getline(listFile, includedFileName)) {
+		std::ifstream includedFile(includedFileName, std::ios::binary);
+		if (!includedFile.good()) {
+			return false;
+		}
+		std::ostringstream contents;
+		contents << includedFile.rdbuf();
+		includedFiles.push_back({includedFileName, Hash::fnv1a(contents.str())});
+	}
+	return true;
+}
+
+// Record under the given key the files a program included, by their absolute paths. Like store(), this never throws.
+void AssemblyCache::storeIncludes(const std::string &key, 
+	const std::vector<Assembler::IncludedFile> &includedFiles) const {
+	// Same as store(), write to a temporary file then move it into place.
+	std::ostringstream temporaryFileName;
+	temporaryFileName << this->getCachedFileName(key) << ".tmp" << std::this_thread::get_id();
+	std::ofstream listFile(temporaryFileName.str());
+	for (const Assembler::IncludedFile &includedFile : includedFiles) {
+		listFile << getAbsolutePath(includedFile.fileName) << "\n";
+	}
+	listFile.close();
+	if (!listFile.good()) {
+		std::remove(temporaryFileName.str().c_str());
+		return;
+	}
+	// Unlike outputs, the list may be out of date, so it has to replace whatever is already there.
+#ifdef _WIN32
+	std::remove(this->getCachedFileName(key).c_str());
+#endif
+	if (std::rename(temporaryFileName.str().c_str(), this->getCachedFileName(key).c_str()) != 0) {
+		std::remove(temporaryFileName.str().c_str());
+	}
+}
+
+// Return the name of the file that the output with the given key is cached in.
+std::string AssemblyCache::getCachedFileName(const std::string &key) const {
+	return this->directory + key;
+}
@@ -0,0 +1,58 @@
+#include <string>
+#include <vector>
+#include "Assembler.h"
+
+#ifndef ASSEMBLY_CACHE_H
+#define ASSEMBLY_CACHE_H
+
+// Represents an on-disk cache of assembler outputs (shroom16 binaries and schematics), stored in a directory of 
+// files named after a hash of whatever produced them: the source code, where it is and the files it included, the
+// kind of output, and the assembler version. This lets us skip assembling (and in particular, generating and
+// compressing schematics) for programs that haven't changed since the last time they were assembled. A cache object
+// can safely be shared between threads.
+class AssemblyCache {
+public:
+	// Constructs a cache stored in the given directory, creating the directory if it doesn't exist yet. Throws an
+	// exception if the directory doesn't exist and could not be created.
+	AssemblyCache(const std::string &directory);
+
+	// Return the key that an output of the given kind (e.g. ".schem") assembled from source is cached under.
+	// Anything else that changes the output (e.g. assembler options) should be folded into outputKind, and where the
+	// source came from and what it included (see describeContext()) into context.
+	static std::string computeKey(const std::string &source, const std::string &outputKind,
+		const std::string &context = "");
+	// Return a description of where a program came from, for the context of its keys: the absolute path of its source
+	// file inputFileName, along with the absolute path and contents hash of every file in includedFiles. Sources
+	// that are the same text in different directories can include different files, so their outputs must never be
+	// mixed up.
+	static std::string describeContext(const std::string &inputFileName,
+		const std::vector<Assembler::IncludedFile> &includedFiles);
+	// Return the absolute path of the file fileName, or fileName itself if it can't be worked out (e.g. the file
+	// doesn't exist).
+	static std::string getAbsolutePath(const std::string &fileName);
+
+	// If an output with the given key is in the cache, copy it to destinationFileName and return true. Otherwise
+	// return false. Throws an exception if the output is cached but could not be copied.
+	bool fetch(const std::string &key, const std::string &destinationFileName) const;
+	// Add a copy of the freshly written output outputFileName to the cache under the given key. Failing to store
+	// something is not an error (the next run will just have to assemble it again), so this never throws.
+	void store(const std::string &key, const std::string &outputFileName) const;
+
+	// If a list of included files is cached under the given key, and every one of those files still exists, set
+	// includedFiles to them (with the hashes of their current contents) and return true. Otherwise return false. The
+	// keys of a program's outputs depend on what it includes (see describeContext()), so this has to be found before
+	// they can be fetched.
+	bool fetchIncludes(const std::string &key, std::vector<Assembler::IncludedFile> &includedFiles) const;
+	// Record under the given key the files a program included, by their absolute paths. Like store(), this never
+	// throws.
+	void storeIncludes(const std::string &key, const std::vector<Assembler::IncludedFile> &includedFiles) const;
+
+private:
+	// Return the name of the file that the output with the given key is cached in.
+	std::string getCachedFileName(const std::string &key) const;
+
+	// Directory all cached outputs are stored in, including a trailing slash.
+	std::string directory;
+};
+
+#endif
@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "BinaryFile.h"
+#include "Hash.h"
+
+namespace BinaryFile {
+	// Every binary since version 2 starts with these four bytes.
+	static const std::string BINARY_FILE_MAGIC = "SHRB";
+	// Size of the header (magic number, format version, instruction set revision, section count and checksum), and of
+	// each entry of the section table after it (type, offset and size).
+	static const std::size_t HEADER_SIZE = 24u;
+	static const std::size_t SECTION_ENTRY_SIZE = 12u;
+	// Every section starts at a multiple of this many bytes into the file.
+	static const std::size_t SECTION_ALIGNMENT = 16u;
+	// Types of section. Sections of any other type are skipped, so that newer sections can be added without breaking
+	// older readers.
+	static const unsigned int CODE_SECTION = 1u;
+	static const unsigned int DATA_SECTION = 2u;
+	static const unsigned int SYMBOL_SECTION = 3u;
+	static const unsigned int LINE_SECTION = 4u;
+
+	// Add value to the end of out as size little endian bytes.
+	static void appendNumber(std::vector<BYTE> &out, std::uint64_t value, unsigned int size) {
+		for (unsigned int i = 0; i < size; i++) {
+			out.push_back((BYTE)(value >> (BYTE_SIZE * i)));
+		}
+	}
+
+	// Add s to the end of out as its length followed by its characters.
+	static void appendString(std::vector<BYTE> &out, const std::string &s) {
+		appendNumber(out, s.size(), 4u);
+		out.insert(out.end(), s.begin(), s.end());
+	}
+
+	// Walks through part of a binary, throwing an exception if we try to read past the end of it.
+	class Reader {
+	public:
+		Reader(const BYTE *data, std::size_t size, const std::string &fileName)
+			: data(data), size(size), fileName(fileName) {}
+
+		// Read size little endian bytes.
+		std::uint64_t readNumber(unsigned int size) {
+			this->checkRemaining(size);
+			std::uint64_t value = 0u;
+			for (unsigned int i = 0; i < size; i++) {
+				value |= (std::uint64_t)this->data[this->position++] << (BYTE_SIZE * i);
+			}
+			return value;
+		}
+
+		// Read a string written by appendString().
+		std::string readString() {
+			std::size_t length = (std::size_t)this->readNumber(4u);
+			this->checkRemaining(length);
+			this->position += length;
+			return std::string((const char*)this->data + this->position - length, length);
+		}
+
+		// Throw an exception unless there are at least count bytes left to read.
+		void checkRemaining(std::size_t count) const {
+			if (count > this->size - this->position) {
+				throw std::runtime_error("Binary file " + this->fileName + " is corrupt!");
+			}
+		}
+
+	private:
+		const BYTE *data;
+		std::size_t size;
+		const std::string &fileName;
+		// Index of the next byte to read.
+		std::size_t position = 0;
+	};
+
+	// Return the binary for a program assembled by Assembler::assemble().
+	Binary makeBinary(const Assembler::Result &assembled) {
+		Binary binary;
+		binary.machineCode = assembled.machineCode;
+		binary.dataImage = assembled.dataImage;
+		binary.labels = assembled.labels;
+		binary.sourceLocations = assembled.sourceLocations;
+		return binary;
+	}
+
+	// Write binary to the file fileName. Throws an exception if the file could not be opened or written.
+	void saveBinary(const Binary &binary, const std::string &fileName) {
+		// Put together the contents of each section, leaving out optional ones with nothing in them.
+		std::vector<std::pair<unsigned int, std::vector<BYTE> > > sections;
+		sections.push_back({CODE_SECTION, {}});
+		for (const Instruction &instruction : binary.machineCode) {
+			appendNumber(sections.back().second, instruction.getBitsInRange(0u, INSTRUCTION_SIZE - 1u), 4u);
+		}
+		if (!binary.dataImage.empty()) {
+			sections.push_back({DATA_SECTION, {}});
+			for (std::uint16_t word : binary.dataImage) {
+				appendNumber(sections.back().second, word, WORD_SIZE / BYTE_SIZE);
+			}
+		}
+		// Labels come out of the map sorted, so the same program always gives exactly the same file.
+		if (!binary.labels.empty()) {
+			sections.push_back({SYMBOL_SECTION, {}});
+			appendNumber(sections.back().second, binary.labels.size(), 4u);
+			for (const std::pair<const std::string, unsigned int> &label : binary.labels) {
+				appendNumber(sections.back().second, label.second, 4u);
+				appendString(sections.back().second, label.first);
+			}
+		}
+		// Every file name is only stored once, with each instruction giving the index of its own.
+		if (!binary.sourceLocations.empty()) {
+			std::vector<BYTE> fileNames;
+			std::vector<BYTE> lines;
+			std::map<std::string, unsigned int> fileIndices;
+			for (const Assembler::SourceLocation &location : binary.sourceLocations) {
+				if (fileIndices.find(location.fileName) == fileIndices.end()) {
+					unsigned int index = (unsigned int)fileIndices.size();
+					fileIndices[location.fileName] = index;
+					appendString(fileNames, location.fileName);
+				}
+				appendNumber(lines, location.lineNumber, 4u);
+				appendNumber(lines, fileIndices[location.fileName], 4u);
+				appendString(lines, location.text);
+			}
+			sections.push_back({LINE_SECTION, {}});
+			appendNumber(sections.back().second, fileIndices.size(), 4u);
+			sections.back().second.insert(sections.back().second.end(), fileNames.begin(), fileNames.end());
+			sections.back().second.insert(sections.back().second.end(), lines.begin(), lines.end());
+		}
+
+		// Lay out the section table, then every section on its boundary after it.
+		std::vector<BYTE> contents;
+		std::size_t offset = HEADER_SIZE + sections.size() * SECTION_ENTRY_SIZE;
+		std::vector<std::size_t> offsets;
+		for (const std::pair<unsigned int, std::vector<BYTE> > &section : sections) {
+			offset = (offset + SECTION_ALIGNMENT - 1u) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+			offsets.push_back(offset);
+			appendNumber(contents, section.first, 4u);
+			appendNumber(contents, offset, 4u);
+			appendNumber(contents, section.second.size(), 4u);
+			offset += section.second.size();
+		}
+		for (unsigned int i = 0; i < sections.size(); i++) {
+			contents.resize(offsets[i] - HEADER_SIZE, 0u);
+			contents.insert(contents.end(), sections[i].second.begin(), sections[i].second.end());
+		}
+
+		// Then the header, checksumming everything after it.
+		std::vector<BYTE> header(BINARY_FILE_MAGIC.begin(), BINARY_FILE_MAGIC.end());
+		appendNumber(header, BINARY_FILE_VERSION, 4u);
+		appendNumber(header, ISA_REVISION, 4u);
+		appendNumber(header, sections.size(), 4u);
+		appendNumber(header, Hash::fnv1aBytes(contents.data(), contents.size()), 8u);
+
+		std::ofstream outFile(fileName, std::ios::binary);
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue opening output file " + fileName + "!");
+		}
+		outFile.write((const char*)header.data(), (std::streamsize)header.size());
+		outFile.write((const char*)contents.data(), (std::streamsize)contents.size());
+		outFile.close();
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue writing output file " + fileName + "!");
+		}
+	}
+
+	// Read the code of a version 1 binary, a bare run of instructions, out of size bytes of data.
+	static Binary parseVersion1(const BYTE *data, std::size_t size, const std::string &fileName) {
+		if (size % (INSTRUCTION_SIZE / BYTE_SIZE) != 0) {
+			throw std::runtime_error("Input file " + fileName + " isn't a shroom16 binary file!");
+		}
+		Binary binary;
+		binary.formatVersion = 1u;
+		Reader reader(data, size, fileName);
+		binary.machineCode.resize(size / (INSTRUCTION_SIZE / BYTE_SIZE));
+		for (Instruction &instruction : binary.machineCode) {
+			instruction.setBitsInRange(0u, INSTRUCTION_SIZE - 1u, (unsigned int)reader.readNumber(4u));
+		}
+		return binary;
+	}
+
+	// Read the section of type into binary from size bytes of data.
+	static void parseSection(unsigned int type, const BYTE *data, std::size_t size, const std::string &fileName,
+		Binary &binary) {
+		Reader reader(data, size, fileName);
+		if (type == CODE_SECTION) {
+			if (size % (INSTRUCTION_SIZE / BYTE_SIZE) != 0u) {
+				throw std::runtime_error("Binary file " + fileName + " is corrupt!");
+			}
+			binary.machineCode.resize(size / (INSTRUCTION_SIZE / BYTE_SIZE));
+			for (Instruction &instruction : binary.machineCode) {
+				instruction.setBitsInRange(0u, INSTRUCTION_SIZE - 1u, (unsigned int)reader.readNumber(4u));
+			}
+		}
+		else if (type == DATA_SECTION) {
+			if (size % (WORD_SIZE / BYTE_SIZE) != 0u || size / (WORD_SIZE / BYTE_SIZE) > DATA_MEMORY_SIZE) {
+				throw std::runtime_error("Binary file " + fileName + " is corrupt!");
+			}
+			binary.dataImage.resize(size / (WORD_SIZE / BYTE_SIZE));
+			for (std::uint16_t &word : binary.dataImage) {
+				word = (std::uint16_t)reader.readNumber(WORD_SIZE / BYTE_SIZE);
+			}
+		}
+		else if (type == SYMBOL_SECTION) {
+			std::uint64_t labelCount = reader.readNumber(4u);
+			for (std::uint64_t i = 0; i < labelCount; i++) {
+				unsigned int address = (unsigned int)reader.readNumber(4u);
+				binary.labels[reader.readString()] = address;
+			}
+		}
+		else if (type == LINE_SECTION) {
+			std::vector<std::string> fileNames((std::size_t)std::min<std::uint64_t>(reader.readNumber(4u), size));
+			for (std::string &name : fileNames) {
+				name = reader.readString();
+			}
+			binary.sourceLocations.resize(binary.machineCode.size());
+			for (Assembler::SourceLocation &location : binary.sourceLocations) {
+				location.lineNumber = (unsigned int)reader.readNumber(4u);
+				std::uint64_t fileIndex = reader.readNumber(4u);
+				if (fileIndex >= fileNames.size()) {
+					throw std::runtime_error("Binary file " + fileName + " is corrupt!");
+				}
+				location.fileName = fileNames[(std::size_t)fileIndex];
+				location.text = reader.readString();
+			}
+		}
+	}
+
+	// Read the binary held in size bytes of data, read from the file fileName. Throws an exception if the data isn't
+	// a shroom16 binary, is corrupt, or was made for a different format version or instruction set.
+	Binary parseBinary(const BYTE *data, std::size_t size, const std::string &fileName) {
+		if (size < HEADER_SIZE || std::string((const char*)data, BINARY_FILE_MAGIC.size()) != BINARY_FILE_MAGIC) {
+			return parseVersion1(data, size, fileName);
+		}
+
+		// Make sure this is a binary we understand, and that it's all there.
+		Reader header(data, HEADER_SIZE, fileName);
+		header.readNumber((unsigned int)BINARY_FILE_MAGIC.size());
+		if (header.readNumber(4u) != BINARY_FILE_VERSION) {
+			throw std::runtime_error("Binary file " + fileName + " was made by a different version of shroomasm!");
+		}
+		if (header.readNumber(4u) != ISA_REVISION) {
+			throw std::runtime_error("Binary file " + fileName + " is for a different revision of the Shroom16 "
+				"instruction set!");
+		}
+		std::uint64_t sectionCount = header.readNumber(4u);
+		if (header.readNumber(8u) != Hash::fnv1aBytes(data + HEADER_SIZE, size - HEADER_SIZE)) {
+			throw std::runtime_error("Binary file " + fileName + " is corrupt!");
+		}
+
+		// The code has to be read first, since the line table is as long as it is.
+		Reader sectionTable(data + HEADER_SIZE, size - HEADER_SIZE, fileName);
+		sectionTable.checkRemaining((std::size_t)std::min<std::uint64_t>(sectionCount * SECTION_ENTRY_SIZE, size));
+		std::vector<std::pair<unsigned int, std::pair<std::uint64_t, std::uint64_t> > > sections;
+		bool hasCode = false;
+		for (std::uint64_t i = 0; i < sectionCount; i++) {
+			unsigned int type = (unsigned int)sectionTable.readNumber(4u);
+			std::uint64_t offset = sectionTable.readNumber(4u);
+			std::uint64_t sectionSize = sectionTable.readNumber(4u);
+			if (offset > size || sectionSize > size - offset) {
+				throw std::runtime_error("Binary file " + fileName + " is corrupt!");
+			}
+			hasCode = hasCode || type == CODE_SECTION;
+			sections.push_back({type, {offset, sectionSize}});
+		}
+		if (!hasCode) {
+			throw std::runtime_error("Binary file " + fileName + " has no code!");
+		}
+		std::stable_partition(sections.begin(), sections.end(),
+			[](const std::pair<unsigned int, std::pair<std::uint64_t, std::uint64_t> > &section) {
+			return section.first == CODE_SECTION;
+		});
+
+		Binary binary;
+		for (const std::pair<unsigned int, std::pair<std::uint64_t, std::uint64_t> > &section : sections) {
+			parseSection(section.first, data + section.second.first, (std::size_t)section.second.second, fileName,
+				binary);
+		}
+		return binary;
+	}
+
+	// Read the binary file fileName, which is mapped into memory (where the system allows) and read in place rather
+	// than copied in first. Throws an exception if the file could not be opened, or isn't a binary parseBinary()
+	// understands.
+	Binary loadBinary(const std::string &fileName) {
+		MappedFile file(fileName);
+		return parseBinary(file.data(), file.size(), fileName);
+	}
+
+	// Map the file fileName into memory. Throws an exception if the file could not be opened or mapped.
+	MappedFile::MappedFile(const std::string &fileName) : contents(nullptr), contentsSize(0u) {
+#ifdef _WIN32
+		std::ifstream inFile(fileName, std::ios::binary);
+		if (!inFile.good()) {
+			throw std::runtime_error("Issue opening input file " + fileName + "!");
+		}
+		std::vector<char> bytes((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+		buffer.assign(bytes.begin(), bytes.end());
+		contents = buffer.empty() ? nullptr : buffer.data();
+		contentsSize = buffer.size();
+#else
+		int file = open(fileName.c_str(), O_RDONLY);
+		struct stat info;
+		if (file < 0 || fstat(file, &info) != 0) {
+			if (file >= 0) {
+				close(file);
+			}
+			throw std::runtime_error("Issue opening input file " + fileName + "!");
+		}
+		// Empty files can't be mapped, but they're perfectly good (empty) files.
+		const std::size_t size = (std::size_t)info.st_size;
+		void *mapping = size == 0u ? nullptr : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		if (mapping == MAP_FAILED) {
+			throw std::runtime_error("Issue reading input file " + fileName + "!");
+		}
+		contents = (const BYTE*)mapping;
+		contentsSize = size;
+#endif
+	}
+
+	MappedFile::~MappedFile() {
+#ifndef _WIN32
+		if (contents != nullptr) {
+			munmap((void*)contents, contentsSize);
+		}
+#endif
+	}
+
+	// Return the contents of the file, which are size() bytes long.
+	const BYTE *MappedFile::data() const {
+		return contents;
+	}
+
+	// Return the size of the file in bytes.
+	std::size_t MappedFile::size() const {
+		return contentsSize;
+	}
+}
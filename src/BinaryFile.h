@@ -0,0 +1,77 @@
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "Instruction.h"
+#include "Assembler.h"
+
+#ifndef BINARY_FILE_H
+#define BINARY_FILE_H
+
+// Version of the shroom16 binary file format. This must be bumped any time the layout of binaries changes, so that
+// the VM can refuse binaries it doesn't understand rather than misreading them. Version 1 was a bare run of
+// instructions with nothing else in the file, which is still read.
+#define BINARY_FILE_VERSION 2u
+// Revision of the Shroom16 instruction set that binaries are assembled for. This must be bumped any time the
+// encoding or meaning of an instruction changes, so that binaries for the old instruction set aren't run.
+#define ISA_REVISION 1u
+
+// Contains the shroom16 binary file format (.shroombin), which the virtual machine runs. A binary is a header (magic
+// number, format version, instruction set revision, section count and a checksum of the rest of the file), a table of
+// sections (each a type, offset and size), and the sections themselves, each starting on a 16 byte boundary so that
+// the code can be read straight out of a mapping of the file. The sections are the code, and optionally the program's
+// initial data memory, its labels, and the source location of every instruction. Every number is little endian.
+// Files that don't start with the magic number are read as version 1 binaries.
+namespace BinaryFile {
+	// Everything stored in a binary.
+	struct Binary {
+		// Version of the format the binary was read from. Binaries are always written in the latest version.
+		unsigned int formatVersion = BINARY_FILE_VERSION;
+		// The program, one instruction per instruction memory address.
+		std::vector<Instruction> machineCode;
+		// Initial contents of data memory (dataImage[i] being the value of the word at address i). Words past the end
+		// are zero.
+		std::vector<std::uint16_t> dataImage;
+		// Labels defined by the program, mapped onto their instruction memory addresses.
+		std::map<std::string, unsigned int> labels;
+		// Source location of every instruction in machineCode, or empty if they aren't known (e.g. linked programs).
+		std::vector<Assembler::SourceLocation> sourceLocations;
+	};
+
+	// Return the binary for a program assembled by Assembler::assemble().
+	Binary makeBinary(const Assembler::Result &assembled);
+	// Write binary to the file fileName. Throws an exception if the file could not be opened or written.
+	void saveBinary(const Binary &binary, const std::string &fileName);
+	// Read the binary held in size bytes of data, read from the file fileName. Throws an exception if the data isn't
+	// a shroom16 binary, is corrupt, or was made for a different format version or instruction set.
+	Binary parseBinary(const BYTE *data, std::size_t size, const std::string &fileName);
+	// Read the binary file fileName, which is mapped into memory (where the system allows) and read in place rather
+	// than copied in first. Throws an exception if the file could not be opened, or isn't a binary parseBinary()
+	// understands.
+	Binary loadBinary(const std::string &fileName);
+
+	// A file mapped into memory (where the system allows, or read into memory where it doesn't) for as long as the
+	// MappedFile is around, so that it can be read in place rather than copied in first.
+	class MappedFile {
+	public:
+		// Map the file fileName into memory. Throws an exception if the file could not be opened or mapped.
+		MappedFile(const std::string &fileName);
+		MappedFile(const MappedFile &other) = delete;
+		MappedFile &operator=(const MappedFile &other) = delete;
+		~MappedFile();
+
+		// Return the contents of the file, which are size() bytes long.
+		const BYTE *data() const;
+		// Return the size of the file in bytes.
+		std::size_t size() const;
+	private:
+		// Contents of the file, or nullptr if it's empty (empty files can't be mapped).
+		const BYTE *contents;
+		std::size_t contentsSize;
+		// Where files aren't mapped, the contents of the file read into memory.
+		std::vector<BYTE> buffer;
+	};
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <map>
+#include "BlockLayout.h"
+#include "ControlFlowGraph.h"
+#include "InstructionFormat.h"
+
+namespace BlockLayout {
+	// Stands for no block at all, e.g. after the last block of the program.
+	static const unsigned int NO_BLOCK = 0xffffffffu;
+
+	// Maps each conditional jump onto the two conditional jumps that, between them, jump exactly when it doesn't
+	// (given a cmp result, which always has exactly one of the bits they look for set).
+	static const std::map<std::string, std::pair<std::string, std::string> > inverseMnemonics = {
+		{"jeq", {"jlt", "jgt"}},
+		{"jlt", {"jeq", "jgt"}},
+		{"jgt", {"jeq", "jlt"}}
+	};
+
+	// A way control can get from the end of one block to the start of another, which could be made into a fall
+	// through by placing the blocks one after the other, along with how often it was taken.
+	struct Edge {
+		unsigned int from;
+		unsigned int to;
+		std::uint64_t weight;
+	};
+
+	// Return counts[index], or 0 if the profile doesn't go that far.
+	static std::uint64_t countAt(const std::vector<std::uint64_t> &counts, unsigned int index) {
+		return index < counts.size() ? counts[index] : 0u;
+	}
+
+	// Return true iff the conditional jump at the end of block can be swapped for the opposite condition, which is
+	// only safe if the register it looks at was last written by a cmp in the same block.
+	static bool canInvert(const ProgramEditor &program, const ControlFlowGraph::Block &block) {
+		unsigned int conditionRegister = InstructionFormat::getReadA(program.getInstruction(block.end - 1));
+		std::vector<unsigned int> written;
+		for (unsigned int i = block.end - 1; i-- > block.start;) {
+			InstructionFormat::getWrittenRegisters(program.getInstruction(i), written);
+			if (std::find(written.begin(), written.end(), conditionRegister) != written.end()) {
+				return InstructionFormat::is(program.getInstruction(i), "cmp");
+			}
+		}
+		return false;
+	}
+
+	// Rearrange the blocks of program so that the jumps taken most often in profile (which must have been recorded
+	// running program exactly as it is) become fall throughs instead, and return how many jumps were straightened
+	// out like this. Conditional jumps are inverted where that helps, and jmps are only added on the edges that are
+	// taken least often. Nothing is changed in programs that jump to addresses they worked out themselves.
+	unsigned int layOut(ProgramEditor &program, const ExecutionProfile::Profile &profile) {
+		if (program.size() == 0 || !program.canFollowEveryJump()) {
+			return 0;
+		}
+		const unsigned int programSize = program.size();
+		ControlFlowGraph graph(program);
+		const std::vector<ControlFlowGraph::Block> &blocks = graph.getBlocks();
+		const unsigned int blockCount = (unsigned int)blocks.size();
+
+		// Where each block goes to if it doesn't jump, and where it goes if it does, in block indices.
+		std::vector<unsigned int> nextBlocks(blockCount, NO_BLOCK);
+		std::vector<unsigned int> targetBlocks(blockCount, NO_BLOCK);
+		for (unsigned int b = 0; b < blockCount; b++) {
+			unsigned int last = blocks[b].end - 1;
+			if (blocks[b].end < programSize) {
+				nextBlocks[b] = b + 1;
+			}
+			if (program.hasTarget(last) && program.getTarget(last) < programSize) {
+				targetBlocks[b] = graph.getBlockIndex(program.getTarget(last));
+			}
+		}
+
+		// Blocks are put together into chains that will be laid out one after the other. Subroutines return to just
+		// after the call, so those blocks always have to stay together.
+		std::vector<unsigned int> nextInChain(blockCount, NO_BLOCK);
+		std::vector<unsigned int> previousInChain(blockCount, NO_BLOCK);
+		std::vector<Edge> edges;
+		for (unsigned int b = 0; b < blockCount; b++) {
+			unsigned int last = blocks[b].end - 1;
+			const Instruction &instruction = program.getInstruction(last);
+			std::uint64_t executionCount = countAt(profile.executionCounts, last);
+			std::uint64_t takenCount = countAt(profile.takenCounts, last);
+			if (InstructionFormat::isCall(instruction)) {
+				if (nextBlocks[b] != NO_BLOCK) {
+					nextInChain[b] = nextBlocks[b];
+					previousInChain[nextBlocks[b]] = b;
+				}
+			}
+			else if (InstructionFormat::is(instruction, "jmp")) {
+				if (targetBlocks[b] != NO_BLOCK) {
+					edges.push_back({b, targetBlocks[b], executionCount});
+				}
+			}
+			else if (InstructionFormat::isConditionalJump(instruction)) {
+				if (nextBlocks[b] != NO_BLOCK) {
+					edges.push_back({b, nextBlocks[b], executionCount - takenCount});
+				}
+				if (targetBlocks[b] != NO_BLOCK && targetBlocks[b] != nextBlocks[b] && canInvert(program, blocks[b])) {
+					edges.push_back({b, targetBlocks[b], takenCount});
+				}
+			}
+			else if (InstructionFormat::fallsThrough(instruction) && nextBlocks[b] != NO_BLOCK) {
+				edges.push_back({b, nextBlocks[b], executionCount});
+			}
+		}
+
+		// Join chains together along the edges taken most often first. Edges that were never taken aren't worth
+		// adding jumps for, but blocks that already fell through into each other are kept together. The first
+		// block always has to stay at the start of the program.
+		std::stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+			return a.weight > b.weight;
+		});
+		for (const Edge &edge : edges) {
+			bool isFallThrough = edge.to == nextBlocks[edge.from] &&
+				!InstructionFormat::is(program.getInstruction(blocks[edge.from].end - 1), "jmp");
+			if ((edge.weight == 0u && !isFallThrough) || edge.to == 0u || nextInChain[edge.from] != NO_BLOCK ||
+				previousInChain[edge.to] != NO_BLOCK) {
+				continue;
+			}
+			// Joining a chain onto itself would make a loop rather than something that can be laid out.
+			unsigned int head = edge.from;
+			while (previousInChain[head] != NO_BLOCK) {
+				head = previousInChain[head];
+			}
+			if (head == edge.to) {
+				continue;
+			}
+			nextInChain[edge.from] = edge.to;
+			previousInChain[edge.to] = edge.from;
+		}
+
+		// Lay the chains out in the order they started in, which puts the chain with the first block first.
+		std::vector<unsigned int> layout;
+		std::vector<unsigned int> nextInLayout(blockCount, NO_BLOCK);
+		for (unsigned int b = 0; b < blockCount; b++) {
+			if (previousInChain[b] == NO_BLOCK) {
+				for (unsigned int c = b; c != NO_BLOCK; c = nextInChain[c]) {
+					if (!layout.empty()) {
+						nextInLayout[layout.back()] = c;
+					}
+					layout.push_back(c);
+				}
+			}
+		}
+
+		// Now make every block still go where it used to once it's moved, going backwards so that the blocks still
+		// to go don't move. Any jmps that end up jumping to the very next block are dropped once everything's in
+		// place, and anything that used to fall through into a block that's now somewhere else gets a jump there.
+		std::vector<unsigned int> addedCounts(blockCount, 0u);
+		std::vector<bool> dropsJump(blockCount, false);
+		unsigned int straightenedCount = 0;
+		for (unsigned int b = blockCount; b-- > 0;) {
+			unsigned int last = blocks[b].end - 1;
+			const Instruction instruction = program.getInstruction(last);
+			if (InstructionFormat::is(instruction, "jmp")) {
+				if (targetBlocks[b] != NO_BLOCK && targetBlocks[b] == nextInLayout[b]) {
+					dropsJump[b] = true;
+					straightenedCount++;
+				}
+				continue;
+			}
+			if (!InstructionFormat::fallsThrough(instruction) || InstructionFormat::isCall(instruction) ||
+				nextInLayout[b] == nextBlocks[b]) {
+				continue;
+			}
+
+			// The block that used to come next (or the end of the program) now starts just after end.
+			const Assembler::SourceLocation location = program.getSourceLocation(last);
+			unsigned int end = blocks[b].end;
+			if (InstructionFormat::isConditionalJump(instruction) && targetBlocks[b] != NO_BLOCK &&
+				targetBlocks[b] == nextInLayout[b] && canInvert(program, blocks[b])) {
+				const std::pair<std::string, std::string> &inverse =
+					inverseMnemonics.at(InstructionFormat::getMnemonic(instruction));
+				unsigned int conditionRegister = InstructionFormat::getReadA(instruction);
+				program.insert(end, InstructionFormat::makeInstruction(inverse.second, 0u, conditionRegister, 0u),
+					location);
+				program.setTarget(end, end + 1);
+				program.replaceInstruction(last, InstructionFormat::makeInstruction(inverse.first, 0u,
+					conditionRegister, 0u));
+				program.setTarget(last, end + 1);
+				straightenedCount++;
+			}
+			else {
+				program.insert(end, InstructionFormat::makeInstruction("jmp", 0u, 0u, 0u), location);
+				program.setTarget(end, end + 1);
+			}
+			addedCounts[b] = 1u;
+		}
+
+		// Move every block into place.
+		std::vector<unsigned int> starts(blockCount);
+		std::vector<unsigned int> sizes(blockCount);
+		unsigned int start = 0;
+		for (unsigned int b = 0; b < blockCount; b++) {
+			starts[b] = start;
+			sizes[b] = blocks[b].end - blocks[b].start + addedCounts[b];
+			start += sizes[b];
+		}
+		std::vector<unsigned int> order;
+		std::vector<unsigned int> droppedJumps;
+		for (unsigned int b : layout) {
+			for (unsigned int i = 0; i < sizes[b]; i++) {
+				order.push_back(starts[b] + i);
+			}
+			if (dropsJump[b]) {
+				droppedJumps.push_back((unsigned int)order.size() - 1);
+			}
+		}
+		program.reorder(order);
+
+		// Anything that jumped to a dropped jmp now goes straight on to the block after it, which is where it went.
+		for (unsigned int i = (unsigned int)droppedJumps.size(); i-- > 0;) {
+			program.remove(droppedJumps[i]);
+		}
+		return straightenedCount;
+	}
+}
@@ -0,0 +1,18 @@
+#include "ProgramEditor.h"
+#include "ExecutionProfile.h"
+
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+// Contains a pass that rearranges the basic blocks of a program so that the paths it takes most often fall straight
+// through from one block to the next, going by a profile of the program running in the VM. Taken jumps are the slow
+// case on the real computer, so hot loops that jump on every iteration are worth straightening out.
+namespace BlockLayout {
+	// Rearrange the blocks of program so that the jumps taken most often in profile (which must have been recorded
+	// running program exactly as it is) become fall throughs instead, and return how many jumps were straightened
+	// out like this. Conditional jumps are inverted where that helps, and jmps are only added on the edges that
+	// are taken least often. Nothing is changed in programs that jump to addresses they worked out themselves.
+	unsigned int layOut(ProgramEditor &program, const ExecutionProfile::Profile &profile);
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include "CodeOutliner.h"
+#include "ControlFlowGraph.h"
+#include "DataflowOptimizer.h"
+#include "InstructionFormat.h"
+
+namespace CodeOutliner {
+	// Longest run of instructions looked for. Runs inside a single basic block are rarely any longer than this.
+	static const unsigned int MAX_SEQUENCE_LENGTH = 64u;
+
+	// A run of instructions that could be moved out into a subroutine, and every place it would be called from.
+	struct Candidate {
+		unsigned int length = 0;
+		std::vector<unsigned int> starts;
+		// Instructions saved by moving it out, which may be negative.
+		int savedCount = 0;
+	};
+
+	// Return true iff instruction can be moved into a subroutine, i.e. it always carries on to the next instruction
+	// and doesn't care which address it's at or what's in $ca.
+	static bool canOutline(const Instruction &instruction) {
+		if (InstructionFormat::isJump(instruction) || InstructionFormat::isIndirectJump(instruction) ||
+			!InstructionFormat::fallsThrough(instruction)) {
+			return false;
+		}
+		const unsigned int caRegister = InstructionFormat::getRegisterId("$ca");
+		std::vector<unsigned int> registers;
+		InstructionFormat::getReadRegisters(instruction, registers);
+		std::vector<unsigned int> written;
+		InstructionFormat::getWrittenRegisters(instruction, written);
+		registers.insert(registers.end(), written.begin(), written.end());
+		for (unsigned int registerId : registers) {
+			if (registerId == caRegister) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Overwrite caIsLiveAfter with whether $ca might still be read after each instruction of program, before being
+	// written again.
+	static void findWhereCaIsLive(ProgramEditor &program, std::vector<bool> &caIsLiveAfter) {
+		const unsigned int caRegister = InstructionFormat::getRegisterId("$ca");
+		ControlFlowGraph graph(program);
+		std::vector<std::uint32_t> liveIn;
+		std::vector<std::uint32_t> liveOut;
+		DataflowOptimizer::findLiveRegisters(program, graph, liveIn, liveOut);
+
+		// Only $ca matters, so just follow that one bit backwards through every block.
+		caIsLiveAfter.assign(program.size(), true);
+		const std::vector<ControlFlowGraph::Block> &blocks = graph.getBlocks();
+		std::vector<unsigned int> registers;
+		for (unsigned int b = 0; b < blocks.size(); b++) {
+			bool isLive = (liveOut[b] & (1u << caRegister)) != 0u;
+			for (unsigned int i = blocks[b].end; i-- > blocks[b].start;) {
+				caIsLiveAfter[i] = isLive;
+				InstructionFormat::getWrittenRegisters(program.getInstruction(i), registers);
+				if (std::find(registers.begin(), registers.end(), caRegister) != registers.end()) {
+					isLive = false;
+				}
+				InstructionFormat::getReadRegisters(program.getInstruction(i), registers);
+				if (std::find(registers.begin(), registers.end(), caRegister) != registers.end()) {
+					isLive = true;
+				}
+			}
+		}
+	}
+
+	// Find the run of instructions in program that would save the most space moved out into a subroutine, going
+	// by what can be moved (see findWhereCaIsLive() and canOutline()). Runs saving the same amount are picked by
+	// the fewest places calling them, which costs the least speed.
+	static Candidate findBestCandidate(ProgramEditor &program) {
+		const unsigned int programSize = program.size();
+		std::vector<bool> isTarget;
+		program.findJumpTargets(isTarget);
+		std::vector<bool> caIsLiveAfter;
+		findWhereCaIsLive(program, caIsLiveAfter);
+
+		// How many instructions from each one on could be moved together. Jumps can go to the first instruction
+		// of a run (which becomes the call), but not into the middle of one.
+		std::vector<unsigned int> runLengths(programSize + 1u, 0u);
+		for (unsigned int i = programSize; i-- > 0;) {
+			if (canOutline(program.getInstruction(i))) {
+				runLengths[i] = 1u + (i + 1u < programSize && !isTarget[i + 1u] ? runLengths[i + 1u] : 0u);
+			}
+		}
+
+		Candidate best;
+		for (unsigned int length = 2u; length <= MAX_SEQUENCE_LENGTH; length++) {
+			// Group together every place each run of this length turns up, by its machine code.
+			std::map<std::vector<unsigned int>, std::vector<unsigned int> > starts;
+			for (unsigned int i = 0; i + length <= programSize; i++) {
+				if (runLengths[i] < length || caIsLiveAfter[i + length - 1u]) {
+					continue;
+				}
+				std::vector<unsigned int> key;
+				for (unsigned int k = 0; k < length; k++) {
+					key.push_back(program.getInstruction(i + k).getBitsInRange(0u, INSTRUCTION_SIZE - 1u));
+				}
+				std::vector<unsigned int> &places = starts[key];
+				// Places that overlap can't both be moved out.
+				if (places.empty() || places.back() + length <= i) {
+					places.push_back(i);
+				}
+			}
+
+			// Every place becomes a call, and the subroutine needs a jr on the end.
+			for (const std::pair<const std::vector<unsigned int>, std::vector<unsigned int> > &group : starts) {
+				int placeCount = (int)group.second.size();
+				int savedCount = placeCount * (int)length - placeCount - (int)length - 1;
+				if (savedCount > best.savedCount ||
+					(savedCount == best.savedCount && savedCount > 0 && group.second.size() < best.starts.size())) {
+					best.length = length;
+					best.starts = group.second;
+					best.savedCount = savedCount;
+				}
+			}
+		}
+		return best;
+	}
+
+	// Move runs of instructions repeated in program out into subroutines added to the end of it, for as long as that
+	// saves space, and return how many instructions were saved. sequenceCount is overwritten with the number of
+	// subroutines added, and callCount with the number of places that now call one. Only runs that don't jump or
+	// touch $ca are moved, from places where $ca isn't read again before being written. Nothing is changed in
+	// programs that jump to addresses they worked out themselves.
+	unsigned int outlineRepeatedCode(ProgramEditor &program, unsigned int &sequenceCount, unsigned int &callCount) {
+		sequenceCount = 0;
+		callCount = 0;
+		if (program.size() == 0 || !program.canFollowEveryJump()) {
+			return 0;
+		}
+
+		// Keep going until nothing's left worth moving, since subroutines added can have runs of their own in
+		// common with the rest of the program.
+		const unsigned int originalSize = program.size();
+		while (true) {
+			Candidate best = findBestCandidate(program);
+			// Programs that run off the end (or return there from a call) need a jump over the subroutines to keep
+			// doing that, which costs one instruction more.
+			bool needsEndJump = InstructionFormat::fallsThrough(program.getInstruction(program.size() - 1u));
+			if (best.savedCount <= (needsEndJump ? 1 : 0)) {
+				break;
+			}
+			if (needsEndJump) {
+				program.insert(program.size(), InstructionFormat::makeInstruction("jmp", 0u, 0u, 0u),
+					program.getSourceLocation(program.size() - 1u));
+				program.setTarget(program.size() - 1u, program.size());
+			}
+
+			// Copy the first place the run turns up onto the end as the subroutine.
+			const unsigned int subroutineStart = program.size();
+			const unsigned int firstStart = best.starts.front();
+			for (unsigned int k = 0; k < best.length; k++) {
+				program.insert(program.size(), program.getInstruction(firstStart + k),
+					program.getSourceLocation(firstStart + k));
+			}
+			const unsigned int caRegister = InstructionFormat::getRegisterId("$ca");
+			program.insert(program.size(), InstructionFormat::makeInstruction("jr", 0u, caRegister, 0u),
+				program.getSourceLocation(firstStart + best.length - 1u));
+
+			// Then swap every place it turns up for a call. Calls replace the first instruction, so anything that
+			// jumped to the run now jumps to the call, and the rest of the run is removed last place first so that
+			// the earlier places don't move.
+			for (unsigned int start : best.starts) {
+				program.replaceInstruction(start, InstructionFormat::makeInstruction("call", 0u, 0u, 0u));
+				program.setTarget(start, subroutineStart);
+			}
+			for (unsigned int p = (unsigned int)best.starts.size(); p-- > 0;) {
+				for (unsigned int k = best.length - 1u; k > 0; k--) {
+					program.remove(best.starts[p] + k);
+				}
+			}
+			sequenceCount++;
+			callCount += (unsigned int)best.starts.size();
+		}
+		return originalSize - program.size();
+	}
+}
@@ -0,0 +1,19 @@
+#include "ProgramEditor.h"
+
+#ifndef CODE_OUTLINER_H
+#define CODE_OUTLINER_H
+
+// Contains a pass that shrinks programs by finding runs of instructions repeated in several places and moving them
+// out into a single subroutine, called from each of those places instead. This trades speed for space: every place
+// that calls the subroutine runs a call and a jr on top of what it ran before, but instruction memory only has room
+// for 512 instructions.
+namespace CodeOutliner {
+	// Move runs of instructions repeated in program out into subroutines added to the end of it, for as long as that
+	// saves space, and return how many instructions were saved. sequenceCount is overwritten with the number of
+	// subroutines added, and callCount with the number of places that now call one. Only runs that don't jump or
+	// touch $ca are moved, from places where $ca isn't read again before being written. Nothing is changed in
+	// programs that jump to addresses they worked out themselves.
+	unsigned int outlineRepeatedCode(ProgramEditor &program, unsigned int &sequenceCount, unsigned int &callCount);
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include <cstdlib>
+#include <stdexcept>
+#include "ConstantExpression.h"
+#include "Parser.h"
+
+namespace ConstantExpression {
+	// Smallest and largest values allowed anywhere in an expression, which covers every 32 bit number whether it's
+	// read as signed or unsigned.
+	static const std::int64_t MIN_VALUE = -(std::int64_t)0x80000000;
+	static const std::int64_t MAX_VALUE = (std::int64_t)0xffffffff;
+
+	// How far through reading an expression we are.
+	struct Reader {
+		const std::string &expression;
+		std::size_t position;
+		const std::function<bool(const std::string&, std::int64_t&)> &lookUpName;
+	};
+
+	static std::int64_t readOr(Reader &reader);
+
+	// Skip over any spaces at the reader's position.
+	static void skipSpaces(Reader &reader) {
+		while (reader.position < reader.expression.size() && reader.expression[reader.position] == ' ') {
+			reader.position++;
+		}
+	}
+
+	// Return true iff operation comes next in the reader, moving past it if so.
+	static bool readOperator(Reader &reader, const std::string &operation) {
+		skipSpaces(reader);
+		if (reader.expression.compare(reader.position, operation.size(), operation) != 0) {
+			return false;
+		}
+		// Don't mistake the first half of a shift for something else.
+		if (operation.size() == 1 && reader.position + 1 < reader.expression.size() &&
+			(operation == "<" || operation == ">") && reader.expression[reader.position + 1] == operation[0]) {
+			return false;
+		}
+		reader.position += operation.size();
+		return true;
+	}
+
+	// Return value, making sure it's still within the range allowed in an expression.
+	static std::int64_t checkRange(const Reader &reader, std::int64_t value) {
+		if (value < MIN_VALUE || value > MAX_VALUE) {
+			throw std::runtime_error("Expression " + reader.expression + " doesn't fit in 32 bits.");
+		}
+		return value;
+	}
+
+	// Return left * right, making sure it's still within the range allowed in an expression. The check comes first,
+	// since the product of two values in range can be too large even for 64 bits.
+	static std::int64_t multiply(const Reader &reader, std::int64_t left, std::int64_t right) {
+		if (right != 0 && std::llabs(left) > MAX_VALUE / std::llabs(right)) {
+			throw std::runtime_error("Expression " + reader.expression + " doesn't fit in 32 bits.");
+		}
+		return checkRange(reader, left * right);
+	}
+
+	// Read a number, name or parenthesized expression, with any unary operators in front of it.
+	static std::int64_t readUnary(Reader &reader) {
+		if (readOperator(reader, "-")) {
+			return checkRange(reader, -readUnary(reader));
+		}
+		if (readOperator(reader, "+")) {
+			return readUnary(reader);
+		}
+		if (readOperator(reader, "~")) {
+			return checkRange(reader, ~readUnary(reader));
+		}
+		if (readOperator(reader, "(")) {
+			std::int64_t value = readOr(reader);
+			if (!readOperator(reader, ")")) {
+				throw std::runtime_error("Missing ) in expression " + reader.expression + ".");
+			}
+			return value;
+		}
+
+		// Otherwise, it's a number or a name, running up to the next character that isn't a letter or digit.
+		const std::size_t start = reader.position;
+		while (reader.position < reader.expression.size() &&
+			(Parser::isAlphabetical(reader.expression[reader.position]) ||
+			Parser::isNumeric(reader.expression[reader.position]))) {
+			reader.position++;
+		}
+		const std::string word = reader.expression.substr(start, reader.position - start);
+		if (word.empty()) {
+			throw std::runtime_error("Invalid expression " + reader.expression + ".");
+		}
+		std::int64_t value = 0;
+		if (Parser::isAlphabetical(word[0])) {
+			if (!reader.lookUpName(word, value)) {
+				throw std::runtime_error("Undefined constant " + word + ".");
+			}
+			return value;
+		}
+		// Numbers are decimal unless they start with 0x.
+		const bool isHex = word.size() > 2 && word[0] == '0' && (word[1] == 'x' || word[1] == 'X');
+		for (std::size_t i = isHex ? 2u : 0u; i < word.size(); i++) {
+			char digit = word[i];
+			std::int64_t digitValue = 0;
+			if (Parser::isNumeric(digit)) {
+				digitValue = digit - '0';
+			}
+			else if (isHex && ((digit >= 'a' && digit <= 'f') || (digit >= 'A' && digit <= 'F'))) {
+				digitValue = (digit | 0x20) - 'a' + 10;
+			}
+			else {
+				throw std::runtime_error("Invalid number " + word + " in expression " + reader.expression + ".");
+			}
+			value = checkRange(reader, value * (isHex ? 16 : 10) + digitValue);
+		}
+		return value;
+	}
+
+	// Read a run of *, / and % operations.
+	static std::int64_t readProduct(Reader &reader) {
+		std::int64_t value = readUnary(reader);
+		while (true) {
+			const bool isMultiply = readOperator(reader, "*");
+			const bool isDivide = !isMultiply && readOperator(reader, "/");
+			if (!isMultiply && !isDivide && !readOperator(reader, "%")) {
+				return value;
+			}
+			std::int64_t operand = readUnary(reader);
+			if (isMultiply) {
+				value = multiply(reader, value, operand);
+			}
+			else if (operand == 0) {
+				throw std::runtime_error("Division by zero in expression " + reader.expression + ".");
+			}
+			else {
+				value = isDivide ? value / operand : value % operand;
+			}
+		}
+	}
+
+	// Read a run of + and - operations.
+	static std::int64_t readSum(Reader &reader) {
+		std::int64_t value = readProduct(reader);
+		while (true) {
+			if (readOperator(reader, "+")) {
+				value = checkRange(reader, value + readProduct(reader));
+			}
+			else if (readOperator(reader, "-")) {
+				value = checkRange(reader, value - readProduct(reader));
+			}
+			else {
+				return value;
+			}
+		}
+	}
+
+	// Read a run of << and >> operations.
+	static std::int64_t readShift(Reader &reader) {
+		std::int64_t value = readSum(reader);
+		while (true) {
+			const bool isLeft = readOperator(reader, "<<");
+			if (!isLeft && !readOperator(reader, ">>")) {
+				return value;
+			}
+			std::int64_t amount = readSum(reader);
+			if (amount < 0 || amount > 31) {
+				throw std::runtime_error("Shift amount out of range in expression " + reader.expression + ".");
+			}
+			value = isLeft ? multiply(reader, value, (std::int64_t)1 << amount) : value >> amount;
+		}
+	}
+
+	// Read a run of & operations.
+	static std::int64_t readAnd(Reader &reader) {
+		std::int64_t value = readShift(reader);
+		while (readOperator(reader, "&")) {
+			value &= readShift(reader);
+		}
+		return value;
+	}
+
+	// Read a run of ^ operations.
+	static std::int64_t readXor(Reader &reader) {
+		std::int64_t value = readAnd(reader);
+		while (readOperator(reader, "^")) {
+			value = checkRange(reader, value ^ readAnd(reader));
+		}
+		return value;
+	}
+
+	// Read a run of | operations, which is a whole expression.
+	static std::int64_t readOr(Reader &reader) {
+		std::int64_t value = readXor(reader);
+		while (readOperator(reader, "|")) {
+			value = checkRange(reader, value | readXor(reader));
+		}
+		return value;
+	}
+
+	// Return the value of expression, using lookUpName to find the value of every name in it, which should return
+	// false if the name isn't defined. Throws an exception if expression isn't a valid expression, uses an undefined
+	// name, divides by zero, shifts by a negative or too large amount, or works out to something that doesn't fit in
+	// 32 bits along the way.
+	std::int64_t evaluate(const std::string &expression,
+		const std::function<bool(const std::string&, std::int64_t&)> &lookUpName) {
+		Reader reader = {expression, 0u, lookUpName};
+		std::int64_t value = readOr(reader);
+		skipSpaces(reader);
+		if (reader.position != expression.size()) {
+			throw std::runtime_error("Invalid expression " + expression + ".");
+		}
+		return value;
+	}
+}
@@ -0,0 +1,22 @@
+#include <string>
+#include <functional>
+#include <cstdint>
+
+#ifndef CONSTANT_EXPRESSION_H
+#define CONSTANT_EXPRESSION_H
+
+// Contains the evaluator for constant expressions, which let immediate values and ;const directives be worked out by
+// the assembler (e.g. WIDTH*HEIGHT-1 or (BASE + 4) << 2) rather than by extra instructions at runtime. Expressions
+// are made up of whole numbers (decimal, or hex with 0x), names, parentheses and the operators +, -, *, /, %, <<,
+// >>, &, |, ^ and ~, which work and bind the same way they do in C. Spaces are only allowed inside parentheses, since
+// anywhere else they separate the operands of an instruction.
+namespace ConstantExpression {
+	// Return the value of expression, using lookUpName to find the value of every name in it, which should return
+	// false if the name isn't defined. Throws an exception if expression isn't a valid expression, uses an undefined
+	// name, divides by zero, shifts by a negative or too large amount, or works out to something that doesn't fit in
+	// 32 bits along the way.
+	std::int64_t evaluate(const std::string &expression,
+		const std::function<bool(const std::string&, std::int64_t&)> &lookUpName);
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include "ControlFlowGraph.h"
+#include "InstructionFormat.h"
+
+// Constructs the graph of program as it stands (editing the program afterwards leaves the graph out of date).
+// Requires program.canFollowEveryJump(), since otherwise there's no telling where some jumps go.
+ControlFlowGraph::ControlFlowGraph(ProgramEditor &program) {
+	const unsigned int programSize = program.size();
+
+	// A new block starts at the start of the program, at everything jumped to, and after every instruction that
+	// might not carry on to the next one.
+	std::vector<bool> startsBlock;
+	program.findJumpTargets(startsBlock);
+	if (programSize > 0) {
+		startsBlock[0] = true;
+	}
+	for (unsigned int i = 0; i + 1 < programSize; i++) {
+		const Instruction &instruction = program.getInstruction(i);
+		if (InstructionFormat::isJump(instruction) || !InstructionFormat::fallsThrough(instruction)) {
+			startsBlock[i + 1] = true;
+		}
+	}
+
+	for (unsigned int i = 0; i < programSize; i++) {
+		if (startsBlock[i]) {
+			this->blocks.push_back({i, i, {}, {}});
+		}
+		this->blocks.back().end = i + 1;
+		this->blockIndices.push_back((unsigned int)this->blocks.size() - 1);
+	}
+
+	// Every return can go back to just after any call. $ca starts out as 0 too, so returning without ever calling
+	// anything goes back to the start of the program.
+	std::vector<unsigned int> returnBlocks(1, 0u);
+	for (const Block &block : this->blocks) {
+		if (InstructionFormat::isCall(program.getInstruction(block.end - 1)) && block.end < programSize) {
+			returnBlocks.push_back(this->blockIndices[block.end]);
+		}
+	}
+
+	for (unsigned int i = 0; i < this->blocks.size(); i++) {
+		unsigned int last = this->blocks[i].end - 1;
+		const Instruction &instruction = program.getInstruction(last);
+		if (InstructionFormat::isIndirectJump(instruction)) {
+			for (unsigned int returnBlock : returnBlocks) {
+				this->addEdge(i, returnBlock);
+			}
+			continue;
+		}
+		// The instruction after a call is only reached by returning from the subroutine. Neither falling off the
+		// end of the program nor jumping there goes anywhere.
+		if (InstructionFormat::fallsThrough(instruction) && !InstructionFormat::isCall(instruction) &&
+			last + 1 < programSize) {
+			this->addEdge(i, this->blockIndices[last + 1]);
+		}
+		if (program.hasTarget(last) && program.getTarget(last) < programSize) {
+			this->addEdge(i, this->blockIndices[program.getTarget(last)]);
+		}
+	}
+}
+
+// Return every block in the program, in address order. The first block is where the program starts.
+const std::vector<ControlFlowGraph::Block> &ControlFlowGraph::getBlocks() const {
+	return this->blocks;
+}
+
+// Return the index of the block containing the instruction at index.
+unsigned int ControlFlowGraph::getBlockIndex(unsigned int index) const {
+	return this->blockIndices[index];
+}
+
+// Add an edge from block from to block to, unless there already is one.
+void ControlFlowGraph::addEdge(unsigned int from, unsigned int to) {
+	std::vector<unsigned int> &successors = this->blocks[from].successors;
+	if (std::find(successors.begin(), successors.end(), to) == successors.end()) {
+		successors.push_back(to);
+		this->blocks[to].predecessors.push_back(from);
+	}
+}
@@ -0,0 +1,42 @@
+#include <vector>
+#include "ProgramEditor.h"
+
+#ifndef CONTROL_FLOW_GRAPH_H
+#define CONTROL_FLOW_GRAPH_H
+
+// Represents how control can flow through a program, broken down into basic blocks: runs of instructions that are
+// always run from start to finish, since nothing jumps into the middle of them and only their last instruction can
+// jump anywhere. Calls go to the subroutine they call, and returns (jr $ca) go back to just after every call, since
+// there's no telling which one they return from.
+class ControlFlowGraph {
+public:
+	// A run of instructions that always runs from start to finish.
+	struct Block {
+		// Index of the first instruction in the block, and one past the index of the last one.
+		unsigned int start;
+		unsigned int end;
+		// Indices of every block that can run straight after this one, and straight before it.
+		std::vector<unsigned int> successors;
+		std::vector<unsigned int> predecessors;
+	};
+
+	// Constructs the graph of program as it stands (editing the program afterwards leaves the graph out of date).
+	// Requires program.canFollowEveryJump(), since otherwise there's no telling where some jumps go.
+	ControlFlowGraph(ProgramEditor &program);
+
+	// Return every block in the program, in address order. The first block is where the program starts.
+	const std::vector<Block> &getBlocks() const;
+	// Return the index of the block containing the instruction at index.
+	unsigned int getBlockIndex(unsigned int index) const;
+
+private:
+	// Add an edge from block from to block to, unless there already is one.
+	void addEdge(unsigned int from, unsigned int to);
+
+	// The blocks of the program, in address order.
+	std::vector<Block> blocks;
+	// Maps instruction indices onto the index of the block containing them.
+	std::vector<unsigned int> blockIndices;
+};
+
+#endif
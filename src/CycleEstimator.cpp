@@ -0,0 +1,542 @@
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include "CycleEstimator.h"
+#include "ControlFlowGraph.h"
+#include "InstructionFormat.h"
+#include "ProgramEditor.h"
+
+namespace CycleEstimator {
+	// Redstone ticks each kind of instruction takes to get through the Shiitake-16's pipeline.
+	static const unsigned int ALU_TICKS = 4u;
+	static const unsigned int MULTIPLY_TICKS = 16u;
+	static const unsigned int DIVIDE_TICKS = 32u;
+	static const unsigned int MEMORY_TICKS = 8u;
+	static const unsigned int JUMP_TICKS = 4u;
+	// Extra ticks taken by a jump that's actually taken, while the pipeline fills back up from the new address.
+	static const unsigned int TAKEN_JUMP_TICKS = 4u;
+	// Interrupts (?in, ?out and so on) hand over to the I/O system.
+	static const unsigned int INTERRUPT_TICKS = 12u;
+
+	// Stands for no block at all, e.g. for blocks that don't end in a call.
+	static const unsigned int NO_BLOCK = 0xffffffffu;
+
+	// How many ticks it takes to get through part of a routine, at worst and typically.
+	struct Cost {
+		std::uint64_t worst;
+		double typical;
+	};
+
+	// A basic block, as far as the routine it's part of goes. Calls carry on to just after the call once the
+	// subroutine is done, rather than going to the subroutine.
+	struct BlockInfo {
+		// Blocks that can run straight after this one, within the same routine.
+		std::vector<unsigned int> successors;
+		// Whether the routine can end with this block, by returning, ending the program or running off its end.
+		bool endsRoutine;
+		// The block this one calls at its end, or NO_BLOCK if it doesn't end in a call.
+		unsigned int calledBlock;
+		// Ticks the block's own instructions take, not counting any subroutine it calls.
+		Cost cost;
+	};
+
+	// What's known about how long a routine takes.
+	struct RoutineCost {
+		bool isBounded;
+		std::string problem;
+		Cost cost;
+	};
+
+	// Everything worked out about a program so far.
+	struct ProgramInfo {
+		// Every basic block of the program, in address order, and the address each starts at.
+		std::vector<BlockInfo> blocks;
+		std::vector<unsigned int> blockStarts;
+		// The name of a label pointing at each address that has one.
+		std::map<unsigned int, std::string> labelNames;
+		// Maps the addresses of loops with a ;bound onto their bounds.
+		std::map<unsigned int, unsigned int> loopBounds;
+		// How far along working out each block's cost as the start of a routine is (0 for not started, 1 for in
+		// progress and 2 for done), and the cost worked out for those that are done.
+		std::vector<unsigned int> routineStates;
+		std::vector<RoutineCost> routineCosts;
+	};
+
+	// Return the ticks instruction takes, including the extra for a jump if isTaken is set.
+	unsigned int getTicks(const Instruction &instruction, bool isTaken) {
+		const std::string &mnemonic = InstructionFormat::getMnemonic(instruction);
+		if (mnemonic == "mul") {
+			return MULTIPLY_TICKS;
+		}
+		if (mnemonic == "div") {
+			return DIVIDE_TICKS;
+		}
+		if (mnemonic == "lw" || mnemonic == "sw") {
+			return MEMORY_TICKS;
+		}
+		if (InstructionFormat::isJump(instruction) || InstructionFormat::isIndirectJump(instruction)) {
+			return JUMP_TICKS + (isTaken ? TAKEN_JUMP_TICKS : 0u);
+		}
+		if (mnemonic[0] == '?') {
+			return INTERRUPT_TICKS;
+		}
+		return ALU_TICKS;
+	}
+
+	// Return the label at address, or a description of the address if there isn't one.
+	static std::string describeAddress(const ProgramInfo &info, unsigned int address) {
+		std::map<unsigned int, std::string>::const_iterator label = info.labelNames.find(address);
+		return label != info.labelNames.end() ? label->second : "address " + std::to_string(address);
+	}
+
+	// Fill in info from program, whose jumps must all be possible to follow.
+	static void findBlocks(ProgramEditor &program, ProgramInfo &info) {
+		ControlFlowGraph graph(program);
+		const std::vector<ControlFlowGraph::Block> &blocks = graph.getBlocks();
+		info.blocks.resize(blocks.size());
+		for (unsigned int b = 0; b < blocks.size(); b++) {
+			BlockInfo &block = info.blocks[b];
+			info.blockStarts.push_back(blocks[b].start);
+			block.cost = {0u, 0.0};
+			for (unsigned int i = blocks[b].start; i < blocks[b].end; i++) {
+				unsigned int ticks = getTicks(program.getInstruction(i), false);
+				block.cost.worst += ticks;
+				block.cost.typical += ticks;
+			}
+
+			// Taken jumps cost extra, which conditional jumps are counted as doing half the time.
+			const unsigned int last = blocks[b].end - 1u;
+			const Instruction &instruction = program.getInstruction(last);
+			const bool hasNext = blocks[b].end < program.size();
+			const bool hasTarget = program.hasTarget(last) && program.getTarget(last) < program.size();
+			if (InstructionFormat::isJump(instruction) || InstructionFormat::isIndirectJump(instruction)) {
+				block.cost.worst += TAKEN_JUMP_TICKS;
+				block.cost.typical += InstructionFormat::isConditionalJump(instruction) ? TAKEN_JUMP_TICKS / 2.0 :
+					TAKEN_JUMP_TICKS;
+			}
+
+			// Work out where the block goes within its routine. Jumps past the end of the program end it.
+			block.calledBlock = NO_BLOCK;
+			block.endsRoutine = false;
+			if (InstructionFormat::isCall(instruction)) {
+				block.calledBlock = hasTarget ? graph.getBlockIndex(program.getTarget(last)) : NO_BLOCK;
+			}
+			else if (InstructionFormat::isJump(instruction)) {
+				if (hasTarget) {
+					block.successors.push_back(graph.getBlockIndex(program.getTarget(last)));
+				}
+				else {
+					block.endsRoutine = true;
+				}
+			}
+			if (!InstructionFormat::fallsThrough(instruction) && !InstructionFormat::isJump(instruction)) {
+				block.endsRoutine = true;
+			}
+			else if (InstructionFormat::fallsThrough(instruction)) {
+				if (hasNext) {
+					block.successors.push_back(b + 1u);
+				}
+				else {
+					block.endsRoutine = true;
+				}
+			}
+		}
+
+		info.routineStates.assign(blocks.size(), 0u);
+		info.routineCosts.resize(blocks.size());
+	}
+
+	// Work out the worst case and typical cost of getting from start to the end of a part of a routine that has no
+	// loops left in it. The part is made up of the nodes with isNode set, and edges gives every edge between them.
+	// Costs are overwritten with the cost of getting from start to the end of each node. Return false if the nodes
+	// turn out to loop after all.
+	static bool findPathCosts(unsigned int start, const std::vector<bool> &isNode,
+		const std::vector<std::pair<unsigned int, unsigned int> > &edges, const std::vector<Cost> &nodeCosts,
+		std::vector<Cost> &costs) {
+		// Go through the nodes so that every node comes after everything leading into it.
+		std::vector<unsigned int> incomingCounts(isNode.size(), 0u);
+		for (const std::pair<unsigned int, unsigned int> &edge : edges) {
+			incomingCounts[edge.second]++;
+		}
+		std::vector<std::vector<unsigned int> > predecessors(isNode.size());
+		for (const std::pair<unsigned int, unsigned int> &edge : edges) {
+			predecessors[edge.second].push_back(edge.first);
+		}
+		std::vector<unsigned int> ready(1u, start);
+		if (incomingCounts[start] != 0u) {
+			return false;
+		}
+		costs.assign(isNode.size(), {0u, 0.0});
+		unsigned int doneCount = 0;
+		while (!ready.empty()) {
+			unsigned int node = ready.back();
+			ready.pop_back();
+			doneCount++;
+
+			// The worst way in is the one that costs the most, and each way in is taken equally often.
+			Cost cost = {0u, 0.0};
+			for (unsigned int predecessor : predecessors[node]) {
+				cost.worst = std::max(cost.worst, costs[predecessor].worst);
+				cost.typical += costs[predecessor].typical / predecessors[node].size();
+			}
+			costs[node] = {cost.worst + nodeCosts[node].worst, cost.typical + nodeCosts[node].typical};
+			for (const std::pair<unsigned int, unsigned int> &edge : edges) {
+				if (edge.first == node && --incomingCounts[edge.second] == 0u) {
+					ready.push_back(edge.second);
+				}
+			}
+		}
+		return doneCount == (unsigned int)std::count(isNode.begin(), isNode.end(), true);
+	}
+
+	// Return the worst case and typical cost of a part of a routine, given the costs of getting to the end of each of
+	// its nodes and the nodes it can end at.
+	static Cost combineEnds(const std::vector<Cost> &costs, const std::vector<unsigned int> &ends) {
+		Cost cost = {0u, 0.0};
+		for (unsigned int end : ends) {
+			cost.worst = std::max(cost.worst, costs[end].worst);
+			cost.typical += costs[end].typical / ends.size();
+		}
+		return cost;
+	}
+
+	static RoutineCost estimateRoutine(ProgramInfo &info, unsigned int entry);
+
+	// Work out the cost of the routine starting at the block entry, which must be in progress in info.
+	static RoutineCost findRoutineCost(ProgramInfo &info, unsigned int entry) {
+		const unsigned int blockCount = (unsigned int)info.blocks.size();
+
+		// Find every block in the routine, and what each one costs along with any subroutine it calls.
+		std::vector<bool> isInRoutine(blockCount, false);
+		std::vector<unsigned int> routineBlocks(1u, entry);
+		isInRoutine[entry] = true;
+		for (unsigned int i = 0; i < routineBlocks.size(); i++) {
+			for (unsigned int successor : info.blocks[routineBlocks[i]].successors) {
+				if (!isInRoutine[successor]) {
+					isInRoutine[successor] = true;
+					routineBlocks.push_back(successor);
+				}
+			}
+		}
+		std::vector<Cost> nodeCosts(blockCount, {0u, 0.0});
+		for (unsigned int b : routineBlocks) {
+			nodeCosts[b] = info.blocks[b].cost;
+			unsigned int called = info.blocks[b].calledBlock;
+			if (called == NO_BLOCK) {
+				continue;
+			}
+			if (info.routineStates[called] == 1u) {
+				return {false, "it's recursive (through " + describeAddress(info, info.blockStarts[called]) + ")",
+					{0u, 0.0}};
+			}
+			RoutineCost calledCost = estimateRoutine(info, called);
+			if (!calledCost.isBounded) {
+				return {false, "it calls " + describeAddress(info, info.blockStarts[called]) + ", which can't be "
+					"bounded", {0u, 0.0}};
+			}
+			nodeCosts[b].worst += calledCost.cost.worst;
+			nodeCosts[b].typical += calledCost.cost.typical;
+		}
+
+		// Loops are found by the jumps going back to a block that's still being followed in a depth first search,
+		// which must be the only way into the loop for it to be bounded. Immediate dominators are found along the
+		// way (see "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy).
+		std::vector<unsigned int> postOrder;
+		std::vector<std::pair<unsigned int, unsigned int> > backEdges;
+		std::vector<unsigned int> searchStates(blockCount, 0u);
+		std::vector<std::pair<unsigned int, unsigned int> > stack(1u, {entry, 0u});
+		searchStates[entry] = 1u;
+		while (!stack.empty()) {
+			unsigned int b = stack.back().first;
+			unsigned int &nextSuccessor = stack.back().second;
+			if (nextSuccessor == info.blocks[b].successors.size()) {
+				searchStates[b] = 2u;
+				postOrder.push_back(b);
+				stack.pop_back();
+				continue;
+			}
+			unsigned int successor = info.blocks[b].successors[nextSuccessor++];
+			if (searchStates[successor] == 1u) {
+				backEdges.push_back({b, successor});
+			}
+			else if (searchStates[successor] == 0u) {
+				searchStates[successor] = 1u;
+				stack.push_back({successor, 0u});
+			}
+		}
+		std::vector<unsigned int> postOrderIndices(blockCount, 0u);
+		for (unsigned int i = 0; i < postOrder.size(); i++) {
+			postOrderIndices[postOrder[i]] = i;
+		}
+		std::vector<std::vector<unsigned int> > predecessors(blockCount);
+		for (unsigned int b : routineBlocks) {
+			for (unsigned int successor : info.blocks[b].successors) {
+				predecessors[successor].push_back(b);
+			}
+		}
+		std::vector<unsigned int> dominators(blockCount, NO_BLOCK);
+		dominators[entry] = entry;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (unsigned int i = (unsigned int)postOrder.size(); i-- > 0;) {
+				unsigned int b = postOrder[i];
+				if (b == entry) {
+					continue;
+				}
+				unsigned int dominator = NO_BLOCK;
+				for (unsigned int predecessor : predecessors[b]) {
+					if (dominators[predecessor] == NO_BLOCK) {
+						continue;
+					}
+					unsigned int other = predecessor;
+					while (dominator != NO_BLOCK && other != dominator) {
+						while (postOrderIndices[other] < postOrderIndices[dominator]) {
+							other = dominators[other];
+						}
+						while (postOrderIndices[dominator] < postOrderIndices[other]) {
+							dominator = dominators[dominator];
+						}
+					}
+					dominator = other;
+				}
+				if (dominator != dominators[b]) {
+					dominators[b] = dominator;
+					changed = true;
+				}
+			}
+		}
+
+		// Every loop is made up of its first block and every block that can get back to it without going through
+		// it. Loops with the same first block are counted as one.
+		std::map<unsigned int, std::vector<bool> > loops;
+		for (const std::pair<unsigned int, unsigned int> &edge : backEdges) {
+			unsigned int dominator = edge.first;
+			while (dominator != edge.second && dominator != entry) {
+				dominator = dominators[dominator];
+			}
+			if (dominator != edge.second) {
+				return {false, "the loop at " + describeAddress(info, info.blockStarts[edge.second]) +
+					" can be jumped into partway through", {0u, 0.0}};
+			}
+			std::vector<bool> &body = loops[edge.second];
+			body.resize(blockCount, false);
+			body[edge.second] = true;
+			std::vector<unsigned int> toVisit(1u, edge.first);
+			while (!toVisit.empty()) {
+				unsigned int b = toVisit.back();
+				toVisit.pop_back();
+				if (body[b]) {
+					continue;
+				}
+				body[b] = true;
+				toVisit.insert(toVisit.end(), predecessors[b].begin(), predecessors[b].end());
+			}
+		}
+
+		// Work out the cost of each loop, innermost first, then stand the whole loop in for its first block from
+		// then on. Loops run at most their bound and typically half of it, going all the way round every time
+		// but the last, which ends partway through wherever the loop is left.
+		std::vector<std::pair<unsigned int, unsigned int> > loopOrder;
+		for (const std::pair<const unsigned int, std::vector<bool> > &loop : loops) {
+			loopOrder.push_back({(unsigned int)std::count(loop.second.begin(), loop.second.end(), true), loop.first});
+		}
+		std::sort(loopOrder.begin(), loopOrder.end());
+		std::vector<unsigned int> representatives(blockCount);
+		for (unsigned int b = 0; b < blockCount; b++) {
+			representatives[b] = b;
+		}
+		std::vector<Cost> costs;
+		for (const std::pair<unsigned int, unsigned int> &loopEntry : loopOrder) {
+			const unsigned int header = loopEntry.second;
+			const std::vector<bool> &body = loops[header];
+			std::map<unsigned int, unsigned int>::const_iterator bound =
+				info.loopBounds.find(info.blockStarts[header]);
+			if (bound == info.loopBounds.end()) {
+				return {false, "the loop at " + describeAddress(info, info.blockStarts[header]) +
+					" has no ;bound", {0u, 0.0}};
+			}
+
+			std::vector<bool> isNode(blockCount, false);
+			std::vector<std::pair<unsigned int, unsigned int> > edges;
+			std::vector<unsigned int> latches;
+			std::vector<unsigned int> ends;
+			for (unsigned int b : routineBlocks) {
+				if (!body[b]) {
+					continue;
+				}
+				unsigned int node = representatives[b];
+				isNode[node] = true;
+				if (info.blocks[b].endsRoutine) {
+					ends.push_back(node);
+				}
+				for (unsigned int successor : info.blocks[b].successors) {
+					unsigned int next = representatives[successor];
+					if (!body[successor]) {
+						ends.push_back(node);
+					}
+					else if (next == header) {
+						latches.push_back(node);
+					}
+					else if (next != node) {
+						edges.push_back({node, next});
+					}
+				}
+			}
+			if (!findPathCosts(header, isNode, edges, nodeCosts, costs)) {
+				return {false, "the loop at " + describeAddress(info, info.blockStarts[header]) + " can't be followed",
+					{0u, 0.0}};
+			}
+
+			// Loops that never end on their own only ever stop after running their bound.
+			Cost round = combineEnds(costs, latches);
+			Cost last = ends.empty() ? round : combineEnds(costs, ends);
+			const double typicalRuns = (bound->second + 1u) / 2.0;
+			nodeCosts[header] = {(bound->second - 1u) * round.worst + last.worst,
+				(typicalRuns - 1.0) * round.typical + last.typical};
+			for (unsigned int b : routineBlocks) {
+				if (body[b]) {
+					representatives[b] = header;
+				}
+			}
+		}
+
+		// Now that there are no loops left, the routine costs whatever it takes to get to any of its ends.
+		std::vector<bool> isNode(blockCount, false);
+		std::vector<bool> isEnd(blockCount, false);
+		std::vector<std::pair<unsigned int, unsigned int> > edges;
+		for (unsigned int b : routineBlocks) {
+			unsigned int node = representatives[b];
+			isNode[node] = true;
+			isEnd[node] = isEnd[node] || info.blocks[b].endsRoutine;
+			for (unsigned int successor : info.blocks[b].successors) {
+				if (representatives[successor] != node) {
+					edges.push_back({node, representatives[successor]});
+				}
+			}
+		}
+		std::vector<unsigned int> ends;
+		for (unsigned int b = 0; b < blockCount; b++) {
+			bool hasSuccessor = std::any_of(edges.begin(), edges.end(),
+				[b](const std::pair<unsigned int, unsigned int> &edge) { return edge.first == b; });
+			if (isNode[b] && (isEnd[b] || !hasSuccessor)) {
+				ends.push_back(b);
+			}
+		}
+		if (!findPathCosts(entry, isNode, edges, nodeCosts, costs)) {
+			return {false, "it has loops that can't be followed", {0u, 0.0}};
+		}
+		return {true, "", combineEnds(costs, ends)};
+	}
+
+	// Return the cost of the routine starting at the block entry, working it out if it hasn't been already.
+	static RoutineCost estimateRoutine(ProgramInfo &info, unsigned int entry) {
+		if (info.routineStates[entry] != 2u) {
+			info.routineStates[entry] = 1u;
+			info.routineCosts[entry] = findRoutineCost(info, entry);
+			info.routineStates[entry] = 2u;
+		}
+		return info.routineCosts[entry];
+	}
+
+	// Return true iff the routine might take longer than its budget (including if it might never finish).
+	bool RoutineEstimate::isOverBudget() const {
+		return this->hasBudget && (!this->isBounded || this->worstCaseTicks > this->budget);
+	}
+
+	// Estimate how long every routine of program (which must have been assembled without problems) takes to run,
+	// in address order.
+	std::vector<RoutineEstimate> estimateRoutines(const Assembler::Result &program) {
+		std::vector<RoutineEstimate> estimates;
+		if (program.machineCode.empty()) {
+			return estimates;
+		}
+
+		// Routines start at the start of the program, at everything that's called and at every label with a
+		// budget, and they're named after the label there (preferring one with a budget).
+		ProgramInfo info;
+		std::map<unsigned int, std::string> routineNames;
+		for (const std::pair<const std::string, unsigned int> &label : program.labels) {
+			info.labelNames.insert({label.second, label.first});
+		}
+		for (const std::pair<const std::string, unsigned int> &budget : program.budgets) {
+			std::map<std::string, unsigned int>::const_iterator label = program.labels.find(budget.first);
+			if (label != program.labels.end() && label->second < program.machineCode.size()) {
+				routineNames[label->second] = budget.first;
+			}
+		}
+		for (const std::pair<const std::string, unsigned int> &bound : program.loopBounds) {
+			std::map<std::string, unsigned int>::const_iterator label = program.labels.find(bound.first);
+			if (label != program.labels.end()) {
+				info.loopBounds[label->second] = bound.second;
+			}
+		}
+		ProgramEditor editor(program);
+		routineNames.insert({0u, info.labelNames.count(0u) > 0 ? info.labelNames[0u] : "(start)"});
+		for (unsigned int i = 0; i < editor.size(); i++) {
+			if (InstructionFormat::isCall(editor.getInstruction(i)) && editor.hasTarget(i) &&
+				editor.getTarget(i) < editor.size()) {
+				routineNames.insert({editor.getTarget(i), describeAddress(info, editor.getTarget(i))});
+			}
+		}
+
+		// Programs that jump to addresses they worked out themselves could go anywhere.
+		bool canFollow = editor.canFollowEveryJump();
+		if (canFollow) {
+			findBlocks(editor, info);
+		}
+		for (const std::pair<const unsigned int, std::string> &routine : routineNames) {
+			RoutineEstimate estimate;
+			estimate.name = routine.second;
+			estimate.address = routine.first;
+			std::map<std::string, unsigned int>::const_iterator budget = program.budgets.find(routine.second);
+			estimate.hasBudget = budget != program.budgets.end();
+			estimate.budget = estimate.hasBudget ? budget->second : 0u;
+			RoutineCost cost = {false, "not every jump in the program can be followed", {0u, 0.0}};
+			if (canFollow) {
+				std::vector<unsigned int>::const_iterator block = std::upper_bound(info.blockStarts.begin(),
+					info.blockStarts.end(), routine.first);
+				unsigned int b = (unsigned int)(block - info.blockStarts.begin()) - 1u;
+				// Routines have to start at the start of a block to be worked out on their own.
+				if (info.blockStarts[b] == routine.first) {
+					cost = estimateRoutine(info, b);
+				}
+				else {
+					cost.problem = "something falls into it partway through a block";
+				}
+			}
+			estimate.isBounded = cost.isBounded;
+			estimate.problem = cost.problem;
+			estimate.worstCaseTicks = cost.cost.worst;
+			estimate.typicalTicks = (std::uint64_t)(cost.cost.typical + 0.5);
+			estimates.push_back(estimate);
+		}
+		return estimates;
+	}
+
+	// Return a description of every estimate in estimates, one routine per line.
+	std::string describeEstimates(const std::vector<RoutineEstimate> &estimates) {
+		std::ostringstream description;
+		description << "Estimated ticks per instruction: " << ALU_TICKS << " ALU, " << MULTIPLY_TICKS << " mul, "
+			<< DIVIDE_TICKS << " div, " << MEMORY_TICKS << " lw/sw, " << JUMP_TICKS << " jump (" << TAKEN_JUMP_TICKS
+			<< " more if taken), " << INTERRUPT_TICKS << " interrupt (not counting waiting for input)." << std::endl;
+		for (const RoutineEstimate &estimate : estimates) {
+			description << estimate.name << " (address " << estimate.address << "): ";
+			if (estimate.isBounded) {
+				description << "worst case " << estimate.worstCaseTicks << " ticks, typical " << estimate.typicalTicks
+					<< " ticks";
+			}
+			else {
+				description << "can't be bounded, since " << estimate.problem;
+			}
+			if (estimate.hasBudget) {
+				description << ", budget " << estimate.budget << " ticks";
+				if (estimate.isOverBudget()) {
+					description << " (OVER BUDGET)";
+				}
+			}
+			description << std::endl;
+		}
+		return description.str();
+	}
+}
@@ -0,0 +1,47 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Assembler.h"
+
+#ifndef CYCLE_ESTIMATOR_H
+#define CYCLE_ESTIMATOR_H
+
+// Contains an analysis that estimates how many redstone ticks each routine of a program takes to run on the
+// Shiitake-16, without running it, so that programs can be checked against the game tick budgets they're scheduled
+// in before being deployed. Loops can run any number of times as far as the assembler can tell, so every loop needs a
+// ;bound directive (e.g. ;bound loopStart 10) giving the most times it runs. Routines can be given a ;budget directive
+// (e.g. ;budget recFib 2000) to have any that might take longer flagged.
+namespace CycleEstimator {
+	// How long a single routine (the start of the program, a subroutine that's called somewhere, or any label
+	// with a ;budget) takes to run, from its first instruction until it returns or the program ends.
+	struct RoutineEstimate {
+		// Label the routine starts at (or "(start)" for the start of a program with no label there), and its
+		// address.
+		std::string name;
+		unsigned int address;
+		// Whether the routine can be shown to finish at all, and if not, why not.
+		bool isBounded;
+		std::string problem;
+		// Most ticks the routine can take, and how many it takes going down every branch equally often with
+		// loops running half their bound. Both include every subroutine it calls, but not time spent waiting for
+		// input.
+		std::uint64_t worstCaseTicks;
+		std::uint64_t typicalTicks;
+		// Whether the routine has a ;budget, and if so how many ticks it is.
+		bool hasBudget;
+		unsigned int budget;
+
+		// Return true iff the routine might take longer than its budget (including if it might never finish).
+		bool isOverBudget() const;
+	};
+
+	// Return the ticks instruction takes, including the extra for a jump if isTaken is set.
+	unsigned int getTicks(const Instruction &instruction, bool isTaken);
+	// Estimate how long every routine of program (which must have been assembled without problems) takes to run,
+	// in address order.
+	std::vector<RoutineEstimate> estimateRoutines(const Assembler::Result &program);
+	// Return a description of every estimate in estimates, one routine per line.
+	std::string describeEstimates(const std::vector<RoutineEstimate> &estimates);
+};
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "DataMemory.h"
 
 std::vector<WORD> DataMemory::words(DATA_MEMORY_SIZE, 0u);
@@ -57,3 +58,20 @@ WORD DataMemory::getWord(WORD address) {
 
 	return DataMemory::words[address];
 }
+
+// Set every word of memory back to zero.
+void DataMemory::reset() {
+	DataMemory::words.assign(DATA_MEMORY_SIZE, 0u);
+}
+
+// Set every word of memory back to its value in image (e.g. a program's initial data), where image[i] is the value of
+// the word at address i. Words past the end of image are set to zero. Throws an exception if image is larger than
+// memory.
+void DataMemory::load(const std::vector<WORD> &image) {
+	if (image.size() > DATA_MEMORY_SIZE) {
+		throw std::runtime_error("Data image of " + std::to_string(image.size()) + " words doesn't fit in " +
+			std::to_string(DATA_MEMORY_SIZE) + " words of data memory!");
+	}
+	DataMemory::reset();
+	std::copy(image.begin(), image.end(), DataMemory::words.begin());
+}
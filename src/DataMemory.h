@@ -1,9 +1,6 @@
 #include "RegisterFile.h"
 #include <iostream>
 
-// Size of data memory in 16-bit words.
-#define DATA_MEMORY_SIZE 256u
-
 #ifndef DATAMEMORY_H
 #define DATAMEMORY_H
 
@@ -20,6 +17,12 @@ public:
 
 	// Return the value of the word stored at address.
 	static WORD getWord(WORD address);
+	// Set every word of memory back to zero.
+	static void reset();
+	// Set every word of memory back to its value in image (e.g. a program's initial data), where image[i] is the value
+	// of the word at address i. Words past the end of image are set to zero. Throws an exception if image is larger
+	// than memory.
+	static void load(const std::vector<WORD> &image);
 private:
 	// Array of words, where an index i represents the value at address i, where addresses are word-indexed.
 	static std::vector<WORD> words;
@@ -0,0 +1,348 @@
+#include <cstdint>
+#include <sstream>
+#include "DataflowOptimizer.h"
+#include "ControlFlowGraph.h"
+#include "InstructionFormat.h"
+
+namespace DataflowOptimizer {
+	// Number of registers there are, i.e. everything a 5 bit register field can name.
+	static const unsigned int REGISTER_COUNT = 32u;
+
+	// What's known about the value of a register at some point in the program.
+	struct RegisterValue {
+		// Whether the register always holds the same value there, and if so what it is.
+		bool isConstant;
+		std::uint16_t value;
+	};
+
+	// What's known about every register at some point in the program, indexed by register id.
+	typedef std::vector<RegisterValue> RegisterState;
+
+	// Return a mask with a bit set for every register in registers. $zero never changes, so it's left out.
+	static std::uint32_t toMask(const std::vector<unsigned int> &registers) {
+		static const unsigned int zeroRegister = InstructionFormat::getRegisterId("$zero");
+		std::uint32_t mask = 0u;
+		for (unsigned int registerId : registers) {
+			if (registerId != zeroRegister) {
+				mask |= 1u << registerId;
+			}
+		}
+		return mask;
+	}
+
+	// Work out what instruction would write to its destination, given what's known about the registers going into
+	// it. Return true iff that can be known before the program runs, in which case result is overwritten with it.
+	static bool evaluate(const Instruction &instruction, const RegisterState &state, std::uint16_t &result) {
+		const std::string &mnemonic = InstructionFormat::getMnemonic(instruction);
+		const RegisterValue &valueA = state[InstructionFormat::getReadA(instruction)];
+		const RegisterValue &valueB = state[InstructionFormat::getReadB(instruction)];
+		std::uint16_t a = valueA.value;
+		std::uint16_t b = valueB.value;
+		std::uint16_t immediate = (std::uint16_t)InstructionFormat::getImmediate(instruction);
+		if (!valueA.isConstant) {
+			return false;
+		}
+
+		// Instructions with an immediate value. Shifts are only worked out when they're small enough to mean the
+		// same thing everywhere, and right shifts not at all, since whether they keep the sign isn't pinned down.
+		if (mnemonic == "addi") {
+			result = (std::uint16_t)(a + immediate);
+		}
+		else if (mnemonic == "andi") {
+			result = a & immediate;
+		}
+		else if (mnemonic == "ori") {
+			result = a | immediate;
+		}
+		else if (mnemonic == "xori") {
+			result = a ^ immediate;
+		}
+		else if (mnemonic == "nori") {
+			result = (std::uint16_t)~(a | immediate);
+		}
+		else if (mnemonic == "slli" && immediate < 16u) {
+			result = (std::uint16_t)(a << immediate);
+		}
+		// Everything else reads two registers.
+		else if (!valueB.isConstant) {
+			return false;
+		}
+		else if (mnemonic == "add") {
+			result = (std::uint16_t)(a + b);
+		}
+		else if (mnemonic == "sub") {
+			result = (std::uint16_t)(a - b);
+		}
+		else if (mnemonic == "and") {
+			result = a & b;
+		}
+		else if (mnemonic == "or") {
+			result = a | b;
+		}
+		else if (mnemonic == "xor") {
+			result = a ^ b;
+		}
+		else if (mnemonic == "nor") {
+			result = (std::uint16_t)~(a | b);
+		}
+		else if (mnemonic == "sll" && b < 16u) {
+			result = (std::uint16_t)(a << b);
+		}
+		// Comparisons are signed, and set one bit for equal, less than or greater than, in that order.
+		else if (mnemonic == "cmp") {
+			std::int16_t signedA = (std::int16_t)a;
+			std::int16_t signedB = (std::int16_t)b;
+			result = signedA == signedB ? 0b001 : (signedA < signedB ? 0b010 : 0b100);
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	// Update state to what's known about the registers once instruction has run.
+	static void runInstruction(const Instruction &instruction, RegisterState &state) {
+		std::vector<unsigned int> written;
+		InstructionFormat::getWrittenRegisters(instruction, written);
+		if (written.empty()) {
+			return;
+		}
+		std::uint16_t result = 0u;
+		bool isConstant = written.size() == 1 && evaluate(instruction, state, result);
+		for (unsigned int registerId : written) {
+			state[registerId] = {isConstant, result};
+		}
+	}
+
+	// If jump is a conditional jump that is always or never taken given what's known about the registers going into
+	// it, return true and overwrite isTaken with which.
+	static bool isDecided(const Instruction &jump, const RegisterState &state, bool &isTaken) {
+		const RegisterValue &condition = state[InstructionFormat::getReadA(jump)];
+		if (!InstructionFormat::isConditionalJump(jump) || !condition.isConstant) {
+			return false;
+		}
+		// Each conditional jump looks for its own bit of a cmp result.
+		std::uint16_t wanted = InstructionFormat::is(jump, "jeq") ? 0b001 :
+			(InstructionFormat::is(jump, "jlt") ? 0b010 : 0b100);
+		isTaken = condition.value == wanted;
+		return true;
+	}
+
+	// Work out what's known about every register going into every block of graph, overwriting states. Blocks that
+	// can never be reached are marked as such in reached, and their states are meaningless. Jumps that can be
+	// decided are only followed the way they'll actually go, so that values from blocks that never run don't get in
+	// the way.
+	static void findConstants(ProgramEditor &program, const ControlFlowGraph &graph, std::vector<bool> &reached,
+		std::vector<RegisterState> &states) {
+		const std::vector<ControlFlowGraph::Block> &blocks = graph.getBlocks();
+		reached.assign(blocks.size(), false);
+		states.assign(blocks.size(), RegisterState(REGISTER_COUNT, {false, 0u}));
+		if (blocks.empty()) {
+			return;
+		}
+
+		// Registers could hold anything when the program starts, except $zero.
+		reached[0] = true;
+		states[0][InstructionFormat::getRegisterId("$zero")] = {true, 0u};
+		std::vector<unsigned int> toVisit(1, 0u);
+		while (toVisit.size() > 0) {
+			unsigned int blockIndex = toVisit.back();
+			toVisit.pop_back();
+			const ControlFlowGraph::Block &block = blocks[blockIndex];
+
+			RegisterState state = states[blockIndex];
+			for (unsigned int i = block.start; i < block.end; i++) {
+				runInstruction(program.getInstruction(i), state);
+			}
+
+			// If the jump at the end can be decided, only follow it the way it goes.
+			std::vector<unsigned int> successors = block.successors;
+			bool isTaken = false;
+			if (isDecided(program.getInstruction(block.end - 1), state, isTaken)) {
+				successors.clear();
+				unsigned int next = isTaken ? program.getTarget(block.end - 1) : block.end;
+				if (next < program.size()) {
+					successors.push_back(graph.getBlockIndex(next));
+				}
+			}
+
+			// Merge what's known into every successor, only keeping values that agree, and go over any successor
+			// that learned something new again.
+			for (unsigned int successor : successors) {
+				bool changed = !reached[successor];
+				if (!reached[successor]) {
+					reached[successor] = true;
+					states[successor] = state;
+				}
+				else {
+					for (unsigned int r = 0; r < REGISTER_COUNT; r++) {
+						RegisterValue &merged = states[successor][r];
+						if (merged.isConstant && (!state[r].isConstant || state[r].value != merged.value)) {
+							merged.isConstant = false;
+							changed = true;
+						}
+					}
+				}
+				if (changed) {
+					toVisit.push_back(successor);
+				}
+			}
+		}
+	}
+
+	// Replace every conditional jump that always goes the same way with a jmp, or remove it if it never jumps.
+	// Return true iff anything changed.
+	static bool foldJumps(ProgramEditor &program) {
+		ControlFlowGraph graph(program);
+		std::vector<bool> reached;
+		std::vector<RegisterState> states;
+		findConstants(program, graph, reached, states);
+
+		// Go backwards, so removing jumps doesn't move the ones still to go.
+		const std::vector<ControlFlowGraph::Block> &blocks = graph.getBlocks();
+		bool changed = false;
+		for (unsigned int b = (unsigned int)blocks.size(); b-- > 0;) {
+			if (!reached[b]) {
+				continue;
+			}
+			RegisterState state = states[b];
+			for (unsigned int i = blocks[b].start; i + 1 < blocks[b].end; i++) {
+				runInstruction(program.getInstruction(i), state);
+			}
+			unsigned int last = blocks[b].end - 1;
+			bool isTaken = false;
+			if (isDecided(program.getInstruction(last), state, isTaken)) {
+				if (isTaken) {
+					program.replaceInstruction(last, InstructionFormat::makeInstruction("jmp", 0u, 0u, 0u));
+				}
+				else {
+					program.remove(last);
+				}
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	// Work out which registers are live (i.e. might still be read before being written again) going into and
+	// coming out of every block of graph, overwriting liveIn and liveOut with a mask of registers for each block
+	// (bit n standing for the register with id n).
+	void findLiveRegisters(ProgramEditor &program, const ControlFlowGraph &graph, std::vector<std::uint32_t> &liveIn,
+		std::vector<std::uint32_t> &liveOut) {
+		const std::vector<ControlFlowGraph::Block> &blocks = graph.getBlocks();
+		liveIn.assign(blocks.size(), 0u);
+		liveOut.assign(blocks.size(), 0u);
+
+		// Keep going over every block, last first since liveness flows backwards, until nothing changes.
+		std::vector<unsigned int> registers;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (unsigned int b = (unsigned int)blocks.size(); b-- > 0;) {
+				std::uint32_t live = 0u;
+				for (unsigned int successor : blocks[b].successors) {
+					live |= liveIn[successor];
+				}
+				liveOut[b] = live;
+				for (unsigned int i = blocks[b].end; i-- > blocks[b].start;) {
+					InstructionFormat::getWrittenRegisters(program.getInstruction(i), registers);
+					live &= ~toMask(registers);
+					InstructionFormat::getReadRegisters(program.getInstruction(i), registers);
+					live |= toMask(registers);
+				}
+				if (live != liveIn[b]) {
+					liveIn[b] = live;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	// Remove every instruction that does nothing but write registers that are never read afterwards. Return true
+	// iff anything changed.
+	static bool removeDeadWrites(ProgramEditor &program) {
+		ControlFlowGraph graph(program);
+		std::vector<std::uint32_t> liveIn;
+		std::vector<std::uint32_t> liveOut;
+		findLiveRegisters(program, graph, liveIn, liveOut);
+
+		// Go backwards through every block, keeping track of what's live after each instruction. Instructions that
+		// are removed don't read anything, so removing one can make the instructions before it dead too. Removing
+		// instructions only moves the ones after them, so jump targets found up front stay right for the rest.
+		const std::vector<ControlFlowGraph::Block> &blocks = graph.getBlocks();
+		std::vector<unsigned int> registers;
+		std::vector<bool> isTarget;
+		program.findJumpTargets(isTarget);
+		unsigned int storeIndex = 0;
+		bool changed = false;
+		for (unsigned int b = (unsigned int)blocks.size(); b-- > 0;) {
+			std::uint32_t live = liveOut[b];
+			for (unsigned int i = blocks[b].end; i-- > blocks[b].start;) {
+				const Instruction &instruction = program.getInstruction(i);
+				InstructionFormat::getWrittenRegisters(instruction, registers);
+				std::uint32_t written = toMask(registers);
+				// A lw of a word that was just stored can't go out of range (the sw would have first), so restoring
+				// a register that's never read again (e.g. at the end of an inlined subroutine) can go too.
+				bool canRemove = InstructionFormat::onlyWritesRegisters(instruction) ||
+					program.findMatchingStore(i, isTarget, storeIndex);
+				if (canRemove && (written & live) == 0u) {
+					program.remove(i);
+					changed = true;
+					continue;
+				}
+				live &= ~written;
+				InstructionFormat::getReadRegisters(instruction, registers);
+				live |= toMask(registers);
+			}
+		}
+		return changed;
+	}
+
+	// Rewrite program into an equivalent one that runs fewer instructions, and return how many instructions were
+	// removed. Nothing is changed in programs that jump to addresses they worked out themselves, since there's no
+	// telling where their values flow.
+	unsigned int optimize(ProgramEditor &program) {
+		if (!program.canFollowEveryJump()) {
+			return 0;
+		}
+
+		// Deciding jumps can leave values unread, and removing unread values can't hurt deciding jumps, so keep
+		// going until neither finds anything more to do.
+		const unsigned int originalSize = program.size();
+		while (foldJumps(program) || removeDeadWrites(program)) {
+		}
+		return originalSize - program.size();
+	}
+
+	// Return a mask of registers formatted for printing, e.g. "$sp $g0", or "none" if there aren't any.
+	static std::string describeRegisters(std::uint32_t mask) {
+		std::string description;
+		for (unsigned int r = 0; r < REGISTER_COUNT; r++) {
+			if ((mask & (1u << r)) != 0u) {
+				description += (description.empty() ? "" : " ") + InstructionFormat::getRegisterName(r);
+			}
+		}
+		return description.empty() ? "none" : description;
+	}
+
+	// Return a description of every basic block in program and the registers live (i.e. still to be read) going
+	// into and out of it, one block per line.
+	std::string describeLiveness(ProgramEditor &program) {
+		if (!program.canFollowEveryJump()) {
+			return "Register liveness unknown, since not every jump in the program can be followed.\n";
+		}
+		ControlFlowGraph graph(program);
+		std::vector<std::uint32_t> liveIn;
+		std::vector<std::uint32_t> liveOut;
+		findLiveRegisters(program, graph, liveIn, liveOut);
+
+		std::ostringstream description;
+		const std::vector<ControlFlowGraph::Block> &blocks = graph.getBlocks();
+		for (unsigned int b = 0; b < blocks.size(); b++) {
+			description << "Block " << b << " (addresses " << blocks[b].start << " to " << blocks[b].end - 1
+				<< "): live in " << describeRegisters(liveIn[b]) << ", live out " << describeRegisters(liveOut[b])
+				<< std::endl;
+		}
+		return description.str();
+	}
+}
@@ -0,0 +1,29 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "ProgramEditor.h"
+#include "ControlFlowGraph.h"
+
+#ifndef DATAFLOW_OPTIMIZER_H
+#define DATAFLOW_OPTIMIZER_H
+
+// Contains a pass that speeds programs up by following values through the whole program rather than just a few
+// instructions at a time. Registers that always hold the same value at some point (e.g. after ori $g0 $zero 5) let
+// conditional jumps be decided before the program runs, and instructions writing registers that are never read again
+// can be left out altogether.
+namespace DataflowOptimizer {
+	// Rewrite program into an equivalent one that runs fewer instructions, and return how many instructions were
+	// removed. Nothing is changed in programs that jump to addresses they worked out themselves, since there's no
+	// telling where their values flow.
+	unsigned int optimize(ProgramEditor &program);
+	// Return a description of every basic block in program and the registers live (i.e. still to be read) going
+	// into and out of it, one block per line.
+	std::string describeLiveness(ProgramEditor &program);
+	// Work out which registers are live (i.e. might still be read before being written again) going into and
+	// coming out of every block of graph, overwriting liveIn and liveOut with a mask of registers for each block
+	// (bit n standing for the register with id n).
+	void findLiveRegisters(ProgramEditor &program, const ControlFlowGraph &graph, std::vector<std::uint32_t> &liveIn,
+		std::vector<std::uint32_t> &liveOut);
+};
+
+#endif
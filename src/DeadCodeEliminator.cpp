@@ -0,0 +1,52 @@
+#include "DeadCodeEliminator.h"
+#include "InstructionFormat.h"
+
+namespace DeadCodeEliminator {
+	// Remove every instruction that can't be reached from the start of program by following jumps, calls and
+	// fallthroughs, and return how many were removed. Returns are assumed to go back to just after a call, so
+	// nothing is removed from programs that jump to addresses they worked out some other way (i.e. jr through
+	// anything but $ca, or $ca being set by anything but call and lw).
+	unsigned int removeUnreachableCode(ProgramEditor &program) {
+		if (program.size() == 0 || !program.canFollowEveryJump()) {
+			return 0;
+		}
+
+		// Work out which instructions can be reached, starting from the first one.
+		std::vector<bool> reachable(program.size(), false);
+		std::vector<unsigned int> toVisit(1, 0u);
+		reachable[0] = true;
+		while (toVisit.size() > 0) {
+			unsigned int index = toVisit.back();
+			toVisit.pop_back();
+
+			// Everything that can run straight after this instruction, including the instruction after a call,
+			// which is where the subroutine returns to.
+			const Instruction &instruction = program.getInstruction(index);
+			unsigned int successors[2];
+			unsigned int successorCount = 0;
+			if (InstructionFormat::fallsThrough(instruction)) {
+				successors[successorCount++] = index + 1;
+			}
+			if (program.hasTarget(index)) {
+				successors[successorCount++] = program.getTarget(index);
+			}
+
+			for (unsigned int i = 0; i < successorCount; i++) {
+				if (successors[i] < program.size() && !reachable[successors[i]]) {
+					reachable[successors[i]] = true;
+					toVisit.push_back(successors[i]);
+				}
+			}
+		}
+
+		// Now remove everything that wasn't reached, going backwards so the indices still to go don't change.
+		unsigned int removedCount = 0;
+		for (unsigned int i = program.size(); i-- > 0;) {
+			if (!reachable[i]) {
+				program.remove(i);
+				removedCount++;
+			}
+		}
+		return removedCount;
+	}
+}
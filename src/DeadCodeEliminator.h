@@ -0,0 +1,17 @@
+#include "ProgramEditor.h"
+
+#ifndef DEAD_CODE_ELIMINATOR_H
+#define DEAD_CODE_ELIMINATOR_H
+
+// Contains a pass that shrinks programs by removing code that can never run, e.g. subroutines from a shared library
+// that this particular program never calls. This frees up instruction memory, which only has room for 512
+// instructions.
+namespace DeadCodeEliminator {
+	// Remove every instruction that can't be reached from the start of program by following jumps, calls and
+	// fallthroughs, and return how many were removed. Returns are assumed to go back to just after a call, so
+	// nothing is removed from programs that jump to addresses they worked out some other way (i.e. jr through
+	// anything but $ca, or $ca being set by anything but call and lw).
+	unsigned int removeUnreachableCode(ProgramEditor &program);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include <fstream>
+#include <stdexcept>
+#include "ExecutionProfile.h"
+#include "Hash.h"
+
+namespace ExecutionProfile {
+	// First word of every profile file, so that other files aren't mistaken for profiles.
+	static const std::string PROFILE_FILE_MAGIC = "shroomprofile";
+
+	// Return a hash of machineCode identifying the program, formatted as a string.
+	std::string hashProgram(const std::vector<Instruction> &machineCode) {
+		// Hash the instructions exactly as they're laid out in a shroom16 binary file.
+		std::uint64_t hash = Hash::EMPTY_HASH;
+		for (const Instruction &instruction : machineCode) {
+			unsigned char bytes[4];
+			for (unsigned int i = 0; i < 4u; i++) {
+				bytes[i] = (unsigned char)instruction.getBitsInRange(i * 8u, i * 8u + 7u);
+			}
+			hash = Hash::fnv1aBytes(bytes, sizeof(bytes), hash);
+		}
+		return Hash::toHexString(hash);
+	}
+
+	// Write profile to the file fileName, as text. Throws an exception if the file could not be written.
+	void saveProfile(const Profile &profile, const std::string &fileName) {
+		std::ofstream outFile(fileName);
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue opening output file " + fileName + "!");
+		}
+
+		// Header, then one line per instruction that ran at all: its address, how many times it ran, and how
+		// many times it jumped.
+		outFile << PROFILE_FILE_MAGIC << " " << PROFILE_FILE_VERSION << "\n";
+		outFile << profile.programHash << " " << profile.executionCounts.size() << "\n";
+		for (unsigned int i = 0; i < profile.executionCounts.size(); i++) {
+			if (profile.executionCounts[i] > 0u) {
+				outFile << i << " " << profile.executionCounts[i] << " " << profile.takenCounts[i] << "\n";
+			}
+		}
+
+		outFile.close();
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue writing output file " + fileName + "!");
+		}
+	}
+
+	// Read the profile file fileName. Throws an exception if the file can't be read or isn't a valid profile.
+	Profile loadProfile(const std::string &fileName) {
+		std::ifstream inFile(fileName);
+		if (!inFile.good()) {
+			throw std::runtime_error("invalid file " + fileName + "!");
+		}
+
+		// Make sure this is actually a profile we understand.
+		std::string magic;
+		unsigned int version = 0u;
+		if (!(inFile >> magic >> version) || magic != PROFILE_FILE_MAGIC) {
+			throw std::runtime_error(fileName + " is not a shroom16 profile!");
+		}
+		if (version != PROFILE_FILE_VERSION) {
+			throw std::runtime_error("Profile " + fileName + " was made by a different version of shroomvm!");
+		}
+
+		Profile profile;
+		std::size_t instructionCount = 0u;
+		if (!(inFile >> profile.programHash >> instructionCount)) {
+			throw std::runtime_error("Profile " + fileName + " is corrupt!");
+		}
+		profile.executionCounts.assign(instructionCount, 0u);
+		profile.takenCounts.assign(instructionCount, 0u);
+		unsigned int address = 0u;
+		std::uint64_t executionCount = 0u;
+		std::uint64_t takenCount = 0u;
+		while (inFile >> address >> executionCount >> takenCount) {
+			if (address >= instructionCount || takenCount > executionCount) {
+				throw std::runtime_error("Profile " + fileName + " is corrupt!");
+			}
+			profile.executionCounts[address] = executionCount;
+			profile.takenCounts[address] = takenCount;
+		}
+		if (!inFile.eof()) {
+			throw std::runtime_error("Profile " + fileName + " is corrupt!");
+		}
+		return profile;
+	}
+}
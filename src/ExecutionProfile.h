@@ -0,0 +1,35 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Instruction.h"
+
+#ifndef EXECUTION_PROFILE_H
+#define EXECUTION_PROFILE_H
+
+// Version of the profile file format. This must be bumped any time the layout of profile files changes.
+#define PROFILE_FILE_VERSION 1u
+
+// Contains execution profiles, which record how often every instruction of a program ran in the VM (shroomvm -p) so
+// that the assembler can lay the program out to suit the way it actually runs (shroomasm --profile).
+namespace ExecutionProfile {
+	// How often every instruction of a program ran.
+	struct Profile {
+		// Hash of the machine code that was run (see hashProgram()), so that profiles of some other version of the
+		// program can be told apart.
+		std::string programHash;
+		// For every instruction memory address, how many times the instruction there ran, and how many of those
+		// times it jumped somewhere other than the next instruction.
+		std::vector<std::uint64_t> executionCounts;
+		std::vector<std::uint64_t> takenCounts;
+	};
+
+	// Return a hash of machineCode identifying the program, formatted as a string.
+	std::string hashProgram(const std::vector<Instruction> &machineCode);
+
+	// Write profile to the file fileName, as text. Throws an exception if the file could not be written.
+	void saveProfile(const Profile &profile, const std::string &fileName);
+	// Read the profile file fileName. Throws an exception if the file can't be read or isn't a valid profile.
+	Profile loadProfile(const std::string &fileName);
+};
+
+#endif
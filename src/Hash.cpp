@@ -0,0 +1,31 @@
+#include "Hash.h"
+
+namespace Hash {
+	// Return the 64 bit FNV-1a hash of size bytes of data, continuing on from the hash previous so that several
+	// blocks of data can be hashed as though they were one.
+	std::uint64_t fnv1aBytes(const void *data, std::size_t size, std::uint64_t previous) {
+		const unsigned char *bytes = (const unsigned char *)data;
+		std::uint64_t hash = previous;
+		for (std::size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	// Return the 64 bit FNV-1a hash of the string s, continuing on from the hash previous.
+	std::uint64_t fnv1a(const std::string &s, std::uint64_t previous) {
+		return fnv1aBytes(s.data(), s.size(), previous);
+	}
+
+	// Return a hash formatted as a string of 16 lowercase hexadecimal digits.
+	std::string toHexString(std::uint64_t hash) {
+		const char *digits = "0123456789abcdef";
+		std::string formatted(16u, '0');
+		for (unsigned int i = 0; i < 16u; i++) {
+			formatted[15u - i] = digits[hash & 0xfu];
+			hash >>= 4u;
+		}
+		return formatted;
+	}
+}
@@ -0,0 +1,22 @@
+#include <string>
+#include <cstdint>
+
+#ifndef HASH_H
+#define HASH_H
+
+// Contains utility functions for hashing blocks of data, e.g. for recognizing source code we've seen before.
+namespace Hash {
+	// Starting value for a hash that hasn't had any data added to it yet.
+	const std::uint64_t EMPTY_HASH = 0xcbf29ce484222325ull;
+
+	// Return the 64 bit FNV-1a hash of size bytes of data, continuing on from the hash previous so that several
+	// blocks of data can be hashed as though they were one.
+	std::uint64_t fnv1aBytes(const void *data, std::size_t size, std::uint64_t previous = EMPTY_HASH);
+	// Return the 64 bit FNV-1a hash of the string s, continuing on from the hash previous.
+	std::uint64_t fnv1a(const std::string &s, std::uint64_t previous = EMPTY_HASH);
+
+	// Return a hash formatted as a string of 16 lowercase hexadecimal digits.
+	std::string toHexString(std::uint64_t hash);
+};
+
+#endif
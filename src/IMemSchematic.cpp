@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include "IMemSchematic.h"
+#include "Nbt.h"
+
+namespace IMemSchematic {
+	// Block palette IDs for every block in the schematic, besides REDSTONE_TORCH_OFF and AIR. Redstone wire running
+	// north to south with power p has ID NS_WIRE_ID + p, and wire running east to west has ID EW_WIRE_ID + p (other
+	// than unpowered wire, which has its own).
+	static const BYTE MAGENTA_CONCRETE = 0u;
+	static const BYTE NS_WIRE_ID = 1u;
+	static const BYTE REPEATER_SOUTH_ON = 17u;
+	static const BYTE ORANGE_CONCRETE = 19u;
+	static const BYTE REDSTONE_TORCH_ON = 20u;
+	static const BYTE EW_WIRE_ID = 20u;
+	static const BYTE REPEATER_EAST_ON = 36u;
+	static const BYTE EW_WIRE_OFF = 37u;
+	static const BYTE REPEATER_EAST_OFF = 38u;
+	static const unsigned int PALETTE_SIZE = 39u;
+	// Palette IDs in the order the palette is written in, which is the order WorldEdit saved them in.
+	static const BYTE PALETTE_ORDER[PALETTE_SIZE] = {
+		37u, 9u, 32u, 14u, 28u, 20u, 5u, 25u, 11u, 21u, 15u, 27u, 6u, 19u, 1u, 33u, 2u, 34u, 26u, 16u, 0u, 17u, 12u,
+		36u, 7u, 22u, 35u, 3u, 38u, 10u, 30u, 8u, 23u, 18u, 13u, 29u, 31u, 24u, 4u
+	};
+
+	// Most power a redstone signal can have, and how far apart the repeaters that bring a signal back up to it are
+	// along the bit and word lines.
+	static const unsigned int MAX_POWER = 15u;
+	static const unsigned int REPEATER_SPACING = 16u;
+	// Largest size a schematic can have along any axis, since sizes are stored as shorts.
+	static const unsigned int MAX_DIMENSION = 32767u;
+
+	// The word line of the first instruction of every layer is off (lighting its torches), which powers the far end
+	// of every bit line. The standard schematic was also saved with the read bus partway through a read, so the word
+	// lines of these instructions are off in it too, and two of its bit lines have a gap in the last row.
+	static const unsigned int STANDARD_OFF_WORD_LINES[] = {
+		204u, 205u, 208u, 212u, 224u, 225u, 236u, 237u, 240u, 244u
+	};
+	static const unsigned int STANDARD_BIT_LINE_GAPS[] = {6u, 22u};
+
+	// Sponge schematic format version, Minecraft data version, and where in the world the schematic was saved from.
+	static const std::int32_t SCHEMATIC_VERSION = 2;
+	static const std::int32_t DATA_VERSION = 2865;
+	static const std::vector<std::int32_t> WORLD_OFFSET = {-929, 82, 641};
+
+	// Return how many instructions fit in the instruction memory.
+	unsigned int Geometry::getInstructionCount() const {
+		return this->layerCount * this->instructionsPerLayer;
+	}
+
+	// Return the size of the schematic along x (across the bits of an instruction), z (along the instructions of a
+	// layer) and y (up through the layers).
+	unsigned int Geometry::getWidth() const {
+		return (this->wordSize - 1u) * this->bitSpacing + 1u;
+	}
+
+	unsigned int Geometry::getLength() const {
+		return this->instructionsPerLayer * this->instructionSpacing;
+	}
+
+	unsigned int Geometry::getHeight() const {
+		return this->layerCount * LAYER_HEIGHT;
+	}
+
+	// Return the x, y and z of the torch for bit b of instruction i. Torches hang off the second block from the
+	// bottom of their layer, with the first instruction of every layer at the far (north) end.
+	unsigned int Geometry::getTorchX(unsigned int b) const {
+		return b * this->bitSpacing;
+	}
+
+	unsigned int Geometry::getTorchY(unsigned int i) const {
+		return (i / this->instructionsPerLayer) * LAYER_HEIGHT + 2u;
+	}
+
+	unsigned int Geometry::getTorchZ(unsigned int i) const {
+		return (this->instructionsPerLayer - 1u - i % this->instructionsPerLayer) * this->instructionSpacing;
+	}
+
+	// Return the index in the block data of the block at (x, y, z).
+	std::size_t Geometry::getBlockIndex(unsigned int x, unsigned int y, unsigned int z) const {
+		return x + ((std::size_t)y * this->getLength() + z) * this->getWidth();
+	}
+
+	// Return the index in the block data of the torch for bit b of instruction i.
+	std::size_t Geometry::getTorchIndex(unsigned int i, unsigned int b) const {
+		return this->getBlockIndex(this->getTorchX(b), this->getTorchY(i), this->getTorchZ(i));
+	}
+
+	// Return a short description of the geometry in the form parseGeometry() reads.
+	std::string Geometry::describe() const {
+		std::string description = std::to_string(this->layerCount) + "x" + std::to_string(this->instructionsPerLayer) +
+			"x" + std::to_string(this->wordSize);
+		if (this->bitSpacing != BIT_SPACING || this->instructionSpacing != INSTRUCTION_SPACING) {
+			description += "x" + std::to_string(this->bitSpacing) + "x" + std::to_string(this->instructionSpacing);
+		}
+		return description;
+	}
+
+	bool Geometry::operator==(const Geometry &other) const {
+		return this->layerCount == other.layerCount && this->instructionsPerLayer == other.instructionsPerLayer &&
+			this->wordSize == other.wordSize && this->bitSpacing == other.bitSpacing &&
+			this->instructionSpacing == other.instructionSpacing;
+	}
+
+	// Return the name of the block with palette ID id (e.g. minecraft:air for AIR).
+	std::string getBlockName(BYTE id) {
+		switch (id) {
+			case MAGENTA_CONCRETE:
+				return "minecraft:magenta_concrete";
+			case AIR:
+				return "minecraft:air";
+			case REPEATER_SOUTH_ON:
+				return "minecraft:repeater[delay=1,facing=south,locked=false,powered=true]";
+			case REDSTONE_TORCH_OFF:
+				return "minecraft:redstone_wall_torch[facing=north,lit=false]";
+			case ORANGE_CONCRETE:
+				return "minecraft:orange_concrete";
+			case REDSTONE_TORCH_ON:
+				return "minecraft:redstone_wall_torch[facing=north,lit=true]";
+			case REPEATER_EAST_ON:
+				return "minecraft:repeater[delay=1,facing=east,locked=false,powered=true]";
+			case EW_WIRE_OFF:
+				return "minecraft:redstone_wire[east=side,north=none,power=0,south=none,west=side]";
+			case REPEATER_EAST_OFF:
+				return "minecraft:repeater[delay=1,facing=east,locked=false,powered=false]";
+		}
+		if (id > NS_WIRE_ID && id <= NS_WIRE_ID + MAX_POWER) {
+			return "minecraft:redstone_wire[east=none,north=side,power=" + std::to_string(id - NS_WIRE_ID) +
+				",south=side,west=none]";
+		}
+		return "minecraft:redstone_wire[east=side,north=none,power=" + std::to_string(id - EW_WIRE_ID) +
+			",south=none,west=side]";
+	}
+
+	// Build the NBT that comes before the block data of the schematic for geometry.
+	static std::vector<BYTE> generateHeader(const Geometry &geometry) {
+		std::vector<BYTE> header;
+		Nbt::writeTagStart(header, NBT_COMPOUND, "Schematic");
+		Nbt::writeIntTag(header, "PaletteMax", PALETTE_SIZE);
+		Nbt::writeTagStart(header, NBT_COMPOUND, "Palette");
+		for (BYTE id : PALETTE_ORDER) {
+			Nbt::writeIntTag(header, getBlockName(id), id);
+		}
+		Nbt::writeEnd(header);
+		Nbt::writeIntTag(header, "Version", SCHEMATIC_VERSION);
+		Nbt::writeShortTag(header, "Length", (std::int16_t)geometry.getLength());
+		// WorldEdit pastes the schematic so that its far corner is where the player stands.
+		Nbt::writeTagStart(header, NBT_COMPOUND, "Metadata");
+		Nbt::writeIntTag(header, "WEOffsetX", -(std::int32_t)(geometry.getWidth() - 1u));
+		Nbt::writeIntTag(header, "WEOffsetY", -(std::int32_t)(geometry.getHeight() - 1u));
+		Nbt::writeIntTag(header, "WEOffsetZ", -(std::int32_t)(geometry.getLength() - 1u));
+		Nbt::writeEnd(header);
+		Nbt::writeShortTag(header, "Height", (std::int16_t)geometry.getHeight());
+		Nbt::writeIntTag(header, "DataVersion", DATA_VERSION);
+		Nbt::writeByteArrayStart(header, "BlockData",
+			(std::int32_t)(geometry.getWidth() * geometry.getLength() * geometry.getHeight()));
+		return header;
+	}
+
+	// Return true iff instruction i's word line is off in the schematic for geometry, where isStandard is set iff it's
+	// the standard geometry.
+	static bool isWordLineOff(const Geometry &geometry, bool isStandard, unsigned int i) {
+		return i % geometry.instructionsPerLayer == 0 || (isStandard && std::find(std::begin(STANDARD_OFF_WORD_LINES),
+			std::end(STANDARD_OFF_WORD_LINES), i) != std::end(STANDARD_OFF_WORD_LINES));
+	}
+
+	// Return the block of a bit line at row z of a layer whose far torches are at row farZ, given which rows of the
+	// layer have lit torches. Repeaters split the bit line into runs, counting back from the far torches, and each run
+	// of wire is powered by the repeater at the far end of it (besides the last, which the far torches power instead)
+	// and by any lit torch along it, losing one power for every block away from them.
+	static BYTE getBitLineBlock(const std::vector<bool> &isRowLit, unsigned int farZ, unsigned int z) {
+		// Runs are numbered from the far end, with the rows past the far torches in the first run.
+		const unsigned int distance = z > farZ ? 0u : farZ - z;
+		if (distance % REPEATER_SPACING == REPEATER_SPACING - 1u) {
+			return REPEATER_SOUTH_ON;
+		}
+		const unsigned int run = distance / REPEATER_SPACING;
+		unsigned int power = 0u;
+		unsigned int runEnd = (unsigned int)isRowLit.size();
+		if (run > 0u) {
+			const unsigned int repeaterZ = farZ - (run * REPEATER_SPACING - 1u);
+			power = MAX_POWER - (repeaterZ - 1u - z);
+			runEnd = repeaterZ;
+		}
+		const unsigned int runStart = farZ < (run + 1u) * REPEATER_SPACING - 1u ? 0u :
+			farZ - ((run + 1u) * REPEATER_SPACING - 1u) + 1u;
+		for (unsigned int row = runStart; row < runEnd; row++) {
+			const unsigned int rowDistance = row > z ? row - z : z - row;
+			if (isRowLit[row] && rowDistance < MAX_POWER) {
+				power = std::max(power, MAX_POWER - rowDistance);
+			}
+		}
+		return (BYTE)(NS_WIRE_ID + power);
+	}
+
+	// Return the block of a word line at x, with power running from west to east between repeaters.
+	static BYTE getWordLineBlock(unsigned int x, bool isOff) {
+		if (x % REPEATER_SPACING == REPEATER_SPACING - 1u) {
+			return isOff ? REPEATER_EAST_OFF : REPEATER_EAST_ON;
+		}
+		return isOff ? EW_WIRE_OFF : (BYTE)(EW_WIRE_ID + x % REPEATER_SPACING + 1u);
+	}
+
+	// Build the block data of the schematic for geometry. Every layer of instructions is four blocks high: a floor of
+	// concrete, the bit lines running north to south under every column of torches, a torch for every bit of every
+	// instruction hanging off a row of concrete, and the word lines running east to west along the tops of those rows.
+	static std::vector<BYTE> generateBody(const Geometry &geometry) {
+		const bool isStandard = geometry == Geometry();
+		std::vector<BYTE> body((std::size_t)geometry.getWidth() * geometry.getLength() * geometry.getHeight(),
+			(BYTE)AIR);
+		for (unsigned int layer = 0; layer < geometry.layerCount; layer++) {
+			const unsigned int firstInstruction = layer * geometry.instructionsPerLayer;
+			const unsigned int lastInstruction = firstInstruction + geometry.instructionsPerLayer;
+			const unsigned int torchY = geometry.getTorchY(firstInstruction);
+			const unsigned int farZ = geometry.getTorchZ(firstInstruction);
+			std::vector<bool> isRowLit(geometry.getLength(), false);
+			for (unsigned int i = firstInstruction; i < lastInstruction; i++) {
+				isRowLit[geometry.getTorchZ(i)] = isWordLineOff(geometry, isStandard, i);
+			}
+
+			for (unsigned int z = 0; z < geometry.getLength(); z++) {
+				const BYTE bitLineBlock = getBitLineBlock(isRowLit, farZ, z);
+				for (unsigned int b = 0; b < geometry.wordSize; b++) {
+					const unsigned int x = geometry.getTorchX(b);
+					body[geometry.getBlockIndex(x, torchY - 2u, z)] = MAGENTA_CONCRETE;
+					if (!isStandard || z != geometry.getLength() - 1u || std::find(std::begin(STANDARD_BIT_LINE_GAPS),
+						std::end(STANDARD_BIT_LINE_GAPS), b) == std::end(STANDARD_BIT_LINE_GAPS)) {
+						body[geometry.getBlockIndex(x, torchY - 1u, z)] = bitLineBlock;
+					}
+				}
+			}
+
+			for (unsigned int i = firstInstruction; i < lastInstruction; i++) {
+				const unsigned int wordLineZ = geometry.getTorchZ(i) + 1u;
+				const bool isOff = isWordLineOff(geometry, isStandard, i);
+				for (unsigned int x = 0; x < geometry.getWidth(); x++) {
+					body[geometry.getBlockIndex(x, torchY, wordLineZ)] = ORANGE_CONCRETE;
+					body[geometry.getBlockIndex(x, torchY + 1u, wordLineZ)] = getWordLineBlock(x, isOff);
+				}
+				for (unsigned int b = 0; b < geometry.wordSize; b++) {
+					body[geometry.getTorchIndex(i, b)] = isOff ? REDSTONE_TORCH_ON : REDSTONE_TORCH_OFF;
+				}
+			}
+		}
+		return body;
+	}
+
+	// Build the NBT that comes after the block data of the schematic for geometry.
+	static std::vector<BYTE> generateFooter(const Geometry &geometry) {
+		std::vector<BYTE> footer;
+		Nbt::writeEmptyListTag(footer, "BlockEntities", NBT_COMPOUND);
+		Nbt::writeShortTag(footer, "Width", (std::int16_t)geometry.getWidth());
+		Nbt::writeIntArrayTag(footer, "Offset", WORLD_OFFSET);
+		Nbt::writeEnd(footer);
+		return footer;
+	}
+
+	// Read a positive whole number from text, from position on up to the next x or the end, moving position past it.
+	// Returns 0 if there isn't one there.
+	static unsigned int readDimension(const std::string &text, std::size_t &position) {
+		unsigned long value = 0u;
+		const std::size_t start = position;
+		while (position < text.size() && text[position] >= '0' && text[position] <= '9') {
+			value = value * 10u + (unsigned long)(text[position] - '0');
+			if (value > MAX_DIMENSION) {
+				return 0u;
+			}
+			position++;
+		}
+		return position == start ? 0u : (unsigned int)value;
+	}
+
+	// Return the geometry described by text, which is <layers>x<instructions per layer>x<bits>, optionally followed
+	// by x<bit spacing>x<instruction spacing> (e.g. 4x32x32 or 8x64x32x2x2). Throws an exception if text isn't in that
+	// form or the geometry can't be built.
+	Geometry parseGeometry(const std::string &text) {
+		std::vector<unsigned int> dimensions;
+		std::size_t position = 0;
+		do {
+			if (!dimensions.empty()) {
+				position++;
+			}
+			dimensions.push_back(readDimension(text, position));
+		} while (position < text.size() && text[position] == 'x' && dimensions.back() != 0u);
+		if (position != text.size() || dimensions.back() == 0u ||
+			(dimensions.size() != 3u && dimensions.size() != 5u)) {
+			throw std::runtime_error("Invalid instruction memory geometry " + text + ", expected <layers>x"
+				"<instructions per layer>x<bits> or <layers>x<instructions per layer>x<bits>x<bit spacing>x"
+				"<instruction spacing>!");
+		}
+
+		Geometry geometry;
+		geometry.layerCount = dimensions[0];
+		geometry.instructionsPerLayer = dimensions[1];
+		geometry.wordSize = dimensions[2];
+		if (dimensions.size() == 5u) {
+			geometry.bitSpacing = dimensions[3];
+			geometry.instructionSpacing = dimensions[4];
+		}
+		checkGeometry(geometry);
+		return geometry;
+	}
+
+	// Throw an exception if an instruction memory with geometry can't be built or stored in a schematic.
+	void checkGeometry(const Geometry &geometry) {
+		if (geometry.layerCount == 0u || geometry.instructionsPerLayer == 0u) {
+			throw std::runtime_error("Instruction memory must have at least one layer and one instruction per layer!");
+		}
+		if (geometry.wordSize == 0u || geometry.wordSize > INSTRUCTION_SIZE) {
+			throw std::runtime_error("Instruction memory words must be between 1 and " +
+				std::to_string(INSTRUCTION_SIZE) + " bits!");
+		}
+		// Torches need a block of space between them, and the far torches have to be able to power the rows past
+		// them.
+		if (geometry.bitSpacing < 2u || geometry.instructionSpacing < 2u || geometry.instructionSpacing > MAX_POWER) {
+			throw std::runtime_error("Instruction memory bit spacing must be at least 2, and instruction spacing "
+				"between 2 and " + std::to_string(MAX_POWER) + "!");
+		}
+		if ((std::uint64_t)(geometry.wordSize - 1u) * geometry.bitSpacing + 1u > MAX_DIMENSION ||
+			(std::uint64_t)geometry.instructionsPerLayer * geometry.instructionSpacing > MAX_DIMENSION ||
+			(std::uint64_t)geometry.layerCount * LAYER_HEIGHT > MAX_DIMENSION ||
+			(std::uint64_t)geometry.getWidth() * geometry.getLength() * geometry.getHeight() > 0x7fffffffu) {
+			throw std::runtime_error("Instruction memory " + geometry.describe() + " is too large for a schematic!");
+		}
+	}
+
+	// Throw an exception if machine code doesn't fit in instruction memory with geometry (which must be valid), either
+	// because there's too much of it or because it uses bits the words of the memory don't have.
+	void checkFits(const std::vector<Instruction> &machineCode, const Geometry &geometry) {
+		if (machineCode.size() > geometry.getInstructionCount()) {
+			throw std::runtime_error("Program has " + std::to_string(machineCode.size()) + " instructions, but "
+				"instruction memory " + geometry.describe() + " only holds " +
+				std::to_string(geometry.getInstructionCount()) + "!");
+		}
+		for (unsigned int i = 0; i < machineCode.size() && geometry.wordSize < INSTRUCTION_SIZE; i++) {
+			if (machineCode[i].getBitsInRange(geometry.wordSize, INSTRUCTION_SIZE - 1u) != 0u) {
+				throw std::runtime_error("Instruction " + std::to_string(i) + " doesn't fit in the " +
+					std::to_string(geometry.wordSize) + " bit words of instruction memory " + geometry.describe() +
+					"!");
+			}
+		}
+	}
+
+	// Return the parts of the schematic for an instruction memory with geometry (which must be valid). The standard
+	// geometry's parts are only generated the first time they're asked for, and are shared between threads after
+	// that.
+	std::shared_ptr<const Parts> getParts(const Geometry &geometry) {
+		static const std::shared_ptr<const Parts> standardParts = std::make_shared<const Parts>(
+			Parts{generateHeader(Geometry()), generateBody(Geometry()), generateFooter(Geometry())});
+		if (geometry == Geometry()) {
+			return standardParts;
+		}
+		return std::make_shared<const Parts>(Parts{generateHeader(geometry), generateBody(geometry),
+			generateFooter(geometry)});
+	}
+}
@@ -0,0 +1,72 @@
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Instruction.h"
+#include "IMemSchemConstants.h"
+
+#ifndef I_MEM_SCHEMATIC_H
+#define I_MEM_SCHEMATIC_H
+
+// Contains the generator for instruction memory schematics (see IMemSchemConstants.h), which builds their header,
+// body and footer from the geometry of the instruction memory rather than storing them, so that larger and smaller
+// builds get a schematic of their own.
+namespace IMemSchematic {
+	// Shape of an instruction memory. The defaults are the standard 512 instruction build.
+	struct Geometry {
+		// How many layers of instructions there are, stacked one above the other.
+		unsigned int layerCount = NUMBER_OF_LAYERS;
+		// How many instructions each layer holds, running from the far (north) end to the near end.
+		unsigned int instructionsPerLayer = INSTRUCTIONS_PER_LAYER;
+		// How many bits each instruction has, running from west to east, little end first.
+		unsigned int wordSize = INSTRUCTION_SIZE;
+		// How many blocks apart the torches for neighbouring bits, and for neighbouring instructions, are.
+		unsigned int bitSpacing = BIT_SPACING;
+		unsigned int instructionSpacing = INSTRUCTION_SPACING;
+
+		// Return how many instructions fit in the instruction memory.
+		unsigned int getInstructionCount() const;
+		// Return the size of the schematic along x (across the bits of an instruction), z (along the instructions of
+		// a layer) and y (up through the layers).
+		unsigned int getWidth() const;
+		unsigned int getLength() const;
+		unsigned int getHeight() const;
+		// Return the x, y and z of the torch for bit b of instruction i.
+		unsigned int getTorchX(unsigned int b) const;
+		unsigned int getTorchY(unsigned int i) const;
+		unsigned int getTorchZ(unsigned int i) const;
+		// Return the index in the block data of the block at (x, y, z).
+		std::size_t getBlockIndex(unsigned int x, unsigned int y, unsigned int z) const;
+		// Return the index in the block data of the torch for bit b of instruction i.
+		std::size_t getTorchIndex(unsigned int i, unsigned int b) const;
+		// Return a short description of the geometry in the form parseGeometry() reads.
+		std::string describe() const;
+		bool operator==(const Geometry &other) const;
+	};
+
+	// The NBT that comes before the block data of a schematic (ending with the start of the block data tag), the
+	// block data itself with every instruction filled with ones, and the NBT that comes after it.
+	struct Parts {
+		std::vector<BYTE> header;
+		std::vector<BYTE> body;
+		std::vector<BYTE> footer;
+	};
+
+	// Return the name of the block with palette ID id (e.g. minecraft:air for AIR).
+	std::string getBlockName(BYTE id);
+	// Return the geometry described by text, which is <layers>x<instructions per layer>x<bits>, optionally followed
+	// by x<bit spacing>x<instruction spacing> (e.g. 4x32x32 or 8x64x32x2x2). Throws an exception if text isn't in that
+	// form or the geometry can't be built.
+	Geometry parseGeometry(const std::string &text);
+	// Throw an exception if an instruction memory with geometry can't be built or stored in a schematic.
+	void checkGeometry(const Geometry &geometry);
+	// Throw an exception if machine code doesn't fit in instruction memory with geometry (which must be valid), either
+	// because there's too much of it or because it uses bits the words of the memory don't have.
+	void checkFits(const std::vector<Instruction> &machineCode, const Geometry &geometry);
+	// Return the parts of the schematic for an instruction memory with geometry (which must be valid). The standard
+	// geometry's parts are only generated the first time they're asked for, and are shared between threads after
+	// that.
+	std::shared_ptr<const Parts> getParts(const Geometry &geometry);
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <sstream>
+#include "IncrementalAssembler.h"
+#include "Parser.h"
+
+// Constructs an assembler that assembles every version of the program with the given options. The options' module
+// cache is ignored, since the assembler keeps its own to reuse included files between updates.
+IncrementalAssembler::IncrementalAssembler(const Assembler::Options &options) : options(options) {
+	this->options.moduleCache = &this->moduleCache;
+}
+
+// Assemble the latest version of the program held in source, reusing whatever we can from earlier versions, and 
+// return the result.
+const Assembler::Result &IncrementalAssembler::update(const std::string &source) {
+	this->result = Assembler::Result();
+	this->retokenizedLineCount = 0;
+	this->reencodedInstructionCount = 0;
+
+	// Break source down into lines, only parsing lines we haven't seen before. Only lines in this version are kept
+	// in the new cache, so it never grows past the size of the program.
+	std::vector<Assembler::SourceLine> lines;
+	std::unordered_map<std::string, std::vector<std::string> > newParsedLineCache;
+	std::istringstream sourceStream(source);
+	std::string line;
+	unsigned int lineNumber = 0;
+	while (std::getline(sourceStream, line)) {
+		lineNumber++;
+		std::unordered_map<std::string, std::vector<std::string> >::iterator cached = 
+			this->parsedLineCache.find(line);
+		std::vector<std::string> parsedLine;
+		if (cached != this->parsedLineCache.end()) {
+			parsedLine = cached->second;
+		}
+		else {
+			std::string stripped = line;
+			Parser::stripComment(stripped);
+			Parser::parseLine(stripped, parsedLine);
+			this->retokenizedLineCount++;
+		}
+		newParsedLineCache[line] = parsedLine;
+
+		Parser::stripComment(line);
+		lines.push_back({lineNumber, line, parsedLine, ""});
+	}
+	this->parsedLineCache.swap(newParsedLineCache);
+
+	// Pull in any included files, which the module cache keeps parsed for us.
+	Assembler::expandIncludes(lines, this->options, this->result);
+
+	// First pass is always redone in full, since any edit can move every label that comes after it.
+	InstructionWriter writer;
+	Assembler::findConstantsAndLabels(lines, writer, this->result);
+	if (!this->result.succeeded()) {
+		return this->result;
+	}
+
+	// Data is cheap to fill in, and loop bounds and budgets cheap to check, so both are always redone from scratch.
+	Assembler::fillDataMemory(lines, writer, this->options, this->result);
+	Assembler::checkLimitLabels(lines, writer, this->result);
+
+	// Second pass, only encoding instructions that changed or whose labels or constants changed value.
+	std::unordered_map<std::string, EncodedInstruction> newEncodingCache;
+	for (const Assembler::SourceLine &sourceLine : lines) {
+		if (!Assembler::isInstruction(sourceLine)) {
+			continue;
+		}
+
+		// Instructions are identified by their components, so edits to comments or spacing don't matter.
+		std::string key;
+		for (const std::string &component : sourceLine.parsedLine) {
+			key += component + "\n";
+		}
+
+		// Try to reuse the old encoding.
+		std::unordered_map<std::string, EncodedInstruction>::iterator cached = this->encodingCache.find(key);
+		if (cached == this->encodingCache.end() || !dependenciesUnchanged(cached->second, writer)) {
+			// No luck, so encode it from scratch, remembering which labels and constants it refers to.
+			EncodedInstruction encoded;
+			try {
+				writer.writeInstruction(encoded.instruction, sourceLine.parsedLine);
+			}
+			catch (std::exception &e) {
+				this->result.diagnostics.push_back({"Error", sourceLine.lineNumber, e.what(), 
+					sourceLine.fileName});
+				continue;
+			}
+			encoded.labelReferences = writer.getLabelReferences();
+			encoded.addressReferences = writer.getAddressReferences();
+			for (const std::vector<std::string> *labels : {&encoded.labelReferences, &encoded.addressReferences}) {
+				for (const std::string &label : *labels) {
+					if (writer.getLabelMap().find(label) != writer.getLabelMap().end()) {
+						encoded.labelDependencies[label] = writer.getLabelMap().find(label)->second;
+					}
+				}
+			}
+			for (const std::string &constant : writer.getConstantReferences()) {
+				encoded.constantDependencies[constant] = writer.getConstantMap().find(constant)->second;
+			}
+			this->reencodedInstructionCount++;
+			this->encodingCache[key] = encoded;
+			cached = this->encodingCache.find(key);
+		}
+
+		if (Assembler::needsRelocations(this->options)) {
+			for (const std::string &label : cached->second.labelReferences) {
+				this->result.relocations.push_back({(unsigned int)this->result.machineCode.size(), label});
+			}
+		}
+		if (!cached->second.addressReferences.empty()) {
+			this->result.usesLabelAddresses = true;
+		}
+		this->result.machineCode.push_back(cached->second.instruction);
+		this->result.sourceLocations.push_back({sourceLine.lineNumber, sourceLine.text, sourceLine.fileName});
+		newEncodingCache[key] = cached->second;
+	}
+	this->encodingCache.swap(newEncodingCache);
+
+	Assembler::finishResult(writer, this->options, this->result);
+	return this->result;
+}
+
+// Return the number of lines that had to be parsed by the last update.
+unsigned int IncrementalAssembler::getRetokenizedLineCount() const {
+	return this->retokenizedLineCount;
+}
+
+// Return the number of instructions that had to be encoded by the last update.
+unsigned int IncrementalAssembler::getReencodedInstructionCount() const {
+	return this->reencodedInstructionCount;
+}
+
+// Return true iff every label and constant encoded depends on still has the same value in writer.
+bool IncrementalAssembler::dependenciesUnchanged(const EncodedInstruction &encoded, const InstructionWriter &writer) {
+	for (const std::pair<const std::string, unsigned int> &label : encoded.labelDependencies) {
+		std::map<std::string, unsigned int>::const_iterator current = writer.getLabelMap().find(label.first);
+		// Constants take priority over labels in immediates, so a new constant with the same name changes things too.
+		if (current == writer.getLabelMap().end() || current->second != label.second ||
+			writer.getConstantMap().find(label.first) != writer.getConstantMap().end()) {
+			return false;
+		}
+	}
+	for (const std::pair<const std::string, int> &constant : encoded.constantDependencies) {
+		std::map<std::string, int>::const_iterator current = writer.getConstantMap().find(constant.first);
+		if (current == writer.getConstantMap().end() || current->second != constant.second) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,66 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include "Assembler.h"
+#include "ModuleCache.h"
+
+#ifndef INCREMENTAL_ASSEMBLER_H
+#define INCREMENTAL_ASSEMBLER_H
+
+// Assembles successive versions of the same program (e.g. every time it's saved in watch mode), redoing as little
+// work as possible each time. Lines whose text hasn't changed aren't parsed again, and instructions are only encoded
+// again if their own text changed or if a label or constant they refer to changed value. Labels and constants
+// themselves are always found again from scratch, since that pass is cheap and any edit can move every label after
+// it. Included files are kept parsed between updates too. The result of every update is exactly what 
+// Assembler::assemble() would produce for the same source.
+class IncrementalAssembler {
+public:
+	// Constructs an assembler that assembles every version of the program with the given options. The options'
+	// module cache is ignored, since the assembler keeps its own to reuse included files between updates.
+	IncrementalAssembler(const Assembler::Options &options = Assembler::Options());
+
+	// Assemble the latest version of the program held in source, reusing whatever we can from earlier versions,
+	// and return the result.
+	const Assembler::Result &update(const std::string &source);
+
+	// Return the number of lines that had to be parsed by the last update.
+	unsigned int getRetokenizedLineCount() const;
+	// Return the number of instructions that had to be encoded by the last update.
+	unsigned int getReencodedInstructionCount() const;
+
+private:
+	// An instruction encoded by an earlier update, along with the values of every label and constant its encoding
+	// depended on at the time.
+	struct EncodedInstruction {
+		// The encoded instruction.
+		Instruction instruction;
+		// Labels the instruction jumps to, and labels whose addresses its immediate was worked out from.
+		std::vector<std::string> labelReferences;
+		std::vector<std::string> addressReferences;
+		// Labels the instruction refers to, mapped onto the addresses they had when it was encoded.
+		std::map<std::string, unsigned int> labelDependencies;
+		// Constants the instruction refers to, mapped onto the values they had when it was encoded.
+		std::map<std::string, int> constantDependencies;
+	};
+
+	// Return true iff every label and constant encoded depends on still has the same value in writer.
+	static bool dependenciesUnchanged(const EncodedInstruction &encoded, const InstructionWriter &writer);
+
+	// Settings passed on to the assembler, including where to find included files.
+	Assembler::Options options;
+	// Cache of every included file seen so far, already parsed.
+	ModuleCache moduleCache;
+	// Maps the raw text of every line seen in the last update onto its parsed components.
+	std::unordered_map<std::string, std::vector<std::string> > parsedLineCache;
+	// Maps the components of every instruction seen in the last update (joined by newlines) onto their encoding.
+	std::unordered_map<std::string, EncodedInstruction> encodingCache;
+	// Result of the last update.
+	Assembler::Result result;
+	// Number of lines that had to be parsed by the last update.
+	unsigned int retokenizedLineCount = 0;
+	// Number of instructions that had to be encoded by the last update.
+	unsigned int reencodedInstructionCount = 0;
+};
+
+#endif
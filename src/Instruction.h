@@ -6,6 +6,10 @@
 
 // Size of instruction memory of the target machine in 4-byte instructions.
 #define INSTRUCTION_MEMORY_SIZE 512u
+// Size of data memory of the target machine in 16-bit words.
+#define DATA_MEMORY_SIZE 256u
+// Size of a word of data memory in bits.
+#define WORD_SIZE 16u
 //Instruction size in bits.
 #define INSTRUCTION_SIZE 32u
 //Byte size in bits.
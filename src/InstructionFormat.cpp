@@ -0,0 +1,331 @@
+#include <stdexcept>
+#include <cstdint>
+#include <set>
+#include "InstructionFormat.h"
+// Defines mnemonicToOpcodeMap and registerToBinaryMap.
+#include "OpcodeRegisterMaps.h"
+
+namespace InstructionFormat {
+	// Opcodes of the instructions that need special treatment, looked up once from the assembler's own table.
+	static const unsigned int JMP = mnemonicToOpcodeMap.at("jmp");
+	static const unsigned int JEQ = mnemonicToOpcodeMap.at("jeq");
+	static const unsigned int JLT = mnemonicToOpcodeMap.at("jlt");
+	static const unsigned int JGT = mnemonicToOpcodeMap.at("jgt");
+	static const unsigned int CALL = mnemonicToOpcodeMap.at("call");
+	static const unsigned int JR = mnemonicToOpcodeMap.at("jr");
+	static const unsigned int END = mnemonicToOpcodeMap.at("?end");
+	static const unsigned int MUL = mnemonicToOpcodeMap.at("mul");
+
+	// Ids of the registers that instructions use behind the scenes.
+	static const unsigned int ZERO_REGISTER = registerToBinaryMap.at("$zero");
+	static const unsigned int CA_REGISTER = registerToBinaryMap.at("$ca");
+	static const unsigned int WR_REGISTER = registerToBinaryMap.at("$wr");
+
+	// Where in an instruction each register field starts, as laid out by InstructionWriter.
+	static const unsigned int DESTINATION_FIELD = 6u;
+	static const unsigned int READ_A_FIELD = 11u;
+	static const unsigned int READ_B_FIELD = 16u;
+
+	// Which register fields an instruction uses.
+	struct RegisterUsage {
+		bool writesDestination;
+		bool readsA;
+		bool readsB;
+	};
+
+	// Maps mnemonics onto the register fields they use, mirroring the write functions of InstructionWriter.
+	static const std::map<std::string, RegisterUsage> mnemonicToRegisterUsage = {
+		{"add", {true, true, true}},
+		{"sub", {true, true, true}},
+		{"mul", {true, true, true}},
+		{"div", {true, true, true}},
+		{"sll", {true, true, true}},
+		{"srl", {true, true, true}},
+		{"nor", {true, true, true}},
+		{"or", {true, true, true}},
+		{"and", {true, true, true}},
+		{"xor", {true, true, true}},
+		{"lw", {true, true, false}},
+		{"sw", {false, true, true}},
+		{"addi", {true, true, false}},
+		{"slli", {true, true, false}},
+		{"srli", {true, true, false}},
+		{"nori", {true, true, false}},
+		{"ori", {true, true, false}},
+		{"andi", {true, true, false}},
+		{"xori", {true, true, false}},
+		{"cmp", {true, true, true}},
+		{"jmp", {false, false, false}},
+		{"jeq", {false, true, false}},
+		{"jlt", {false, true, false}},
+		{"jgt", {false, true, false}},
+		{"call", {false, false, false}},
+		{"jr", {false, true, false}},
+		{"random", {true, false, false}},
+		{"?in", {true, false, false}},
+		{"?out", {false, true, false}},
+		{"?end", {false, false, false}},
+		{"?charset", {false, true, false}},
+		{"?keyin", {true, false, false}},
+		{"?pxset", {false, true, true}},
+		{"?clrscrn", {false, false, false}}
+	};
+
+	// Maps mnemonics onto the operands they're written with, in order, mirroring the write functions of
+	// InstructionWriter: d, a and b for the destination, first read and second read registers, i for a 16 bit
+	// immediate value, o for an 8 bit memory offset, c for an 8 bit character, p for a single bit and t for a jump
+	// target.
+	static const std::map<std::string, std::string> mnemonicToOperands = {
+		{"add", "dab"},
+		{"sub", "dab"},
+		{"mul", "dab"},
+		{"div", "dab"},
+		{"sll", "dab"},
+		{"srl", "dab"},
+		{"nor", "dab"},
+		{"or", "dab"},
+		{"and", "dab"},
+		{"xor", "dab"},
+		{"lw", "dao"},
+		{"sw", "bao"},
+		{"addi", "dai"},
+		{"slli", "dai"},
+		{"srli", "dai"},
+		{"nori", "dai"},
+		{"ori", "dai"},
+		{"andi", "dai"},
+		{"xori", "dai"},
+		{"cmp", "dab"},
+		{"jmp", "t"},
+		{"jeq", "at"},
+		{"jlt", "at"},
+		{"jgt", "at"},
+		{"call", "t"},
+		{"jr", "a"},
+		{"random", "d"},
+		{"?in", "d"},
+		{"?out", "a"},
+		{"?end", ""},
+		{"?charset", "ac"},
+		{"?keyin", "d"},
+		{"?pxset", "abp"},
+		{"?clrscrn", ""}
+	};
+
+	// Return the operand of instruction of the given kind (see mnemonicToOperands) formatted as it would be written
+	// in assembly, with targetLabel standing in for the jump target if it isn't empty.
+	static std::string formatOperand(const Instruction &instruction, char operand, const std::string &targetLabel) {
+		switch (operand) {
+			case 'd':
+				return getRegisterName(getDestination(instruction));
+			case 'a':
+				return getRegisterName(getReadA(instruction));
+			case 'b':
+				return getRegisterName(getReadB(instruction));
+			case 'i':
+				return std::to_string(getImmediate(instruction));
+			case 'o':
+				return std::to_string(getOffset(instruction));
+			case 'c':
+				return std::to_string(instruction.getBitsInRange(16, 23));
+			case 'p':
+				return std::to_string(instruction.getBitsInRange(21, 21));
+			default:
+				return targetLabel.empty() ? std::to_string(getJumpTarget(instruction)) : targetLabel;
+		}
+	}
+
+	// Return the 6 bit opcode of instruction.
+	unsigned int getOpcode(const Instruction &instruction) {
+		return instruction.getBitsInRange(0, 5);
+	}
+
+	// Return the mnemonic of instruction (e.g. "addi"). Throws an exception if the opcode isn't a real one.
+	const std::string &getMnemonic(const Instruction &instruction) {
+		unsigned int opcode = getOpcode(instruction);
+		for (const std::pair<const std::string, unsigned int> &mnemonic : mnemonicToOpcodeMap) {
+			if (mnemonic.second == opcode) {
+				return mnemonic.first;
+			}
+		}
+		throw std::runtime_error("Invalid opcode " + std::to_string(opcode) + ".");
+	}
+
+	// Return the binary id of the register with the given name (e.g. "$ca").
+	unsigned int getRegisterId(const std::string &registerName) {
+		return registerToBinaryMap.at(registerName);
+	}
+
+	// Return the name of the register with the given binary id (e.g. "$ca").
+	const std::string &getRegisterName(unsigned int registerId) {
+		for (const std::pair<const std::string, unsigned int> &registerName : registerToBinaryMap) {
+			// $zero goes by $0 too, but $zero is what everyone writes.
+			if (registerName.second == registerId && registerName.first != "$0") {
+				return registerName.first;
+			}
+		}
+		throw std::runtime_error("Invalid register " + std::to_string(registerId) + ".");
+	}
+
+	// Return true iff instruction is the instruction with the given mnemonic.
+	bool is(const Instruction &instruction, const std::string &mnemonic) {
+		return getOpcode(instruction) == mnemonicToOpcodeMap.at(mnemonic);
+	}
+
+	// Return the register in the destination field of instruction (bits 6 to 10).
+	unsigned int getDestination(const Instruction &instruction) {
+		return instruction.getBitsInRange(DESTINATION_FIELD, DESTINATION_FIELD + 4);
+	}
+
+	// Return the register in the first read field of instruction (bits 11 to 15).
+	unsigned int getReadA(const Instruction &instruction) {
+		return instruction.getBitsInRange(READ_A_FIELD, READ_A_FIELD + 4);
+	}
+
+	// Return the register in the second read field of instruction (bits 16 to 20).
+	unsigned int getReadB(const Instruction &instruction) {
+		return instruction.getBitsInRange(READ_B_FIELD, READ_B_FIELD + 4);
+	}
+
+	// Return the 16 bit immediate value of instruction, as a signed number.
+	int getImmediate(const Instruction &instruction) {
+		return (int)(std::int16_t)instruction.getBitsInRange(16, 31);
+	}
+
+	// Set the 16 bit immediate value of instruction. Values that don't fit wrap around, the same way they would in a
+	// register.
+	void setImmediate(Instruction &instruction, int immediate) {
+		instruction.setBitsInRange(16, 31, (unsigned int)immediate & 0xffffu);
+	}
+
+	// Return the 8 bit memory offset of instruction (a lw or sw), as a signed number.
+	int getOffset(const Instruction &instruction) {
+		return (int)(std::int8_t)instruction.getBitsInRange(21, 28);
+	}
+
+	// Set the 8 bit memory offset of instruction (a lw or sw). Values that don't fit wrap around.
+	void setOffset(Instruction &instruction, int offset) {
+		instruction.setBitsInRange(21, 28, (unsigned int)offset & 0xffu);
+	}
+
+	// Return a new instruction with the given mnemonic and register fields, and everything else zero.
+	Instruction makeInstruction(const std::string &mnemonic, unsigned int destination, unsigned int readA,
+		unsigned int readB) {
+		Instruction instruction;
+		instruction.setBitsInRange(0, 5, mnemonicToOpcodeMap.at(mnemonic));
+		instruction.setBitsInRange(DESTINATION_FIELD, DESTINATION_FIELD + 4, destination);
+		instruction.setBitsInRange(READ_A_FIELD, READ_A_FIELD + 4, readA);
+		instruction.setBitsInRange(READ_B_FIELD, READ_B_FIELD + 4, readB);
+		return instruction;
+	}
+
+	// Return instruction written out as assembly (e.g. "addi $sp $sp 1"), with targetLabel standing in for the jump
+	// address if it isn't empty. Throws an exception if the opcode isn't a real one.
+	std::string disassemble(const Instruction &instruction, const std::string &targetLabel) {
+		const std::string &mnemonic = getMnemonic(instruction);
+		std::string text = mnemonic;
+		for (char operand : mnemonicToOperands.at(mnemonic)) {
+			text += " " + formatOperand(instruction, operand, targetLabel);
+		}
+		return text;
+	}
+
+	// Return every field of instruction that it uses, named and decoded (e.g. "op=12 dest=$sp readA=$sp imm=1").
+	// Throws an exception if the opcode isn't a real one.
+	std::string describeFields(const Instruction &instruction) {
+		static const std::map<char, std::string> operandNames = {
+			{'d', "dest"}, {'a', "readA"}, {'b', "readB"}, {'i', "imm"}, {'o', "offset"}, {'c', "char"}, {'p', "bit"},
+			{'t', "target"}
+		};
+		std::string text = "op=" + std::to_string(getOpcode(instruction));
+		for (char operand : mnemonicToOperands.at(getMnemonic(instruction))) {
+			text += " " + operandNames.at(operand) + "=" + formatOperand(instruction, operand, "");
+		}
+		return text;
+	}
+
+	// Return true iff instruction has a jump address (i.e. it's a jmp, call, jeq, jlt or jgt).
+	bool isJump(const Instruction &instruction) {
+		unsigned int opcode = getOpcode(instruction);
+		return opcode == JMP || opcode == CALL || opcode == JEQ || opcode == JLT || opcode == JGT;
+	}
+
+	// Return true iff instruction is a jump that may or may not be taken (i.e. jeq, jlt or jgt).
+	bool isConditionalJump(const Instruction &instruction) {
+		unsigned int opcode = getOpcode(instruction);
+		return opcode == JEQ || opcode == JLT || opcode == JGT;
+	}
+
+	// Return true iff instruction is a call.
+	bool isCall(const Instruction &instruction) {
+		return getOpcode(instruction) == CALL;
+	}
+
+	// Return true iff instruction jumps to the address held in a register (i.e. it's a jr).
+	bool isIndirectJump(const Instruction &instruction) {
+		return getOpcode(instruction) == JR;
+	}
+
+	// Return true iff execution can carry on to the next instruction after instruction. Calls count, since the
+	// subroutine returns there.
+	bool fallsThrough(const Instruction &instruction) {
+		unsigned int opcode = getOpcode(instruction);
+		return opcode != JMP && opcode != JR && opcode != END;
+	}
+
+	// Return true iff the only thing instruction does is write the registers it writes, so that it can be left out
+	// when nothing reads them (i.e. it can't fail, wait, or touch memory, the screen or the jump address).
+	bool onlyWritesRegisters(const Instruction &instruction) {
+		// Notably missing are div, which fails when dividing by zero, lw, which fails when the address is out of
+		// range, and random, whose sequence of numbers moves on every time it runs.
+		static const std::set<std::string> pureMnemonics = {
+			"add", "sub", "mul", "sll", "srl", "nor", "or", "and", "xor",
+			"addi", "slli", "srli", "nori", "ori", "andi", "xori", "cmp"
+		};
+		return pureMnemonics.count(getMnemonic(instruction)) > 0;
+	}
+
+	// Return the address instruction jumps to. Requires instruction to be a jump.
+	unsigned int getJumpTarget(const Instruction &instruction) {
+		return instruction.getBitsInRange(16, 24);
+	}
+
+	// Set the address instruction jumps to. Requires instruction to be a jump.
+	void setJumpTarget(Instruction &instruction, unsigned int target) {
+		// Instruction memory is only 512 instructions large, so jump addresses only need to be 9 bits.
+		instruction.setBitsInRange(16, 24, target);
+	}
+
+	// Overwrite registers with the ids of all the registers instruction reads.
+	void getReadRegisters(const Instruction &instruction, std::vector<unsigned int> &registers) {
+		registers.clear();
+		const RegisterUsage &usage = mnemonicToRegisterUsage.at(getMnemonic(instruction));
+		if (usage.readsA) {
+			registers.push_back(getReadA(instruction));
+		}
+		if (usage.readsB) {
+			registers.push_back(getReadB(instruction));
+		}
+	}
+
+	// Overwrite registers with the ids of all the registers instruction writes (including ones written behind the
+	// scenes, e.g. $ca by call). Writes to $zero, which never change it, are left out.
+	void getWrittenRegisters(const Instruction &instruction, std::vector<unsigned int> &registers) {
+		registers.clear();
+		const RegisterUsage &usage = mnemonicToRegisterUsage.at(getMnemonic(instruction));
+		if (usage.writesDestination) {
+			unsigned int destination = getDestination(instruction);
+			// $wr can't be written normally either.
+			if (destination != ZERO_REGISTER && destination != WR_REGISTER) {
+				registers.push_back(destination);
+			}
+		}
+		// Multiplying puts the high half of the result in $wr, and calling puts the return address in $ca.
+		if (getOpcode(instruction) == MUL) {
+			registers.push_back(WR_REGISTER);
+		}
+		if (getOpcode(instruction) == CALL) {
+			registers.push_back(CA_REGISTER);
+		}
+	}
+}
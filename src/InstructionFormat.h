@@ -0,0 +1,77 @@
+#include <string>
+#include <vector>
+#include "Instruction.h"
+
+#ifndef INSTRUCTION_FORMAT_H
+#define INSTRUCTION_FORMAT_H
+
+// Contains utility functions for picking apart instructions that have already been assembled into machine code, e.g.
+// to find where a jump goes or which registers an instruction touches. These are what let the assembler and linker
+// rework programs after they've been encoded (e.g. removing code that can never run).
+namespace InstructionFormat {
+	// Return the 6 bit opcode of instruction.
+	unsigned int getOpcode(const Instruction &instruction);
+	// Return the mnemonic of instruction (e.g. "addi"). Throws an exception if the opcode isn't a real one.
+	const std::string &getMnemonic(const Instruction &instruction);
+	// Return the binary id of the register with the given name (e.g. "$ca").
+	unsigned int getRegisterId(const std::string &registerName);
+	// Return the name of the register with the given binary id (e.g. "$ca").
+	const std::string &getRegisterName(unsigned int registerId);
+	// Return true iff instruction is the instruction with the given mnemonic.
+	bool is(const Instruction &instruction, const std::string &mnemonic);
+
+	// Return the register in the destination field of instruction (bits 6 to 10).
+	unsigned int getDestination(const Instruction &instruction);
+	// Return the register in the first read field of instruction (bits 11 to 15).
+	unsigned int getReadA(const Instruction &instruction);
+	// Return the register in the second read field of instruction (bits 16 to 20).
+	unsigned int getReadB(const Instruction &instruction);
+	// Return the 16 bit immediate value of instruction, as a signed number.
+	int getImmediate(const Instruction &instruction);
+	// Set the 16 bit immediate value of instruction. Values that don't fit wrap around, the same way they would in
+	// a register.
+	void setImmediate(Instruction &instruction, int immediate);
+	// Return the 8 bit memory offset of instruction (a lw or sw), as a signed number.
+	int getOffset(const Instruction &instruction);
+	// Set the 8 bit memory offset of instruction (a lw or sw). Values that don't fit wrap around.
+	void setOffset(Instruction &instruction, int offset);
+
+	// Return a new instruction with the given mnemonic and register fields, and everything else zero.
+	Instruction makeInstruction(const std::string &mnemonic, unsigned int destination, unsigned int readA,
+		unsigned int readB);
+
+	// Return instruction written out as assembly (e.g. "addi $sp $sp 1"), with targetLabel standing in for the jump
+	// address if it isn't empty. Throws an exception if the opcode isn't a real one.
+	std::string disassemble(const Instruction &instruction, const std::string &targetLabel);
+	// Return every field of instruction that it uses, named and decoded (e.g. "op=12 dest=$sp readA=$sp imm=1").
+	// Throws an exception if the opcode isn't a real one.
+	std::string describeFields(const Instruction &instruction);
+
+	// Return true iff instruction has a jump address (i.e. it's a jmp, call, jeq, jlt or jgt).
+	bool isJump(const Instruction &instruction);
+	// Return true iff instruction is a jump that may or may not be taken (i.e. jeq, jlt or jgt).
+	bool isConditionalJump(const Instruction &instruction);
+	// Return true iff instruction is a call.
+	bool isCall(const Instruction &instruction);
+	// Return true iff instruction jumps to the address held in a register (i.e. it's a jr).
+	bool isIndirectJump(const Instruction &instruction);
+	// Return true iff execution can carry on to the next instruction after instruction. Calls count, since the
+	// subroutine returns there.
+	bool fallsThrough(const Instruction &instruction);
+	// Return true iff the only thing instruction does is write the registers it writes, so that it can be left
+	// out when nothing reads them (i.e. it can't fail, wait, or touch memory, the screen or the jump address).
+	bool onlyWritesRegisters(const Instruction &instruction);
+
+	// Return the address instruction jumps to. Requires instruction to be a jump.
+	unsigned int getJumpTarget(const Instruction &instruction);
+	// Set the address instruction jumps to. Requires instruction to be a jump.
+	void setJumpTarget(Instruction &instruction, unsigned int target);
+
+	// Overwrite registers with the ids of all the registers instruction reads.
+	void getReadRegisters(const Instruction &instruction, std::vector<unsigned int> &registers);
+	// Overwrite registers with the ids of all the registers instruction writes (including ones written behind the
+	// scenes, e.g. $ca by call). Writes to $zero, which never change it, are left out.
+	void getWrittenRegisters(const Instruction &instruction, std::vector<unsigned int> &registers);
+};
+
+#endif
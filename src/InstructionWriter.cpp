@@ -1,47 +1,44 @@
 #include "InstructionWriter.h"
+#include "ConstantExpression.h"
 
-// Maps labels onto definitions (i.e. instrction memory addresses).
-std::map<std::string, unsigned int> InstructionWriter::labelMap;
-// Maps constants onto integer definitions.
-std::map<std::string, int> InstructionWriter::constantMap;
 // Maps mnemonics onto corresponding write functions (i.e. for each instruction, gives instructions on how to
 // format it into machine code).
-const std::map<std::string, std::function<void(Instruction&, const std::vector<std::string>&)> > 
+const std::map<std::string, std::function<void(InstructionWriter&, Instruction&, const std::vector<std::string>&)> > 
 		InstructionWriter::mnemonicToWriteFuncts = {
-	{"add", InstructionWriter::writeRType3},
-	{"sub", InstructionWriter::writeRType3},
-	{"mul", InstructionWriter::writeRType3},
-	{"div", InstructionWriter::writeRType3},
-	{"sll", InstructionWriter::writeRType3},
-	{"srl", InstructionWriter::writeRType3},
-	{"nor", InstructionWriter::writeRType3},
-	{"or", InstructionWriter::writeRType3},
-	{"and", InstructionWriter::writeRType3},
-	{"xor", InstructionWriter::writeRType3},
-	{"lw", InstructionWriter::writeLW},
-	{"sw", InstructionWriter::writeSW},
-	{"addi", InstructionWriter::writeIType},
-	{"slli", InstructionWriter::writeIType},
-	{"srli", InstructionWriter::writeIType},
-	{"nori", InstructionWriter::writeIType},
-	{"ori", InstructionWriter::writeIType},
-	{"andi", InstructionWriter::writeIType},
-	{"xori", InstructionWriter::writeIType},
-	{"cmp", InstructionWriter::writeRType3},
-	{"jmp", InstructionWriter::writeJType},
-	{"jeq", InstructionWriter::writeCondJType},
-	{"jlt", InstructionWriter::writeCondJType},
-	{"jgt", InstructionWriter::writeCondJType},
-	{"call", InstructionWriter::writeJType},
-	{"jr", InstructionWriter::writeRType1Read},
-	{"random", InstructionWriter::writeRType1Write},
-	{"?in", InstructionWriter::writeRType1Write},
-	{"?out", InstructionWriter::writeRType1Read},
-	{"?end", InstructionWriter::writeNothing},
-	{"?charset", InstructionWriter::writeCharset},
-	{"?keyin", InstructionWriter::writeRType1Write},
-	{"?pxset", InstructionWriter::writePxset},
-	{"?clrscrn", InstructionWriter::writeNothing}
+	{"add", &InstructionWriter::writeRType3},
+	{"sub", &InstructionWriter::writeRType3},
+	{"mul", &InstructionWriter::writeRType3},
+	{"div", &InstructionWriter::writeRType3},
+	{"sll", &InstructionWriter::writeRType3},
+	{"srl", &InstructionWriter::writeRType3},
+	{"nor", &InstructionWriter::writeRType3},
+	{"or", &InstructionWriter::writeRType3},
+	{"and", &InstructionWriter::writeRType3},
+	{"xor", &InstructionWriter::writeRType3},
+	{"lw", &InstructionWriter::writeLW},
+	{"sw", &InstructionWriter::writeSW},
+	{"addi", &InstructionWriter::writeIType},
+	{"slli", &InstructionWriter::writeIType},
+	{"srli", &InstructionWriter::writeIType},
+	{"nori", &InstructionWriter::writeIType},
+	{"ori", &InstructionWriter::writeIType},
+	{"andi", &InstructionWriter::writeIType},
+	{"xori", &InstructionWriter::writeIType},
+	{"cmp", &InstructionWriter::writeRType3},
+	{"jmp", &InstructionWriter::writeJType},
+	{"jeq", &InstructionWriter::writeCondJType},
+	{"jlt", &InstructionWriter::writeCondJType},
+	{"jgt", &InstructionWriter::writeCondJType},
+	{"call", &InstructionWriter::writeJType},
+	{"jr", &InstructionWriter::writeRType1Read},
+	{"random", &InstructionWriter::writeRType1Write},
+	{"?in", &InstructionWriter::writeRType1Write},
+	{"?out", &InstructionWriter::writeRType1Read},
+	{"?end", &InstructionWriter::writeNothing},
+	{"?charset", &InstructionWriter::writeCharset},
+	{"?keyin", &InstructionWriter::writeRType1Write},
+	{"?pxset", &InstructionWriter::writePxset},
+	{"?clrscrn", &InstructionWriter::writeNothing}
 };
 
 // Given a parsed instruction parsedLine, output a machine code version of that instruction to the 
@@ -58,11 +55,14 @@ void InstructionWriter::writeInstruction(Instruction &outInstruction, const std:
 	}
 	
 	// Actually attempt to write the function, catching and propagating any excpetions that are thrown.
+	InstructionWriter::labelReferences.clear();
+	InstructionWriter::addressReferences.clear();
+	InstructionWriter::constantReferences.clear();
 	try {
 		// Write opcode.
 		InstructionWriter::writeOpcode(outInstruction, parsedLine[0]);
 		// Write the rest of the instruction.
-		InstructionWriter::mnemonicToWriteFuncts.find(parsedLine[0])->second(outInstruction, parsedLine);
+		InstructionWriter::mnemonicToWriteFuncts.find(parsedLine[0])->second(*this, outInstruction, parsedLine);
 	}
 	catch (std::exception &e) {
 		throw std::runtime_error(e.what());
@@ -70,7 +70,9 @@ void InstructionWriter::writeInstruction(Instruction &outInstruction, const std:
 }
 
 // Define a constant with name name and value value. Throws an exception if there is already a constant with
-// this name, if the constant name matches a mnemonic, if the value is non-numeric, or if name does not start with a letter. Takes the following:
+// this name, if the constant name matches a mnemonic, if the value is not a valid constant expression (see
+// ConstantExpression) made up of constants defined so far, or if name does not start with a letter. Takes the
+// following:
 // - The name of the constant.
 // - The value of the constant as a string.
 void InstructionWriter::defineConstant(const std::string &name, const std::string &value) {
@@ -86,12 +88,17 @@ void InstructionWriter::defineConstant(const std::string &name, const std::strin
 	if (mnemonicToOpcodeMap.find(name) != mnemonicToOpcodeMap.end()) {
 		throw std::runtime_error("Constants cannot match instruction mnemonics.");
 	}
-	// Check if value is numeric, if it's not throw an excpetion.
-	if (!Parser::isNumeric(value)) {
-		throw std::runtime_error("Constant value " + value + " is not numeric.");
-	}
-	//Otherwise, go ahead and define it!
-	InstructionWriter::constantMap[name] = std::stoi(value);
+	// Work out the value, which can only use constants defined before it. Labels aren't allowed, since label
+	// addresses can change after the fact (e.g. when the program is optimized) but constants can't.
+	std::int64_t toDefine = ConstantExpression::evaluate(value, [this](const std::string &constant,
+		std::int64_t &constantValue) {
+		std::map<std::string, int>::const_iterator found = this->constantMap.find(constant);
+		constantValue = found != this->constantMap.end() ? found->second : 0;
+		return found != this->constantMap.end();
+	});
+	// Otherwise, go ahead and define it! Constants are held as ints, so unsigned values too large for one wrap
+	// around into negative ones.
+	InstructionWriter::constantMap[name] = (int)(std::uint32_t)toDefine;
 }
 
 // Define a label with name name and address address. Throws an exception if there is already a label with
@@ -109,6 +116,38 @@ void InstructionWriter::defineLabel(const std::string &name, unsigned int addres
 	InstructionWriter::labelMap[name] = address;
 }
 
+// Return the map of all labels defined so far onto their instruction memory addresses.
+const std::map<std::string, unsigned int> &InstructionWriter::getLabelMap() const {
+	return this->labelMap;
+}
+
+// Return the map of all constants defined so far onto their integer values.
+const std::map<std::string, int> &InstructionWriter::getConstantMap() const {
+	return this->constantMap;
+}
+
+// Allow (or disallow) jumps to labels that aren't defined, for code that will be linked with code defining them later.
+// Jump addresses for undefined labels are left as zero.
+void InstructionWriter::setAllowUndefinedLabels(bool allow) {
+	this->allowUndefinedLabels = allow;
+}
+
+// Return the names of all labels jumped to by the last instruction written, in the order they appear.
+const std::vector<std::string> &InstructionWriter::getLabelReferences() const {
+	return this->labelReferences;
+}
+
+// Return the names of all labels whose addresses were used as values in the immediate of the last instruction written,
+// in the order they appear.
+const std::vector<std::string> &InstructionWriter::getAddressReferences() const {
+	return this->addressReferences;
+}
+
+// Return the names of all constants used in the immediate of the last instruction written, in the order they appear.
+const std::vector<std::string> &InstructionWriter::getConstantReferences() const {
+	return this->constantReferences;
+}
+
 // HELPER FUNCTIONS.
 // Writes an 5 bit opcode to target given a mnemonic string.
 void InstructionWriter::writeOpcode(Instruction &target, const std::string &mnemonic) {
@@ -130,41 +169,71 @@ void InstructionWriter::writeRegister(const std::string &regString, Instruction
 	target.setBitsInRange(startInd, startInd + 4, registerToBinaryMap.find(regString)->second);
 }
 
+// Return the value of the constant expression value (see ConstantExpression), which may use constants and (when
+// assembling a complete program) label addresses, the same as an immediate of size bits would. Every constant and
+// label used is recorded in place of those used by the last instruction written. Throws an exception if the
+// expression can't be worked out, or if its value doesn't fit in size bits either signed or unsigned.
+std::int64_t InstructionWriter::evaluateValue(const std::string &value, unsigned int size) {
+	this->addressReferences.clear();
+	this->constantReferences.clear();
+
+	// Work out the value, recording every constant and label it used along the way. Constants take priority over
+	// labels with the same name.
+	std::int64_t result = ConstantExpression::evaluate(value, [this](const std::string &name, 
+		std::int64_t &value) {
+		if (this->constantMap.find(name) != this->constantMap.end()) {
+			value = this->constantMap.find(name)->second;
+			this->constantReferences.push_back(name);
+			return true;
+		}
+		if (this->labelMap.find(name) != this->labelMap.end()) {
+			// Code that's going to be linked doesn't know where it'll end up yet.
+			if (this->allowUndefinedLabels) {
+				throw std::runtime_error("Label " + name + " can't be used as a value in relocatable code.");
+			}
+			value = this->labelMap.find(name)->second;
+			this->addressReferences.push_back(name);
+			return true;
+		}
+		return false;
+	});
+
+	// Make sure the value fits, reading it as either signed or unsigned.
+	const std::int64_t minimum = -((std::int64_t)1 << (size - 1));
+	const std::int64_t maximum = ((std::int64_t)1 << size) - 1;
+	if (result < minimum || result > maximum) {
+		std::string workedOut = std::to_string(result) != value ? " (" + std::to_string(result) + ")" : "";
+		throw std::runtime_error("Immediate value " + value + workedOut + " doesn't fit in a " + 
+			std::to_string(size) + " bit field.");
+	}
+	return result;
+}
+
 // Write an immediate value immediate to target given a start index and a number of bits of immediate to
-// write (size). The immediate value is passed as a string, and also checks for constants it may be if it
-// is non-numeric. Throws an exception if the value is non-numeric but also not defined as a constant.
+// write (size). The immediate value is passed as a string holding a constant expression (see ConstantExpression),
+// which may use constants and (when assembling a complete program) label addresses. Throws an exception if the
+// expression can't be worked out, or if its value doesn't fit in size bits either signed or unsigned.
 void InstructionWriter::writeImmediateValue(const std::string &immediate, Instruction &target, 
 		unsigned int startInd, unsigned int size) {
-	// Determine what value to write by checking if it's numeric or a constant.
-	int toWrite = 0;
-	// If it is numeric, we're dealing with a straight number.
-	if (Parser::isNumeric(immediate)) {
-		toWrite = std::stoul(immediate);
-	}
-	// Else it's either a constant or invalid.
-	else {
-		// Check it it's in the constant map. If not, throw exception.
-		if (InstructionWriter::constantMap.find(immediate) == InstructionWriter::constantMap.end()) {
-			throw std::runtime_error("Undefined constant " + immediate + ".");
-		}
-		// Otherwise, it is and we should find the value to write.
-		toWrite = InstructionWriter::constantMap.find(immediate)->second;
-	}
-	
-	// Now that we know the value, go right ahead and write it to the instruction.
-	target.setBitsInRange(startInd, (startInd + size) - 1, toWrite);	
+	std::int64_t toWrite = this->evaluateValue(immediate, size);
+	target.setBitsInRange(startInd, (startInd + size) - 1, (unsigned int)toWrite);	
 }
 
-// Write a label to target given its name as a string by looking it up in the label map. If the label
-// is not defined, throw an exception.
+// Write a label to target given its name as a string by looking it up in the label map, and record the reference. If
+// the label is not defined (and undefined labels aren't allowed), throw an exception.
 void InstructionWriter::writeLabel(const std::string &label, Instruction &target) {
 	// Try to fetch label to write from our label map. If we can't find it, it's undefined and we should 
-	// throw an exception.
+	// throw an exception, unless it's going to be filled in by the linker.
 	unsigned int addressToWrite = 0;
 	if (InstructionWriter::labelMap.find(label) == InstructionWriter::labelMap.end()) {
-		throw std::runtime_error("Undefined label " + label + ".");
+		if (!InstructionWriter::allowUndefinedLabels) {
+			throw std::runtime_error("Undefined label " + label + ".");
+		}
+	}
+	else {
+		addressToWrite = InstructionWriter::labelMap.find(label)->second;
 	}
-	addressToWrite = InstructionWriter::labelMap.find(label)->second;
+	InstructionWriter::labelReferences.push_back(label);
 
 	// Instruction memory is only 512 instructions large, so jump addresses only need to be 9 bits.
 	target.setBitsInRange(16, 24, addressToWrite);
@@ -0,0 +1,252 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include "Linker.h"
+#include "ProgramEditor.h"
+#include "DeadCodeEliminator.h"
+
+namespace Linker {
+	// Every object file starts with these four bytes, followed by the format version.
+	static const std::string OBJECT_FILE_MAGIC = "SOBJ";
+
+	// Write value to out as 4 bytes, little endian (the same way instructions are written).
+	static void writeWord(std::ofstream &out, unsigned int value) {
+		for (unsigned int i = 0; i < 4u; i++) {
+			out.put((char)(BYTE)(value >> (BYTE_SIZE * i)));
+		}
+	}
+
+	// Write s to out as its length followed by its characters.
+	static void writeString(std::ofstream &out, const std::string &s) {
+		writeWord(out, (unsigned int)s.size());
+		out.write(s.data(), s.size());
+	}
+
+	// Walks through the contents of an object file, throwing an exception if we try to read past the end of it.
+	class ObjectFileReader {
+	public:
+		ObjectFileReader(const std::string &contents, const std::string &fileName)
+			: contents(contents), fileName(fileName) {}
+
+		// Read count bytes, returning them as a string.
+		std::string readBytes(unsigned int count) {
+			if (count > this->contents.size() - this->position) {
+				throw std::runtime_error("Object file " + this->fileName + " is corrupt!");
+			}
+			this->position += count;
+			return this->contents.substr(this->position - count, count);
+		}
+
+		// Read 4 bytes, little endian.
+		unsigned int readWord() {
+			std::string bytes = this->readBytes(4u);
+			unsigned int value = 0u;
+			for (unsigned int i = 0; i < 4u; i++) {
+				value |= (unsigned int)(BYTE)bytes[i] << (BYTE_SIZE * i);
+			}
+			return value;
+		}
+
+		// Read a string written by writeString().
+		std::string readString() {
+			return this->readBytes(this->readWord());
+		}
+
+	private:
+		const std::string &contents;
+		const std::string &fileName;
+		// Index of the next byte to read.
+		std::size_t position = 0;
+	};
+
+	// Return true iff the program was linked without any problems.
+	bool Result::succeeded() const {
+		return this->errors.size() == 0;
+	}
+
+	// Return the object file for code assembled by Assembler::assemble() with the relocatable option set.
+	ObjectFile makeObjectFile(const Assembler::Result &assembled) {
+		ObjectFile object;
+		object.machineCode = assembled.machineCode;
+		object.labels.insert(assembled.labels.begin(), assembled.labels.end());
+		object.relocations = assembled.relocations;
+		return object;
+	}
+
+	// Write an object file to the file fileName. Throws an exception if the file could not be written.
+	void saveObjectFile(const ObjectFile &object, const std::string &fileName) {
+		std::ofstream outFile(fileName, std::ios::binary);
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue opening output file " + fileName + "!");
+		}
+
+		// Header.
+		outFile.write(OBJECT_FILE_MAGIC.data(), OBJECT_FILE_MAGIC.size());
+		writeWord(outFile, OBJECT_FILE_VERSION);
+
+		// Code.
+		writeWord(outFile, (unsigned int)object.machineCode.size());
+		for (const Instruction &instruction : object.machineCode) {
+			instruction.writeToFile(outFile);
+		}
+
+		// Labels, sorted so the same code always gives exactly the same file.
+		std::vector<std::pair<std::string, unsigned int> > labels(object.labels.begin(), object.labels.end());
+		std::sort(labels.begin(), labels.end());
+		writeWord(outFile, (unsigned int)labels.size());
+		for (const std::pair<std::string, unsigned int> &label : labels) {
+			writeWord(outFile, label.second);
+			writeString(outFile, label.first);
+		}
+
+		// Relocations.
+		writeWord(outFile, (unsigned int)object.relocations.size());
+		for (const Assembler::Relocation &relocation : object.relocations) {
+			writeWord(outFile, relocation.address);
+			writeString(outFile, relocation.label);
+		}
+
+		outFile.close();
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue writing output file " + fileName + "!");
+		}
+	}
+
+	// Read the object file fileName. Throws an exception if the file can't be read or isn't a valid object file.
+	ObjectFile loadObjectFile(const std::string &fileName) {
+		std::ifstream inFile(fileName, std::ios::binary);
+		if (!inFile.good()) {
+			throw std::runtime_error("invalid file " + fileName + "!");
+		}
+		std::ostringstream buffer;
+		buffer << inFile.rdbuf();
+		const std::string contents = buffer.str();
+		ObjectFileReader reader(contents, fileName);
+
+		// Make sure this is actually an object file we understand.
+		if (reader.readBytes((unsigned int)OBJECT_FILE_MAGIC.size()) != OBJECT_FILE_MAGIC) {
+			throw std::runtime_error(fileName + " is not a shroom16 object file!");
+		}
+		if (reader.readWord() != OBJECT_FILE_VERSION) {
+			throw std::runtime_error("Object file " + fileName + " was made by a different version of shroomasm!");
+		}
+
+		ObjectFile object;
+		object.machineCode.resize(reader.readWord());
+		for (Instruction &instruction : object.machineCode) {
+			instruction.setBitsInRange(0u, INSTRUCTION_SIZE - 1, reader.readWord());
+		}
+		unsigned int labelCount = reader.readWord();
+		for (unsigned int i = 0; i < labelCount; i++) {
+			unsigned int address = reader.readWord();
+			object.labels[reader.readString()] = address;
+		}
+		unsigned int relocationCount = reader.readWord();
+		for (unsigned int i = 0; i < relocationCount; i++) {
+			unsigned int address = reader.readWord();
+			object.relocations.push_back({address, reader.readString()});
+			if (address >= object.machineCode.size()) {
+				throw std::runtime_error("Object file " + fileName + " is corrupt!");
+			}
+		}
+		return object;
+	}
+
+	// Link objects into a single program, placing them one after the other in the order given (so the first object
+	// is where the program starts running). Jumps to labels an object doesn't define itself go to whichever other
+	// object defines them. objectNames gives the name of each object, for use in error messages. Takes time linear
+	// in the total number of instructions, labels and relocations. If doRemoveUnreachableCode is set, code that can
+	// never run is removed from the linked program (see DeadCodeEliminator).
+	Result link(const std::vector<ObjectFile> &objects, const std::vector<std::string> &objectNames, 
+		bool doRemoveUnreachableCode) {
+		Result result;
+
+		// Lay the objects out one after the other, noting where each one starts.
+		std::vector<unsigned int> startAddresses;
+		for (const ObjectFile &object : objects) {
+			startAddresses.push_back((unsigned int)result.machineCode.size());
+			result.machineCode.insert(result.machineCode.end(), object.machineCode.begin(),
+				object.machineCode.end());
+		}
+		// Every jump in the linked program, along with the address it goes to.
+		std::vector<std::pair<unsigned int, unsigned int> > jumps;
+
+		// Map every label onto the object that defines it. Labels defined by more than one object are fine as long
+		// as no other object needs them (e.g. two libraries that both have their own :loop).
+		std::unordered_map<std::string, unsigned int> definingObjects;
+		std::unordered_map<std::string, unsigned int> duplicateDefinitions;
+		for (unsigned int i = 0; i < objects.size(); i++) {
+			for (const std::pair<const std::string, unsigned int> &label : objects[i].labels) {
+				if (!definingObjects.insert({label.first, i}).second) {
+					duplicateDefinitions.insert({label.first, i});
+				}
+			}
+		}
+
+		// Now fill in every jump address.
+		for (unsigned int i = 0; i < objects.size(); i++) {
+			for (const Assembler::Relocation &relocation : objects[i].relocations) {
+				// Labels an object defines itself always win.
+				unsigned int address = 0;
+				std::unordered_map<std::string, unsigned int>::const_iterator local =
+					objects[i].labels.find(relocation.label);
+				if (local != objects[i].labels.end()) {
+					address = startAddresses[i] + local->second;
+				}
+				else {
+					std::unordered_map<std::string, unsigned int>::const_iterator definer =
+						definingObjects.find(relocation.label);
+					if (definer == definingObjects.end()) {
+						result.errors.push_back(objectNames[i] + ": Error: Undefined label " +
+							relocation.label + ".");
+						continue;
+					}
+					std::unordered_map<std::string, unsigned int>::const_iterator duplicate =
+						duplicateDefinitions.find(relocation.label);
+					if (duplicate != duplicateDefinitions.end()) {
+						result.errors.push_back(objectNames[i] + ": Error: Label " + relocation.label +
+							" is defined in both " + objectNames[definer->second] + " and " +
+							objectNames[duplicate->second] + ".");
+						continue;
+					}
+					address = startAddresses[definer->second] +
+						objects[definer->second].labels.find(relocation.label)->second;
+				}
+
+				jumps.push_back({startAddresses[i] + relocation.address, address});
+			}
+		}
+		if (!result.succeeded()) {
+			return result;
+		}
+
+		if (doRemoveUnreachableCode) {
+			// The editor needs to know exactly where every jump goes, even in programs too large for jump
+			// addresses to fit (which might not be once they're trimmed down), so give it a label for every
+			// address jumped to.
+			Assembler::Result program;
+			program.machineCode.swap(result.machineCode);
+			for (const std::pair<unsigned int, unsigned int> &jump : jumps) {
+				program.labels[std::to_string(jump.second)] = jump.second;
+				program.relocations.push_back({jump.first, std::to_string(jump.second)});
+			}
+			ProgramEditor editor(program);
+			result.removedInstructionCount = DeadCodeEliminator::removeUnreachableCode(editor);
+			editor.writeTo(program);
+			result.machineCode.swap(program.machineCode);
+		}
+		else {
+			// Instruction memory is only 512 instructions large, so jump addresses only need to be 9 bits.
+			for (const std::pair<unsigned int, unsigned int> &jump : jumps) {
+				result.machineCode[jump.first].setBitsInRange(16, 24, jump.second);
+			}
+		}
+
+		if (result.machineCode.size() > INSTRUCTION_MEMORY_SIZE) {
+			result.errors.push_back("Error: Program too large! Max size is " +
+				std::to_string(INSTRUCTION_MEMORY_SIZE) + " instructions!");
+		}
+		return result;
+	}
+}
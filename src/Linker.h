@@ -0,0 +1,58 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Instruction.h"
+#include "Assembler.h"
+
+#ifndef LINKER_H
+#define LINKER_H
+
+// Version of the object file format. This must be bumped any time the layout of object files changes, so that the
+// linker can refuse object files it doesn't understand rather than misreading them.
+#define OBJECT_FILE_VERSION 1u
+
+// Contains the Shroom16 linker, which puts separately assembled pieces of code (object files, made by shroomasm -c)
+// together into a single program. This means that a library of routines only has to be assembled once, however many
+// programs use it. Like the assembler, nothing in here is static or global.
+namespace Linker {
+	// A separately assembled piece of code, as stored in a .shroomobj file.
+	struct ObjectFile {
+		// The assembled code, with its own labels addressed as if it started at address zero.
+		std::vector<Instruction> machineCode;
+		// All labels defined by the code, mapped onto their addresses relative to the start of the code.
+		std::unordered_map<std::string, unsigned int> labels;
+		// Every jump in the code, whose address the linker has to fill in.
+		std::vector<Assembler::Relocation> relocations;
+	};
+
+	// Everything that comes out of linking a program. If any errors were reported, the program could not be linked
+	// and the machine code should not be used.
+	struct Result {
+		// The linked program, one instruction per instruction memory address.
+		std::vector<Instruction> machineCode;
+		// Every problem found while linking, already formatted for printing.
+		std::vector<std::string> errors;
+		// Number of instructions removed because they could never run.
+		unsigned int removedInstructionCount = 0;
+
+		// Return true iff the program was linked without any problems.
+		bool succeeded() const;
+	};
+
+	// Return the object file for code assembled by Assembler::assemble() with the relocatable option set.
+	ObjectFile makeObjectFile(const Assembler::Result &assembled);
+	// Write an object file to the file fileName. Throws an exception if the file could not be written.
+	void saveObjectFile(const ObjectFile &object, const std::string &fileName);
+	// Read the object file fileName. Throws an exception if the file can't be read or isn't a valid object file.
+	ObjectFile loadObjectFile(const std::string &fileName);
+
+	// Link objects into a single program, placing them one after the other in the order given (so the first object
+	// is where the program starts running). Jumps to labels an object doesn't define itself go to whichever other
+	// object defines them. objectNames gives the name of each object, for use in error messages. Takes time linear
+	// in the total number of instructions, labels and relocations. If doRemoveUnreachableCode is set, code that
+	// can never run is removed from the linked program (see DeadCodeEliminator).
+	Result link(const std::vector<ObjectFile> &objects, const std::vector<std::string> &objectNames, 
+		bool doRemoveUnreachableCode = false);
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include "Listing.h"
+#include "CycleEstimator.h"
+#include "InstructionFormat.h"
+
+namespace Listing {
+	// Widths of the columns of the listing that are padded out to line up.
+	static const int TICKS_WIDTH = 6;
+	static const int INSTRUCTION_WIDTH = 28;
+	static const int FIELDS_WIDTH = 44;
+
+	// Return the ticks instruction takes, as "<not taken>/<taken>" for jumps that might not be taken.
+	static std::string formatTicks(const Instruction &instruction) {
+		unsigned int notTaken = CycleEstimator::getTicks(instruction, false);
+		if (InstructionFormat::isConditionalJump(instruction)) {
+			return std::to_string(notTaken) + "/" + std::to_string(CycleEstimator::getTicks(instruction, true));
+		}
+		// Unconditional jumps are always taken.
+		if (InstructionFormat::isJump(instruction) || InstructionFormat::isIndirectJump(instruction)) {
+			return std::to_string(CycleEstimator::getTicks(instruction, true));
+		}
+		return std::to_string(notTaken);
+	}
+
+	// Return a listing of program (which must have been assembled without problems), headed by title.
+	std::string formatListing(const Assembler::Result &program, const std::string &title) {
+		// Labels to show jumps going to, and to put above the instructions they point at. Jumps the linker fills in
+		// later go to the label they were written with instead.
+		std::multimap<unsigned int, std::string> addressLabels;
+		for (const std::pair<const std::string, unsigned int> &label : program.labels) {
+			addressLabels.insert(std::make_pair(label.second, label.first));
+		}
+		std::map<unsigned int, std::string> relocatedLabels;
+		for (const Assembler::Relocation &relocation : program.relocations) {
+			relocatedLabels[relocation.address] = relocation.label;
+		}
+
+		std::ostringstream listing;
+		listing << "; Listing of " << title << ", " << program.machineCode.size() << " of " <<
+			INSTRUCTION_MEMORY_SIZE << " instruction slots used.\n";
+		listing << "; Ticks are for the instruction alone, and for jumps that might not be taken, not taken/taken.\n";
+		listing << ";\n; addr  encoding    " << std::left << std::setw(TICKS_WIDTH) << "ticks" <<
+			std::setw(INSTRUCTION_WIDTH) << "instruction" << std::setw(FIELDS_WIDTH) << "fields" << "source\n";
+		for (unsigned int i = 0; i < program.machineCode.size(); i++) {
+			const Instruction &instruction = program.machineCode[i];
+			std::multimap<unsigned int, std::string>::const_iterator label = addressLabels.lower_bound(i);
+			for (; label != addressLabels.end() && label->first == i; label++) {
+				listing << label->second << ":\n";
+			}
+
+			// Name the label a jump goes to, if it goes to one.
+			std::string targetLabel;
+			if (InstructionFormat::isJump(instruction)) {
+				std::map<unsigned int, std::string>::const_iterator relocated = relocatedLabels.find(i);
+				std::multimap<unsigned int, std::string>::const_iterator target =
+					addressLabels.find(InstructionFormat::getJumpTarget(instruction));
+				if (relocated != relocatedLabels.end()) {
+					targetLabel = relocated->second;
+				}
+				else if (target != addressLabels.end()) {
+					targetLabel = target->second;
+				}
+			}
+
+			const Assembler::SourceLocation &location = program.sourceLocations[i];
+			listing << "  " << std::right << std::setfill('0') << std::setw(3) << i << "   0x" << std::hex <<
+				std::setw(8) << instruction.getBitsInRange(0, INSTRUCTION_SIZE - 1) << std::dec <<
+				std::setfill(' ') << "  " << std::left << std::setw(TICKS_WIDTH) << formatTicks(instruction) <<
+				std::setw(INSTRUCTION_WIDTH) << InstructionFormat::disassemble(instruction, targetLabel) <<
+				std::setw(FIELDS_WIDTH) << InstructionFormat::describeFields(instruction) <<
+				(location.fileName.empty() ? "" : location.fileName + ":") << location.lineNumber << ": " <<
+				location.text << "\n";
+		}
+
+		// Then every symbol, sorted by name.
+		listing << "\n; Labels\n";
+		for (const std::pair<const std::string, unsigned int> &label : program.labels) {
+			listing << "  " << std::setw(INSTRUCTION_WIDTH) << label.first << label.second << "\n";
+		}
+		listing << "\n; Constants\n";
+		for (const std::pair<const std::string, int> &constant : program.constants) {
+			listing << "  " << std::setw(INSTRUCTION_WIDTH) << constant.first << constant.second << "\n";
+		}
+		return listing.str();
+	}
+
+	// Write a listing of program (which must have been assembled without problems), headed by title, to the file
+	// fileName in one go. Throws an exception if the file could not be written.
+	void saveListing(const Assembler::Result &program, const std::string &title, const std::string &fileName) {
+		// Build the whole listing up in memory first, so the file is written in a single pass.
+		const std::string listing = formatListing(program, title);
+		std::ofstream outFile(fileName, std::ios::binary);
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue opening output file " + fileName + "!");
+		}
+		outFile.write(listing.data(), (std::streamsize)listing.size());
+		outFile.close();
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue writing output file " + fileName + "!");
+		}
+	}
+}
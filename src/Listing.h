@@ -0,0 +1,18 @@
+#include <string>
+#include "Assembler.h"
+
+#ifndef LISTING_H
+#define LISTING_H
+
+// Contains assembler listings, which lay an assembled program out next to its source for reading over by hand (e.g.
+// when hand-optimizing a hot loop): every instruction's address, encoding, decoded fields, jump target and tick
+// cost, followed by every label and constant the program defines.
+namespace Listing {
+	// Return a listing of program (which must have been assembled without problems), headed by title.
+	std::string formatListing(const Assembler::Result &program, const std::string &title);
+	// Write a listing of program (which must have been assembled without problems), headed by title, to the file
+	// fileName in one go. Throws an exception if the file could not be written.
+	void saveListing(const Assembler::Result &program, const std::string &title, const std::string &fileName);
+};
+
+#endif
@@ -0,0 +1,34 @@
+#include "ModuleCache.h"
+#include "Hash.h"
+
+// Return the parsed lines of a module with the given contents, parsing it only if a module with the same contents 
+// hasn't been seen before, and set contentHash to the hash of the contents. The lines' file names are left empty,
+// since the same contents may be included under many different names.
+std::shared_ptr<const std::vector<Assembler::SourceLine> > ModuleCache::getModule(const std::string &contents,
+		std::uint64_t &contentHash) {
+	contentHash = Hash::fnv1a(contents);
+
+	// Check if we've seen this module before.
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::unordered_map<std::uint64_t, CachedModule>::const_iterator cached = this->modules.find(contentHash);
+		if (cached != this->modules.end() && cached->second.contents == contents) {
+			return cached->second.lines;
+		}
+	}
+
+	// If not, parse it outside of the lock so that other threads can carry on in the meantime.
+	std::shared_ptr<std::vector<Assembler::SourceLine> > lines(new std::vector<Assembler::SourceLine>());
+	Assembler::tokenize(contents, *lines);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->modules[contentHash] = {contents, lines};
+	this->parsedModuleCount++;
+	return lines;
+}
+
+// Return the number of modules that had to be parsed, rather than being found in the cache.
+unsigned int ModuleCache::getParsedModuleCount() const {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->parsedModuleCount;
+}
@@ -0,0 +1,43 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+#include "Assembler.h"
+
+#ifndef MODULE_CACHE_H
+#define MODULE_CACHE_H
+
+// Keeps every file pulled in with ;include parsed, keyed by a hash of its contents, so that a library of routines
+// shared by many programs is only parsed once no matter how many programs (or how many versions of a program, in
+// watch mode) include it. A cache can safely be shared by many assemblies running at once on different threads.
+class ModuleCache {
+public:
+	// Return the parsed lines of a module with the given contents, parsing it only if a module with the same 
+	// contents hasn't been seen before, and set contentHash to the hash of the contents. The lines' file names are
+	// left empty, since the same contents may be included under many different names.
+	std::shared_ptr<const std::vector<Assembler::SourceLine> > getModule(const std::string &contents, 
+		std::uint64_t &contentHash);
+
+	// Return the number of modules that had to be parsed, rather than being found in the cache.
+	unsigned int getParsedModuleCount() const;
+
+private:
+	// A module we've already parsed.
+	struct CachedModule {
+		// The module's full contents, to rule out hash collisions.
+		std::string contents;
+		// The module's parsed lines.
+		std::shared_ptr<const std::vector<Assembler::SourceLine> > lines;
+	};
+
+	// Maps content hashes onto the modules with those contents.
+	std::unordered_map<std::uint64_t, CachedModule> modules;
+	// Number of modules that had to be parsed.
+	unsigned int parsedModuleCount = 0;
+	// Guards everything above, since many threads may be using the cache at once.
+	mutable std::mutex mutex;
+};
+
+#endif
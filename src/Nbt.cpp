@@ -0,0 +1,286 @@
+#include <stdexcept>
+#include "Nbt.h"
+
+namespace Nbt {
+	// Write the type and name of a tag, which its contents should follow.
+	void writeTagStart(std::vector<BYTE> &out, BYTE type, const std::string &name) {
+		if (name.size() > 0xffffu) {
+			throw std::runtime_error("NBT tag name " + name + " is too long!");
+		}
+		out.push_back(type);
+		out.push_back((BYTE)(name.size() >> BYTE_SIZE));
+		out.push_back((BYTE)(name.size() & 0xffu));
+		out.insert(out.end(), name.begin(), name.end());
+	}
+
+	// Write the tag that ends the compound currently being written.
+	void writeEnd(std::vector<BYTE> &out) {
+		out.push_back(NBT_END);
+	}
+
+	// Write the contents of a short or int tag (or a length, which is stored the same way).
+	void writeShort(std::vector<BYTE> &out, std::int16_t value) {
+		out.push_back((BYTE)(((std::uint16_t)value >> BYTE_SIZE) & 0xffu));
+		out.push_back((BYTE)((std::uint16_t)value & 0xffu));
+	}
+
+	void writeInt(std::vector<BYTE> &out, std::int32_t value) {
+		for (unsigned int i = 4u; i > 0; i--) {
+			out.push_back((BYTE)(((std::uint32_t)value >> ((i - 1u) * BYTE_SIZE)) & 0xffu));
+		}
+	}
+
+	// Write a whole named short or int tag.
+	void writeShortTag(std::vector<BYTE> &out, const std::string &name, std::int16_t value) {
+		writeTagStart(out, NBT_SHORT, name);
+		writeShort(out, value);
+	}
+
+	void writeIntTag(std::vector<BYTE> &out, const std::string &name, std::int32_t value) {
+		writeTagStart(out, NBT_INT, name);
+		writeInt(out, value);
+	}
+
+	// Write a whole named int array tag.
+	void writeIntArrayTag(std::vector<BYTE> &out, const std::string &name, const std::vector<std::int32_t> &values) {
+		writeTagStart(out, NBT_INT_ARRAY, name);
+		writeInt(out, (std::int32_t)values.size());
+		for (std::int32_t value : values) {
+			writeInt(out, value);
+		}
+	}
+
+	// Write a whole named list tag of elementType with nothing in it.
+	void writeEmptyListTag(std::vector<BYTE> &out, const std::string &name, BYTE elementType) {
+		writeTagStart(out, NBT_LIST, name);
+		out.push_back(elementType);
+		writeInt(out, 0);
+	}
+
+	// Write the start of a byte array tag holding length bytes, which should be written straight after it.
+	void writeByteArrayStart(std::vector<BYTE> &out, const std::string &name, std::int32_t length) {
+		writeTagStart(out, NBT_BYTE_ARRAY, name);
+		writeInt(out, length);
+	}
+
+	// Return the tag named name in this compound tag, or null if there isn't one.
+	Tag *Tag::find(const std::string &name) {
+		for (Tag &child : this->children) {
+			if (child.name == name) {
+				return &child;
+			}
+		}
+		return nullptr;
+	}
+
+	const Tag *Tag::find(const std::string &name) const {
+		for (const Tag &child : this->children) {
+			if (child.name == name) {
+				return &child;
+			}
+		}
+		return nullptr;
+	}
+
+	// Write a big endian number of size bytes.
+	static void writeNumber(std::vector<BYTE> &out, std::uint64_t value, unsigned int size) {
+		for (unsigned int i = size; i > 0; i--) {
+			out.push_back((BYTE)((value >> ((i - 1u) * BYTE_SIZE)) & 0xffu));
+		}
+	}
+
+	// Write the contents of tag (everything but its type and name).
+	static void writePayload(std::vector<BYTE> &out, const Tag &tag) {
+		switch (tag.type) {
+			case NBT_BYTE:
+				writeNumber(out, (std::uint64_t)tag.number, 1u);
+				break;
+			case NBT_SHORT:
+				writeNumber(out, (std::uint64_t)tag.number, 2u);
+				break;
+			case NBT_INT:
+			case NBT_FLOAT:
+				writeNumber(out, (std::uint64_t)tag.number, 4u);
+				break;
+			case NBT_LONG:
+			case NBT_DOUBLE:
+				writeNumber(out, (std::uint64_t)tag.number, 8u);
+				break;
+			case NBT_BYTE_ARRAY:
+				writeInt(out, (std::int32_t)tag.bytes.size());
+				out.insert(out.end(), tag.bytes.begin(), tag.bytes.end());
+				break;
+			case NBT_STRING:
+				if (tag.text.size() > 0xffffu) {
+					throw std::runtime_error("NBT string in tag " + tag.name + " is too long!");
+				}
+				writeNumber(out, tag.text.size(), 2u);
+				out.insert(out.end(), tag.text.begin(), tag.text.end());
+				break;
+			case NBT_LIST:
+				out.push_back(tag.elementType);
+				writeInt(out, (std::int32_t)tag.children.size());
+				for (const Tag &child : tag.children) {
+					writePayload(out, child);
+				}
+				break;
+			case NBT_COMPOUND:
+				for (const Tag &child : tag.children) {
+					writeTag(out, child);
+				}
+				writeEnd(out);
+				break;
+			case NBT_INT_ARRAY:
+				writeInt(out, (std::int32_t)tag.ints.size());
+				for (std::int32_t value : tag.ints) {
+					writeInt(out, value);
+				}
+				break;
+			case NBT_LONG_ARRAY:
+				writeInt(out, (std::int32_t)tag.longs.size());
+				for (std::int64_t value : tag.longs) {
+					writeNumber(out, (std::uint64_t)value, 8u);
+				}
+				break;
+			default:
+				throw std::runtime_error("Invalid NBT tag type " + std::to_string(tag.type) + "!");
+		}
+	}
+
+	// Write a whole tag, with everything in it.
+	void writeTag(std::vector<BYTE> &out, const Tag &tag) {
+		writeTagStart(out, tag.type, tag.name);
+		writePayload(out, tag);
+	}
+
+	// Deepest tags can be nested, the same as Minecraft allows, so that bad data can't run us out of stack.
+	static const unsigned int MAX_DEPTH = 512u;
+
+	// How far through reading NBT data we are.
+	struct Reader {
+		const std::vector<BYTE> &data;
+		std::size_t position;
+	};
+
+	// Read a big endian number of size bytes, moving past it.
+	static std::uint64_t readNumber(Reader &reader, unsigned int size) {
+		if (reader.data.size() - reader.position < size) {
+			throw std::runtime_error("NBT data ends too early!");
+		}
+		std::uint64_t value = 0u;
+		for (unsigned int i = 0; i < size; i++) {
+			value = (value << BYTE_SIZE) | reader.data[reader.position++];
+		}
+		return value;
+	}
+
+	// Read the length of an array or list, moving past it, making sure there's at least room for that many elements
+	// of elementSize bytes left.
+	static std::size_t readLength(Reader &reader, std::size_t elementSize) {
+		std::int32_t length = (std::int32_t)(std::uint32_t)readNumber(reader, 4u);
+		if (length < 0 || (std::size_t)length * elementSize > reader.data.size() - reader.position) {
+			throw std::runtime_error("NBT data ends too early!");
+		}
+		return (std::size_t)length;
+	}
+
+	// Read a string (a 2 byte length and then its bytes), moving past it.
+	static std::string readString(Reader &reader) {
+		std::size_t length = (std::size_t)readNumber(reader, 2u);
+		if (reader.data.size() - reader.position < length) {
+			throw std::runtime_error("NBT data ends too early!");
+		}
+		std::string text(reader.data.begin() + reader.position, reader.data.begin() + reader.position + length);
+		reader.position += length;
+		return text;
+	}
+
+	static void readPayload(Reader &reader, Tag &tag, unsigned int depth);
+
+	// Read a whole tag into tag, moving past it.
+	static void readNamedTag(Reader &reader, Tag &tag, unsigned int depth) {
+		tag.type = (BYTE)readNumber(reader, 1u);
+		if (tag.type != NBT_END) {
+			tag.name = readString(reader);
+			readPayload(reader, tag, depth);
+		}
+	}
+
+	// Read the contents of tag (everything but its type and name, which must already be set), moving past them.
+	static void readPayload(Reader &reader, Tag &tag, unsigned int depth) {
+		if (depth > MAX_DEPTH) {
+			throw std::runtime_error("NBT data is nested too deeply!");
+		}
+		switch (tag.type) {
+			case NBT_BYTE:
+				tag.number = (std::int8_t)readNumber(reader, 1u);
+				break;
+			case NBT_SHORT:
+				tag.number = (std::int16_t)readNumber(reader, 2u);
+				break;
+			case NBT_INT:
+			case NBT_FLOAT:
+				tag.number = (std::int32_t)readNumber(reader, 4u);
+				break;
+			case NBT_LONG:
+			case NBT_DOUBLE:
+				tag.number = (std::int64_t)readNumber(reader, 8u);
+				break;
+			case NBT_BYTE_ARRAY: {
+				std::size_t length = readLength(reader, 1u);
+				tag.bytes.assign(reader.data.begin() + reader.position, reader.data.begin() + reader.position + length);
+				reader.position += length;
+				break;
+			}
+			case NBT_STRING:
+				tag.text = readString(reader);
+				break;
+			case NBT_LIST: {
+				tag.elementType = (BYTE)readNumber(reader, 1u);
+				std::size_t length = readLength(reader, 1u);
+				tag.children.resize(length);
+				for (Tag &child : tag.children) {
+					child.type = tag.elementType;
+					readPayload(reader, child, depth + 1u);
+				}
+				break;
+			}
+			case NBT_COMPOUND:
+				while (true) {
+					Tag child;
+					readNamedTag(reader, child, depth + 1u);
+					if (child.type == NBT_END) {
+						break;
+					}
+					tag.children.push_back(std::move(child));
+				}
+				break;
+			case NBT_INT_ARRAY:
+				tag.ints.resize(readLength(reader, 4u));
+				for (std::int32_t &value : tag.ints) {
+					value = (std::int32_t)(std::uint32_t)readNumber(reader, 4u);
+				}
+				break;
+			case NBT_LONG_ARRAY:
+				tag.longs.resize(readLength(reader, 8u));
+				for (std::int64_t &value : tag.longs) {
+					value = (std::int64_t)readNumber(reader, 8u);
+				}
+				break;
+			default:
+				throw std::runtime_error("Invalid NBT tag type " + std::to_string(tag.type) + "!");
+		}
+	}
+
+	// Read the single named tag (usually a compound) that data is made up of. Throws an exception if data isn't valid
+	// NBT.
+	Tag readTag(const std::vector<BYTE> &data) {
+		Reader reader = {data, 0u};
+		Tag tag;
+		readNamedTag(reader, tag, 0u);
+		if (tag.type == NBT_END) {
+			throw std::runtime_error("NBT data is empty!");
+		}
+		return tag;
+	}
+}
@@ -0,0 +1,73 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Instruction.h"
+
+#ifndef NBT_H
+#define NBT_H
+
+// Tag types used in NBT (Minecraft's Named Binary Tag format), which schematics and worlds are stored in.
+#define NBT_END 0u
+#define NBT_BYTE 1u
+#define NBT_SHORT 2u
+#define NBT_INT 3u
+#define NBT_LONG 4u
+#define NBT_FLOAT 5u
+#define NBT_DOUBLE 6u
+#define NBT_BYTE_ARRAY 7u
+#define NBT_STRING 8u
+#define NBT_LIST 9u
+#define NBT_COMPOUND 10u
+#define NBT_INT_ARRAY 11u
+#define NBT_LONG_ARRAY 12u
+
+// Contains a small writer for NBT data, which appends tags one after the other to the end of a byte buffer as they're
+// written, with every number big endian. Compounds are written by starting a tag of type NBT_COMPOUND, writing
+// everything in it, then ending it with writeEnd(). Whole tags can also be read in as a tree (e.g. to edit a chunk of
+// a world) and written back out exactly as they were.
+namespace Nbt {
+	// A tag read in from NBT data, along with everything in it. Only the fields for its type are used.
+	struct Tag {
+		BYTE type = NBT_END;
+		std::string name;
+		// Value of a byte, short, int or long tag, or the bits of a float or double tag.
+		std::int64_t number = 0;
+		// Value of a string tag.
+		std::string text;
+		// Values of a byte, int or long array tag.
+		std::vector<BYTE> bytes;
+		std::vector<std::int32_t> ints;
+		std::vector<std::int64_t> longs;
+		// Type of the tags in a list tag, and the tags in a list or compound tag, in order.
+		BYTE elementType = NBT_END;
+		std::vector<Tag> children;
+
+		// Return the tag named name in this compound tag, or null if there isn't one.
+		Tag *find(const std::string &name);
+		const Tag *find(const std::string &name) const;
+	};
+
+	// Write the type and name of a tag, which its contents should follow.
+	void writeTagStart(std::vector<BYTE> &out, BYTE type, const std::string &name);
+	// Write the tag that ends the compound currently being written.
+	void writeEnd(std::vector<BYTE> &out);
+	// Write the contents of a short or int tag (or a length, which is stored the same way).
+	void writeShort(std::vector<BYTE> &out, std::int16_t value);
+	void writeInt(std::vector<BYTE> &out, std::int32_t value);
+	// Write a whole named short or int tag.
+	void writeShortTag(std::vector<BYTE> &out, const std::string &name, std::int16_t value);
+	void writeIntTag(std::vector<BYTE> &out, const std::string &name, std::int32_t value);
+	// Write a whole named int array tag.
+	void writeIntArrayTag(std::vector<BYTE> &out, const std::string &name, const std::vector<std::int32_t> &values);
+	// Write a whole named list tag of elementType with nothing in it.
+	void writeEmptyListTag(std::vector<BYTE> &out, const std::string &name, BYTE elementType);
+	// Write the start of a byte array tag holding length bytes, which should be written straight after it.
+	void writeByteArrayStart(std::vector<BYTE> &out, const std::string &name, std::int32_t length);
+	// Write a whole tag, with everything in it.
+	void writeTag(std::vector<BYTE> &out, const Tag &tag);
+	// Read the single named tag (usually a compound) that data is made up of. Throws an exception if data isn't valid
+	// NBT.
+	Tag readTag(const std::vector<BYTE> &data);
+};
+
+#endif
@@ -0,0 +1,517 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include "OutputFiles.h"
+#include "BinaryFile.h"
+#include "IMemSchematic.h"
+#include "ThreadPool.h"
+
+namespace OutputFiles {
+	// Write machine code to a shroom16 binary file for use with the virtual machine, with nothing else in it (see
+	// BinaryFile for binaries that also hold data, labels and source locations). Throws an exception if the file could
+	// not be opened or written.
+	void saveBinary(const std::vector<Instruction> &machineCode, const std::string &outFileName) {
+		BinaryFile::Binary binary;
+		binary.machineCode = machineCode;
+		BinaryFile::saveBinary(binary, outFileName);
+	}
+
+	// Read machine code back in from a shroom16 binary file of any version. Throws an exception if the file could not
+	// be opened or isn't a shroom16 binary file.
+	std::vector<Instruction> loadBinary(const std::string &inFileName) {
+		return BinaryFile::loadBinary(inFileName).machineCode;
+	}
+
+	// How many bytes of the schematic are compressed together as one piece, and how many bytes of the piece before it
+	// each piece is primed with (the most deflate can look back), so that pieces compressed at the same time still
+	// compress nearly as well as one long stream. Pieces are always the same size, whatever the number of threads, so
+	// the output doesn't depend on how many there are.
+	static const std::size_t PIECE_SIZE = 1u << 15;
+	static const std::size_t DICTIONARY_SIZE = 1u << 15;
+	// Operating system recorded in the gzip header, which is "unknown" so that output is the same everywhere.
+	static const BYTE GZIP_UNKNOWN_OS = 255u;
+
+	// Copy size bytes of the uncompressed schematic made of parts (the header, body and footer one after the other),
+	// from start on, into destination. bitBlocks gives the block to patch into the body for every bit of instruction
+	// memory, sorted by where in the body it goes.
+	static void copySchematicBytes(const IMemSchematic::Parts &parts,
+		const std::vector<std::pair<std::size_t, BYTE> > &bitBlocks, std::size_t start, std::size_t size,
+		BYTE *destination) {
+		const std::size_t bodyStart = parts.header.size();
+		const std::size_t footerStart = bodyStart + parts.body.size();
+		const std::size_t end = start + size;
+		// Copy whatever overlaps the range from each part, along with where that part starts.
+		const std::pair<const std::vector<BYTE>*, std::size_t> partStarts[] = {
+			std::make_pair(&parts.header, (std::size_t)0u), std::make_pair(&parts.body, bodyStart),
+			std::make_pair(&parts.footer, footerStart)
+		};
+		for (const std::pair<const std::vector<BYTE>*, std::size_t> &part : partStarts) {
+			std::size_t from = std::max(start, part.second);
+			std::size_t to = std::min(end, part.second + part.first->size());
+			if (from < to) {
+				std::copy(part.first->begin() + (from - part.second), part.first->begin() + (to - part.second),
+					destination + (from - start));
+			}
+		}
+
+		// Then patch in every block for a bit that falls within the range.
+		std::vector<std::pair<std::size_t, BYTE> >::const_iterator bitBlock = std::lower_bound(bitBlocks.begin(),
+			bitBlocks.end(), std::make_pair(start > bodyStart ? start - bodyStart : 0u, (BYTE)0u));
+		for (; bitBlock != bitBlocks.end() && bodyStart + bitBlock->first < end; bitBlock++) {
+			destination[bodyStart + bitBlock->first - start] = bitBlock->second;
+		}
+	}
+
+	// Compress size bytes of the uncompressed schematic from start on (see copySchematicBytes()) as a raw deflate
+	// stream, primed with whatever comes before it, overwriting compressed with the result and setting checksum to the
+	// CRC-32 of the uncompressed bytes. The last piece finishes the deflate stream off, and every other piece ends
+	// on a byte boundary so that the pieces can simply be put one after the other. Throws an exception if anything
+	// goes wrong.
+	static void compressPiece(const IMemSchematic::Parts &parts,
+		const std::vector<std::pair<std::size_t, BYTE> > &bitBlocks, std::size_t start, std::size_t size, bool isLast,
+		int compressionLevel, std::vector<BYTE> &compressed, uLong &checksum) {
+		const std::size_t dictionarySize = std::min(start, DICTIONARY_SIZE);
+		std::vector<BYTE> input(dictionarySize + size);
+		copySchematicBytes(parts, bitBlocks, start - dictionarySize, input.size(), input.data());
+		checksum = crc32(0u, input.data() + dictionarySize, (uInt)size);
+
+		// A negative window size asks zlib for raw deflate, without a header of its own.
+		z_stream stream = {};
+		if (deflateInit2(&stream, compressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			throw std::runtime_error("Issue setting up schematic compression!");
+		}
+		try {
+			if (dictionarySize > 0 && deflateSetDictionary(&stream, input.data(), (uInt)dictionarySize) != Z_OK) {
+				throw std::runtime_error("Issue setting up schematic compression!");
+			}
+			// Flushing can add a few bytes past the bound, so the buffer grows as needed.
+			compressed.resize(deflateBound(&stream, (uLong)size) + 16u);
+			stream.next_in = input.data() + dictionarySize;
+			stream.avail_in = (uInt)size;
+			std::size_t used = 0;
+			int status = Z_OK;
+			do {
+				if (used == compressed.size()) {
+					compressed.resize(compressed.size() * 2u);
+				}
+				stream.next_out = compressed.data() + used;
+				stream.avail_out = (uInt)(compressed.size() - used);
+				status = deflate(&stream, isLast ? Z_FINISH : Z_SYNC_FLUSH);
+				if (status == Z_STREAM_ERROR) {
+					throw std::runtime_error("Issue compressing schematic data!");
+				}
+				used = compressed.size() - stream.avail_out;
+			} while (stream.avail_out == 0);
+			if (isLast && status != Z_STREAM_END) {
+				throw std::runtime_error("Issue finishing compressed schematic data!");
+			}
+			compressed.resize(used);
+		}
+		catch (std::exception &e) {
+			deflateEnd(&stream);
+			throw;
+		}
+		deflateEnd(&stream);
+	}
+
+	// Write value to outStream as 4 little endian bytes, as used by the gzip trailer.
+	static void writeLittleEndian(std::ostream &outStream, std::uint32_t value) {
+		for (unsigned int i = 0; i < 4u; i++) {
+			outStream.put((char)((value >> (i * BYTE_SIZE)) & 0xffu));
+		}
+	}
+
+	// Throw an exception if compressionLevel isn't a zlib compression level (0 to 9, or Z_DEFAULT_COMPRESSION).
+	static void checkCompressionLevel(int compressionLevel) {
+		if (compressionLevel != Z_DEFAULT_COMPRESSION && (compressionLevel < 0 || compressionLevel > 9)) {
+			throw std::runtime_error("Compression level must be between 0 and 9!");
+		}
+	}
+
+	// Write machine code to a gzipped .schem file to be pasted into in-game instruction memory with geometry,
+	// compressed with the given zlib compression level (0 to 9, or Z_DEFAULT_COMPRESSION) on threadCount threads.
+	// Throws an exception if the file could not be opened or written, if the compression level or geometry isn't
+	// valid, or if the machine code doesn't fit in the instruction memory, in which case any file that was already
+	// there is left as it was.
+	void saveSchematicFile(const std::vector<Instruction> &machineCode, const std::string &outFileName,
+		int compressionLevel, unsigned int threadCount, const IMemSchematic::Geometry &geometry) {
+		// Check everything we can up front, then write to a temporary file that's only moved into place once it's
+		// complete, so that nothing goes wrong after a good schematic has been thrown away.
+		checkCompressionLevel(compressionLevel);
+		IMemSchematic::checkGeometry(geometry);
+		IMemSchematic::checkFits(machineCode, geometry);
+		const std::string temporaryFileName = outFileName + ".tmp";
+		std::ofstream outFile(temporaryFileName, std::ios::binary);
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue opening output file " + outFileName + "!");
+		}
+
+		try {
+			saveSchematic(machineCode, outFile, compressionLevel, threadCount, geometry);
+		}
+		catch (...) {
+			outFile.close();
+			std::remove(temporaryFileName.c_str());
+			throw;
+		}
+
+		outFile.close();
+		if (!outFile.good()) {
+			std::remove(temporaryFileName.c_str());
+			throw std::runtime_error("Issue writing output file " + outFileName + "!");
+		}
+#ifdef _WIN32
+		// Windows refuses to rename over an existing file.
+		std::remove(outFileName.c_str());
+#endif
+		if (std::rename(temporaryFileName.c_str(), outFileName.c_str()) != 0) {
+			std::remove(temporaryFileName.c_str());
+			throw std::runtime_error("Issue writing output file " + outFileName + "!");
+		}
+	}
+
+	// Write machine code as a gzipped schematic of instruction memory with geometry to outStream, compressed with the
+	// given zlib compression level (0 to 9, or Z_DEFAULT_COMPRESSION). Unused instruction slots are filled with zeros.
+	// The schematic is split into pieces that are compressed at the same time on threadCount threads (with the
+	// torches in each piece patched in as it's compressed, so the body is never copied whole), then put back together
+	// into a single gzip stream, the same way pigz does. Throws an exception if the compression level or geometry
+	// isn't valid, if the machine code doesn't fit in the instruction memory, or if the data could not be compressed
+	// or written.
+	void saveSchematic(const std::vector<Instruction> &machineCode, std::ostream &outStream, int compressionLevel,
+		unsigned int threadCount, const IMemSchematic::Geometry &geometry) {
+		checkCompressionLevel(compressionLevel);
+		IMemSchematic::checkGeometry(geometry);
+		IMemSchematic::checkFits(machineCode, geometry);
+
+		// Work out the block to place for every bit of instruction memory, in the order they appear in the body: a
+		// torch if the bit is one, or air if it's zero. Unused instruction slots are all zeros.
+		std::vector<std::pair<std::size_t, BYTE> > bitBlocks;
+		bitBlocks.reserve(geometry.getInstructionCount() * geometry.wordSize);
+		for (unsigned int i = 0; i < geometry.getInstructionCount(); i++) {
+			for (unsigned int b = 0; b < geometry.wordSize; b++) {
+				bool isOne = i < machineCode.size() && machineCode[i].getBitState(b);
+				bitBlocks.push_back(std::make_pair(geometry.getTorchIndex(i, b),
+					(BYTE)(isOne ? REDSTONE_TORCH_OFF : AIR)));
+			}
+		}
+		std::sort(bitBlocks.begin(), bitBlocks.end());
+
+		// Compress every piece, as many at once as we have threads for.
+		const std::shared_ptr<const IMemSchematic::Parts> parts = IMemSchematic::getParts(geometry);
+		const std::size_t totalSize = parts->header.size() + parts->body.size() + parts->footer.size();
+		const unsigned int pieceCount = (unsigned int)((totalSize + PIECE_SIZE - 1u) / PIECE_SIZE);
+		std::vector<std::vector<BYTE> > pieces(pieceCount);
+		std::vector<uLong> checksums(pieceCount);
+		ThreadPool::parallelFor(pieceCount, threadCount, [&](unsigned int p) {
+			std::size_t start = p * PIECE_SIZE;
+			compressPiece(*parts, bitBlocks, start, std::min(PIECE_SIZE, totalSize - start), p + 1u == pieceCount,
+				compressionLevel, pieces[p], checksums[p]);
+		});
+
+		// Then put them together into a single gzip file: a header (with no name or time, and the extra flags zlib
+		// would set for this compression level), the pieces in order, and the checksum and size of the whole thing.
+		const BYTE extraFlags = compressionLevel == 9 ? 2u : (compressionLevel == 0 || compressionLevel == 1 ? 4u : 0u);
+		const BYTE gzipHeader[] = {0x1fu, 0x8bu, Z_DEFLATED, 0u, 0u, 0u, 0u, 0u, extraFlags, GZIP_UNKNOWN_OS};
+		outStream.write((const char*)gzipHeader, sizeof(gzipHeader));
+		uLong checksum = crc32(0u, Z_NULL, 0u);
+		for (unsigned int p = 0; p < pieceCount; p++) {
+			outStream.write((const char*)pieces[p].data(), (std::streamsize)pieces[p].size());
+			checksum = crc32_combine(checksum, checksums[p], (z_off_t)std::min(PIECE_SIZE, totalSize - p * PIECE_SIZE));
+		}
+		writeLittleEndian(outStream, (std::uint32_t)checksum);
+		writeLittleEndian(outStream, (std::uint32_t)totalSize);
+		if (!outStream.good()) {
+			throw std::runtime_error("Issue writing compressed schematic data!");
+		}
+	}
+
+	// How many bytes of a schematic are read in, and inflated, at a time when loading it back in.
+	static const std::size_t LOAD_BUFFER_SIZE = 1u << 16;
+
+	// Read machine code back in from a gzipped schematic of instruction memory with geometry, as written by
+	// saveSchematic(). The schematic is inflated a piece at a time and checked against the one generated for geometry
+	// as it goes, so every block besides the torches for the bits of instruction memory (each either a torch for a one
+	// or air for a zero) must be exactly as generated. Unused instruction slots at the end, which are all zeros, are
+	// left out. Throws an exception if the geometry isn't valid, or if the data isn't a schematic of instruction
+	// memory with geometry or could not be read.
+	std::vector<Instruction> loadSchematic(std::istream &inStream, const IMemSchematic::Geometry &geometry) {
+		IMemSchematic::checkGeometry(geometry);
+		const std::shared_ptr<const IMemSchematic::Parts> parts = IMemSchematic::getParts(geometry);
+		const std::size_t bodyStart = parts->header.size();
+		const std::size_t footerStart = bodyStart + parts->body.size();
+		const std::size_t totalSize = footerStart + parts->footer.size();
+
+		// Every bit of instruction memory (numbered across instructions, then along them), in the order their torches
+		// appear in the body.
+		std::vector<std::pair<std::size_t, unsigned int> > bitTorches;
+		bitTorches.reserve(geometry.getInstructionCount() * geometry.wordSize);
+		for (unsigned int i = 0; i < geometry.getInstructionCount(); i++) {
+			for (unsigned int b = 0; b < geometry.wordSize; b++) {
+				bitTorches.push_back(std::make_pair(geometry.getTorchIndex(i, b), i * geometry.wordSize + b));
+			}
+		}
+		std::sort(bitTorches.begin(), bitTorches.end());
+		std::vector<std::pair<std::size_t, unsigned int> >::const_iterator nextTorch = bitTorches.begin();
+
+		// Adding 16 to the window size asks zlib for a gzip stream.
+		z_stream stream = {};
+		if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+			throw std::runtime_error("Issue setting up schematic decompression!");
+		}
+		std::vector<Instruction> machineCode(geometry.getInstructionCount());
+		try {
+			std::vector<char> compressed(LOAD_BUFFER_SIZE);
+			std::vector<BYTE> inflated(LOAD_BUFFER_SIZE);
+			std::size_t position = 0;
+			int status = Z_OK;
+			while (status != Z_STREAM_END) {
+				if (stream.avail_in == 0) {
+					inStream.read(compressed.data(), (std::streamsize)compressed.size());
+					if (inStream.gcount() == 0) {
+						throw std::runtime_error("Schematic data ends too early!");
+					}
+					stream.next_in = (Bytef*)compressed.data();
+					stream.avail_in = (uInt)inStream.gcount();
+				}
+				stream.next_out = inflated.data();
+				stream.avail_out = (uInt)inflated.size();
+				status = inflate(&stream, Z_NO_FLUSH);
+				if (status != Z_OK && status != Z_STREAM_END) {
+					throw std::runtime_error("Schematic data isn't gzipped!");
+				}
+
+				// Check every byte that came out against the generated schematic, picking out the bits as we go.
+				const std::size_t inflatedSize = inflated.size() - stream.avail_out;
+				if (inflatedSize > totalSize - position) {
+					throw std::runtime_error("Schematic is too large to be of instruction memory " +
+						geometry.describe() + "!");
+				}
+				for (std::size_t k = 0; k < inflatedSize; k++, position++) {
+					const BYTE block = inflated[k];
+					if (position < bodyStart || position >= footerStart) {
+						if (block != (position < bodyStart ? parts->header[position] :
+							parts->footer[position - footerStart])) {
+							throw std::runtime_error("Schematic isn't of instruction memory " + geometry.describe() +
+								"!");
+						}
+						continue;
+					}
+
+					const std::size_t index = position - bodyStart;
+					if (nextTorch != bitTorches.end() && nextTorch->first == index) {
+						if (block != REDSTONE_TORCH_OFF && block != AIR) {
+							throw std::runtime_error("Torch for bit " + std::to_string(nextTorch->second %
+								geometry.wordSize) + " of instruction " + std::to_string(nextTorch->second /
+								geometry.wordSize) + " in schematic is neither a torch nor air!");
+						}
+						machineCode[nextTorch->second / geometry.wordSize].setBitState(nextTorch->second %
+							geometry.wordSize, block == REDSTONE_TORCH_OFF);
+						nextTorch++;
+					}
+					else if (block != parts->body[index]) {
+						const unsigned int width = geometry.getWidth();
+						const unsigned int length = geometry.getLength();
+						throw std::runtime_error("Block at (" + std::to_string(index % width) + ", " +
+							std::to_string(index / width / length) + ", " + std::to_string(index / width % length) +
+							") of schematic doesn't match instruction memory " + geometry.describe() + "!");
+					}
+				}
+			}
+			if (position != totalSize) {
+				throw std::runtime_error("Schematic is too small to be of instruction memory " + geometry.describe() +
+					"!");
+			}
+		}
+		catch (std::exception &e) {
+			inflateEnd(&stream);
+			throw;
+		}
+		inflateEnd(&stream);
+
+		while (!machineCode.empty() && machineCode.back().getBitsInRange(0u, INSTRUCTION_SIZE - 1u) == 0u) {
+			machineCode.pop_back();
+		}
+		return machineCode;
+	}
+
+	// Read machine code back in from a .schem file of instruction memory with geometry, as written by
+	// saveSchematicFile() (see loadSchematic()). Throws an exception if the file could not be opened or read, if the
+	// geometry isn't valid, or if the file isn't a schematic of instruction memory with geometry.
+	std::vector<Instruction> loadSchematicFile(const std::string &inFileName, const IMemSchematic::Geometry &geometry) {
+		std::ifstream inFile(inFileName, std::ios::binary);
+		if (!inFile.good()) {
+			throw std::runtime_error("Issue opening input file " + inFileName + "!");
+		}
+		return loadSchematic(inFile, geometry);
+	}
+
+	// Read a program's initial data memory back in from a .shroomdata file of 16 bit little endian words, which
+	// binaries from before data was stored in them had next to them. Throws an exception if the file could not be
+	// opened, isn't a whole number of words long, or holds more words than data memory does.
+	std::vector<std::uint16_t> loadDataImage(const std::string &inFileName) {
+		std::ifstream inFile(inFileName, std::ios::binary);
+		if (!inFile.good()) {
+			throw std::runtime_error("Issue opening input file " + inFileName + "!");
+		}
+		std::vector<char> bytes((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+		if (bytes.size() % (WORD_SIZE / BYTE_SIZE) != 0 || bytes.size() / (WORD_SIZE / BYTE_SIZE) > DATA_MEMORY_SIZE) {
+			throw std::runtime_error("Input file " + inFileName + " isn't a shroom16 data image!");
+		}
+
+		std::vector<std::uint16_t> dataImage(bytes.size() / (WORD_SIZE / BYTE_SIZE));
+		for (unsigned int i = 0; i < dataImage.size(); i++) {
+			dataImage[i] = (std::uint16_t)((BYTE)bytes[2u * i] | ((BYTE)bytes[2u * i + 1u] << BYTE_SIZE));
+		}
+		return dataImage;
+	}
+
+	// Return the shape of the torch ROM data memory schematics are written for: every word of data memory, spaced
+	// out the same as instruction memory.
+	static IMemSchematic::Geometry getDataGeometry() {
+		IMemSchematic::Geometry geometry;
+		geometry.layerCount = DATA_NUMBER_OF_LAYERS;
+		geometry.instructionsPerLayer = DATA_WORDS_PER_LAYER;
+		geometry.wordSize = WORD_SIZE;
+		return geometry;
+	}
+
+	// Write a program's initial data memory to a gzipped .schem file of a torch ROM holding every word of data memory
+	// (DATA_NUMBER_OF_LAYERS layers of DATA_WORDS_PER_LAYER words). This is only a preview layout, built the same way
+	// as instruction memory: no in-game data memory reads from it yet, so it may change once one does. Compressed the
+	// same way as saveSchematicFile(). Throws an exception if the file could not be opened or written, if the
+	// compression level isn't valid, or if there's more data than data memory holds.
+	void saveDataSchematicFile(const std::vector<std::uint16_t> &dataImage, const std::string &outFileName,
+		int compressionLevel, unsigned int threadCount) {
+		std::vector<Instruction> words(dataImage.size());
+		for (unsigned int i = 0; i < dataImage.size(); i++) {
+			words[i].setBitsInRange(0u, WORD_SIZE - 1u, dataImage[i]);
+		}
+		saveSchematicFile(words, outFileName, compressionLevel, threadCount, getDataGeometry());
+	}
+
+	// Read a program's initial data memory back in from a .schem file written by saveDataSchematicFile() (see
+	// loadSchematic()). Unused words at the end, which are all zeros, are left out. Throws an exception if the file
+	// could not be opened or read, or isn't a schematic of data memory.
+	std::vector<std::uint16_t> loadDataSchematicFile(const std::string &inFileName) {
+		std::vector<Instruction> words = loadSchematicFile(inFileName, getDataGeometry());
+		std::vector<std::uint16_t> dataImage(words.size());
+		for (unsigned int i = 0; i < words.size(); i++) {
+			dataImage[i] = (std::uint16_t)words[i].getBitsInRange(0u, WORD_SIZE - 1u);
+		}
+		return dataImage;
+	}
+
+	// Return the position of the block at (x, y, z) of instruction memory with geometry for a command, relative to the
+	// far corner of the instruction memory, which is where the player stands to paste its schematic with WorldEdit.
+	static std::string formatPosition(const IMemSchematic::Geometry &geometry, unsigned int x, unsigned int y,
+		unsigned int z) {
+		return "~" + std::to_string((int)x - (int)(geometry.getWidth() - 1u)) + " ~" +
+			std::to_string((int)y - (int)(geometry.getHeight() - 1u)) + " ~" +
+			std::to_string((int)z - (int)(geometry.getLength() - 1u));
+	}
+
+	// Write commands to commands that place the torch or air for every bit of instruction memory with geometry that
+	// should hold machineCode, skipping any bit that already holds the same in deployedCode if it isn't null. Unused
+	// instruction slots are filled with zeros. Runs of neighbouring bits that all become zeros are cleared with a
+	// single fill, since the blocks between their torches are air already. Return how many bits are placed, and set
+	// commandCount to how many commands that takes.
+	static unsigned int writeBitCommands(std::ostream &commands, const IMemSchematic::Geometry &geometry,
+		const std::vector<Instruction> *deployedCode, const std::vector<Instruction> &machineCode,
+		unsigned int &commandCount) {
+		const std::string torchBlock = IMemSchematic::getBlockName(REDSTONE_TORCH_OFF);
+		const std::string airBlock = IMemSchematic::getBlockName(AIR);
+		// Return true iff bit b of instruction i needs placing, setting isOne to what it should be.
+		auto needsPlacing = [&](unsigned int i, unsigned int b, bool &isOne) {
+			isOne = i < machineCode.size() && machineCode[i].getBitState(b);
+			return deployedCode == nullptr ||
+				isOne != (i < deployedCode->size() && (*deployedCode)[i].getBitState(b));
+		};
+
+		unsigned int bitCount = 0;
+		commandCount = 0;
+		for (unsigned int i = 0; i < geometry.getInstructionCount(); i++) {
+			const unsigned int y = geometry.getTorchY(i);
+			const unsigned int z = geometry.getTorchZ(i);
+			for (unsigned int b = 0; b < geometry.wordSize; b++) {
+				bool isOne = false;
+				if (!needsPlacing(i, b, isOne)) {
+					continue;
+				}
+				// Carry a run of zeros on for as long as the next bits need clearing too.
+				unsigned int last = b;
+				bool isNextOne = false;
+				while (!isOne && last + 1u < geometry.wordSize && needsPlacing(i, last + 1u, isNextOne) &&
+					!isNextOne) {
+					last++;
+				}
+				if (last == b) {
+					commands << "setblock " << formatPosition(geometry, geometry.getTorchX(b), y, z) << " " <<
+						(isOne ? torchBlock : airBlock) << "\n";
+				}
+				else {
+					commands << "fill " << formatPosition(geometry, geometry.getTorchX(b), y, z) << " " <<
+						formatPosition(geometry, geometry.getTorchX(last), y, z) << " " << airBlock << "\n";
+				}
+				bitCount += last - b + 1u;
+				commandCount++;
+				b = last;
+			}
+		}
+		return bitCount;
+	}
+
+	// Write a .mcfunction file starting with the comment description and followed by commands. Throws an exception if
+	// the file could not be opened or written.
+	static void saveCommandFile(const std::string &outFileName, const std::string &description,
+		const std::string &commands) {
+		std::ofstream outFile(outFileName, std::ios::binary);
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue opening output file " + outFileName + "!");
+		}
+		outFile << "# " << description << "\n" << commands;
+		outFile.close();
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue writing output file " + outFileName + "!");
+		}
+	}
+
+	// Write machine code to a .mcfunction file of setblock and fill commands that place every bit of instruction
+	// memory with geometry, for servers without WorldEdit. The rest of the instruction memory must already be built
+	// (e.g. from a schematic pasted in once). Unused instruction slots are filled with zeros, and positions are
+	// relative to where the player stands to paste the schematic. Throws an exception if the file could not be
+	// opened or written, if the geometry isn't valid, or if the machine code doesn't fit in the instruction memory.
+	void saveFunctionFile(const std::vector<Instruction> &machineCode, const std::string &outFileName,
+		const IMemSchematic::Geometry &geometry) {
+		IMemSchematic::checkGeometry(geometry);
+		IMemSchematic::checkFits(machineCode, geometry);
+		std::ostringstream commands;
+		unsigned int commandCount = 0;
+		writeBitCommands(commands, geometry, nullptr, machineCode, commandCount);
+		saveCommandFile(outFileName, "Places the program in instruction memory " + geometry.describe() + " with " +
+			std::to_string(commandCount) + " commands. Run from where the schematic is pasted.", commands.str());
+	}
+
+	// Write a .mcfunction file of setblock and fill commands that turns instruction memory with geometry holding
+	// deployedCode into instruction memory holding machineCode, touching only the torches that differ, and return
+	// how many there are. Positions are relative to where the player stands to paste the whole schematic. Throws an
+	// exception if the file could not be opened or written, if the geometry isn't valid, or if either program
+	// doesn't fit in the instruction memory.
+	unsigned int saveSchematicPatch(const std::vector<Instruction> &deployedCode,
+		const std::vector<Instruction> &machineCode, const std::string &outFileName,
+		const IMemSchematic::Geometry &geometry) {
+		IMemSchematic::checkGeometry(geometry);
+		IMemSchematic::checkFits(deployedCode, geometry);
+		IMemSchematic::checkFits(machineCode, geometry);
+		std::ostringstream commands;
+		unsigned int commandCount = 0;
+		unsigned int changeCount = writeBitCommands(commands, geometry, &deployedCode, machineCode, commandCount);
+		saveCommandFile(outFileName, "Updates instruction memory " + geometry.describe() + " to the new program, "
+			"changing " + std::to_string(changeCount) + " torches. Run from where the schematic is pasted.",
+			commands.str());
+		return changeCount;
+	}
+}
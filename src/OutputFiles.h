@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "Instruction.h"
+#include "IMemSchematic.h"
+#include "zlib.h"
+
+#ifndef OUTPUT_FILES_H
+#define OUTPUT_FILES_H
+
+// Writes assembled machine code out to the files the rest of the Shroom16 toolchain uses: shroom16 binaries for the
+// virtual machine (see BinaryFile), images of initial data memory, and schematics and command files to place programs
+// into in-game instruction memory with. Shared by the assembler and the linker. Binaries and schematics can also be
+// read back in (e.g. to run or disassemble what's deployed in-game).
+namespace OutputFiles {
+	// Write machine code to a shroom16 binary file for use with the virtual machine, with nothing else in it (see
+	// BinaryFile for binaries that also hold data, labels and source locations). Throws an exception if the file could
+	// not be opened or written.
+	void saveBinary(const std::vector<Instruction> &machineCode, const std::string &outFileName);
+	// Read machine code back in from a shroom16 binary file of any version. Throws an exception if the file could not
+	// be opened or isn't a shroom16 binary file.
+	std::vector<Instruction> loadBinary(const std::string &inFileName);
+	// Write machine code to a gzipped .schem file to be pasted into in-game instruction memory with geometry,
+	// compressed with the given zlib compression level (0 to 9, or Z_DEFAULT_COMPRESSION) on threadCount threads.
+	// Throws an exception if the file could not be opened or written, if the compression level or geometry isn't
+	// valid, or if the machine code doesn't fit in the instruction memory, in which case any file that was already
+	// there is left as it was.
+	void saveSchematicFile(const std::vector<Instruction> &machineCode, const std::string &outFileName,
+		int compressionLevel = Z_DEFAULT_COMPRESSION, unsigned int threadCount = 1u,
+		const IMemSchematic::Geometry &geometry = IMemSchematic::Geometry());
+	// Write machine code as a gzipped schematic of instruction memory with geometry to outStream, compressed with the
+	// given zlib compression level (0 to 9, or Z_DEFAULT_COMPRESSION). Unused instruction slots are filled with zeros.
+	// The schematic is split into pieces that are compressed at the same time on threadCount threads (with the
+	// torches in each piece patched in as it's compressed, so the body is never copied whole), then put back together
+	// into a single gzip stream, the same way pigz does. Throws an exception if the compression level or geometry
+	// isn't valid, if the machine code doesn't fit in the instruction memory, or if the data could not be compressed
+	// or written.
+	void saveSchematic(const std::vector<Instruction> &machineCode, std::ostream &outStream, int compressionLevel,
+		unsigned int threadCount, const IMemSchematic::Geometry &geometry = IMemSchematic::Geometry());
+	// Read machine code back in from a gzipped schematic of instruction memory with geometry, as written by
+	// saveSchematic(). The schematic is inflated a piece at a time and checked against the one generated for geometry
+	// as it goes, so every block besides the torches for the bits of instruction memory (each either a torch for a one
+	// or air for a zero) must be exactly as generated. Unused instruction slots at the end, which are all zeros, are
+	// left out. Throws an exception if the geometry isn't valid, or if the data isn't a schematic of instruction
+	// memory with geometry or could not be read.
+	std::vector<Instruction> loadSchematic(std::istream &inStream,
+		const IMemSchematic::Geometry &geometry = IMemSchematic::Geometry());
+	// Read machine code back in from a .schem file of instruction memory with geometry, as written by
+	// saveSchematicFile() (see loadSchematic()). Throws an exception if the file could not be opened or read, if the
+	// geometry isn't valid, or if the file isn't a schematic of instruction memory with geometry.
+	std::vector<Instruction> loadSchematicFile(const std::string &inFileName,
+		const IMemSchematic::Geometry &geometry = IMemSchematic::Geometry());
+	// Read a program's initial data memory back in from a .shroomdata file of 16 bit little endian words, which
+	// binaries from before data was stored in them had next to them. Throws an exception if the file could not be
+	// opened, isn't a whole number of words long, or holds more words than data memory does.
+	std::vector<std::uint16_t> loadDataImage(const std::string &inFileName);
+	// Write a program's initial data memory to a gzipped .schem file of a torch ROM holding every word of data memory
+	// (DATA_NUMBER_OF_LAYERS layers of DATA_WORDS_PER_LAYER words). This is only a preview layout, built the same way
+	// as instruction memory: no in-game data memory reads from it yet, so it may change once one does. Compressed the
+	// same way as saveSchematicFile(). Throws an exception if the file could not be opened or written, if the
+	// compression level isn't valid, or if there's more data than data memory holds.
+	void saveDataSchematicFile(const std::vector<std::uint16_t> &dataImage, const std::string &outFileName,
+		int compressionLevel = Z_DEFAULT_COMPRESSION, unsigned int threadCount = 1u);
+	// Read a program's initial data memory back in from a .schem file written by saveDataSchematicFile() (see
+	// loadSchematic()). Unused words at the end, which are all zeros, are left out. Throws an exception if the file
+	// could not be opened or read, or isn't a schematic of data memory.
+	std::vector<std::uint16_t> loadDataSchematicFile(const std::string &inFileName);
+	// Write machine code to a .mcfunction file of setblock and fill commands that place every bit of instruction
+	// memory with geometry, for servers without WorldEdit. The rest of the instruction memory must already be built
+	// (e.g. from a schematic pasted in once). Unused instruction slots are filled with zeros, and positions are
+	// relative to where the player stands to paste the schematic. Throws an exception if the file could not be
+	// opened or written, if the geometry isn't valid, or if the machine code doesn't fit in the instruction memory.
+	void saveFunctionFile(const std::vector<Instruction> &machineCode, const std::string &outFileName,
+		const IMemSchematic::Geometry &geometry = IMemSchematic::Geometry());
+	// Write a .mcfunction file of setblock and fill commands that turns instruction memory with geometry holding
+	// deployedCode into instruction memory holding machineCode, touching only the torches that differ, and return
+	// how many there are. Positions are relative to where the player stands to paste the whole schematic. Throws an
+	// exception if the file could not be opened or written, if the geometry isn't valid, or if either program
+	// doesn't fit in the instruction memory.
+	unsigned int saveSchematicPatch(const std::vector<Instruction> &deployedCode,
+		const std::vector<Instruction> &machineCode, const std::string &outFileName,
+		const IMemSchematic::Geometry &geometry = IMemSchematic::Geometry());
+};
+
+#endif
@@ -59,8 +59,17 @@ namespace Parser {
 		}
 	}
 
+	// Return true iff character c can be part of a constant expression (see ConstantExpression), other than letters,
+	// numbers and -.
+	bool isExpressionOperator(char c) {
+		return c == '+' || c == '*' || c == '/' || c == '%' || c == '(' || c == ')' || c == '<' || c == '>' ||
+			c == '&' || c == '|' || c == '^' || c == '~';
+	}
+
 	// Take an instruction in line string and break down into compoents separated by spaces. Ignore all characters 
-	// that are not letters, numbers, $, ?, #, :, or ;. Completely overwrites parsedLine.
+	// that are not letters, numbers, $, ?, #, :, ;, or expression operators, except within double quoted strings,
+	// which are kept whole (quotes and all) as a single component. Spaces inside parentheses don't separate
+	// components, so that expressions can be spaced out. Completely overwrites parsedLine.
 	// For example, turns "add $g,0 $g1 $g2" into parsedLine = {"add", "$g0", "$g1", "$g2"}.
 	void parseLine(const std::string &line, std::vector<std::string> &parsedLine) {
 		// Clear out parsedLine.
@@ -68,18 +77,41 @@ namespace Parser {
 
 		// Traverse line, breaking down into components
 		std::string component = "";
+		// How many parentheses are open in the current component.
+		int parenthesisDepth = 0;
 		for (unsigned int i = 0; i < line.size(); i++) {
-			// If current character is alphanumeric, $, ?, #, :, -,  or ;, add to component string.
+			// If current character starts a quoted string (e.g. a file name), the whole string up to and
+			// including its closing quote is one component, whatever characters it contains.
+			if (line[i] == '"' && component.size() == 0) {
+				std::size_t closingQuote = line.find('"', i + 1);
+				if (closingQuote == std::string::npos) {
+					closingQuote = line.size() - 1;
+				}
+				parsedLine.push_back(line.substr(i, closingQuote - i + 1));
+				i = closingQuote;
+				continue;
+			}
+
+			// If current character is alphanumeric, $, ?, #, :, -, ;, or an expression operator, add to component
+			// string. Spaces are kept too while a parenthesis is open.
 			if (isAlphabetical(line[i]) || isNumeric(line[i]) || line[i] == '$' || line[i] == '?' 
-				|| line[i] == '#' || line[i] == ';' || line[i] == ':' || line[i] == '-') {	
+				|| line[i] == '#' || line[i] == ';' || line[i] == ':' || line[i] == '-' || 
+				isExpressionOperator(line[i]) || (line[i] == ' ' && parenthesisDepth > 0)) {	
 				component.push_back(line[i]);
 			}
+			if (line[i] == '(') {
+				parenthesisDepth++;
+			}
+			else if (line[i] == ')' && parenthesisDepth > 0) {
+				parenthesisDepth--;
+			}
 
 			// If we're at a space or we're at the end  of the line and the component is non-empty, add the
 			// completed component to parsedLine and start new component.
-			if ((line[i] == ' ' or i == line.size() - 1) && component.size() > 0) {
+			if (((line[i] == ' ' && parenthesisDepth == 0) or i == line.size() - 1) && component.size() > 0) {
 				parsedLine.push_back(component);
 				component.clear();
+				parenthesisDepth = 0;
 			}
 		}
 	}
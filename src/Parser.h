@@ -22,8 +22,13 @@ namespace Parser {
 	// Check the line for a '#' character, indicating that everthing that follows is a comment. If found,
 	// remove everything including and following this character. Modifies the input string directly.
 	void stripComment(std::string &s);
+	// Return true iff character c can be part of a constant expression (see ConstantExpression), other than letters,
+	// numbers and -.
+	bool isExpressionOperator(char c);
 	// Take an instruction in line string and break down into compoents separated by spaces. Ignore all characters 
-	// that are not letters, numbers, $, ?, #, :, or ;. Completely overwrites parsedLine.
+	// that are not letters, numbers, $, ?, #, :, ;, or expression operators, except within double quoted strings,
+	// which are kept whole (quotes and all) as a single component. Spaces inside parentheses don't separate
+	// components, so that expressions can be spaced out. Completely overwrites parsedLine.
 	// For example, turns "add $g,0 $g1 $g2" into parsedLine = {"add", "$g0", "$g1", "$g2"}. 
 	void parseLine(const std::string &line, std::vector<std::string> &parsedLine);
 };
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include "PeepholeOptimizer.h"
+#include "InstructionFormat.h"
+
+namespace PeepholeOptimizer {
+	// Return true iff running instruction never changes anything, e.g. addi $g0 $g0 0 or any sum written to $zero.
+	static bool doesNothing(const Instruction &instruction) {
+		if (!InstructionFormat::onlyWritesRegisters(instruction)) {
+			return false;
+		}
+		const std::string &mnemonic = InstructionFormat::getMnemonic(instruction);
+
+		// Writes to $zero and $wr are thrown away.
+		std::vector<unsigned int> written;
+		InstructionFormat::getWrittenRegisters(instruction, written);
+		if (written.empty()) {
+			return true;
+		}
+
+		// Otherwise look for instructions that write a register back unchanged.
+		const unsigned int zeroRegister = InstructionFormat::getRegisterId("$zero");
+		unsigned int destination = InstructionFormat::getDestination(instruction);
+		unsigned int readA = InstructionFormat::getReadA(instruction);
+		unsigned int readB = InstructionFormat::getReadB(instruction);
+		int immediate = InstructionFormat::getImmediate(instruction);
+		if (mnemonic == "addi" || mnemonic == "ori" || mnemonic == "xori" || mnemonic == "slli" ||
+			mnemonic == "srli") {
+			return destination == readA && immediate == 0;
+		}
+		if (mnemonic == "andi") {
+			return destination == readA && immediate == -1;
+		}
+		if (mnemonic == "add" || mnemonic == "or" || mnemonic == "xor") {
+			return (destination == readA && readB == zeroRegister) || (destination == readB && readA == zeroRegister) ||
+				(mnemonic == "or" && destination == readA && readA == readB);
+		}
+		if (mnemonic == "sub" || mnemonic == "sll" || mnemonic == "srl") {
+			return destination == readA && readB == zeroRegister;
+		}
+		if (mnemonic == "and") {
+			return destination == readA && readA == readB;
+		}
+		return false;
+	}
+
+	// If the jump at index goes to a jmp, make it go straight to wherever that jmp goes instead. Return true iff
+	// anything changed.
+	static bool threadJump(ProgramEditor &program, unsigned int index) {
+		if (!program.hasTarget(index)) {
+			return false;
+		}
+		unsigned int target = program.getTarget(index);
+		unsigned int steps = 0;
+		while (target < program.size() && InstructionFormat::is(program.getInstruction(target), "jmp") &&
+			program.hasTarget(target)) {
+			target = program.getTarget(target);
+			// Jumps going round in a circle never get anywhere, so leave them be.
+			if (++steps > program.size()) {
+				return false;
+			}
+		}
+		if (target == program.getTarget(index)) {
+			return false;
+		}
+		program.setTarget(index, target);
+		return true;
+	}
+
+	// If the instruction at index is an addi adding to the same register as the one after it (e.g. moving $sp twice
+	// in a row), fold the second one into the first. Return true iff anything changed.
+	static bool mergeAdjustments(ProgramEditor &program, unsigned int index, const std::vector<bool> &isTarget) {
+		// The second addi can only go if nothing jumps straight to it.
+		if (index + 1 >= program.size() || isTarget[index + 1]) {
+			return false;
+		}
+		const Instruction &first = program.getInstruction(index);
+		const Instruction &second = program.getInstruction(index + 1);
+		if (!InstructionFormat::is(first, "addi") || !InstructionFormat::is(second, "addi")) {
+			return false;
+		}
+		unsigned int adjustedRegister = InstructionFormat::getDestination(first);
+		if (InstructionFormat::getReadA(first) != adjustedRegister ||
+			InstructionFormat::getDestination(second) != adjustedRegister ||
+			InstructionFormat::getReadA(second) != adjustedRegister) {
+			return false;
+		}
+
+		// Registers wrap around at 16 bits, so a sum that doesn't fit wraps the same way.
+		Instruction merged = first;
+		InstructionFormat::setImmediate(merged, InstructionFormat::getImmediate(first) +
+			InstructionFormat::getImmediate(second));
+		program.replaceInstruction(index, merged);
+		program.remove(index + 1);
+		return true;
+	}
+
+	// If the instruction at index is a lw loading back a word stored earlier on in the same block, and the register
+	// that was stored still holds the same value, take the value from that register instead of going to memory.
+	// The store itself stays, since the word might be loaded again later on. Return true iff anything changed.
+	static bool forwardStore(ProgramEditor &program, unsigned int index, const std::vector<bool> &isTarget) {
+		unsigned int storeIndex = 0;
+		if (!program.findMatchingStore(index, isTarget, storeIndex)) {
+			return false;
+		}
+		unsigned int storedRegister = InstructionFormat::getReadB(program.getInstruction(storeIndex));
+		unsigned int loadedRegister = InstructionFormat::getDestination(program.getInstruction(index));
+		std::vector<unsigned int> written;
+		for (unsigned int i = storeIndex + 1; i < index; i++) {
+			InstructionFormat::getWrittenRegisters(program.getInstruction(i), written);
+			if (std::find(written.begin(), written.end(), storedRegister) != written.end()) {
+				return false;
+			}
+		}
+
+		if (storedRegister == loadedRegister) {
+			program.remove(index);
+		}
+		else {
+			program.replaceInstruction(index, InstructionFormat::makeInstruction("or", loadedRegister,
+				storedRegister, InstructionFormat::getRegisterId("$zero")));
+		}
+		return true;
+	}
+
+	// Rewrite program into an equivalent one that runs fewer instructions, and return how many instructions were
+	// removed. Nothing is changed in programs that jump to addresses they worked out themselves, since moving code
+	// around would break them.
+	unsigned int optimize(ProgramEditor &program) {
+		if (!program.canFollowEveryJump()) {
+			return 0;
+		}
+
+		// Keep going until there's nothing left to do, since every rewrite can make room for another (e.g. two
+		// addis that cancel out leave behind an addi of 0). Every change moves instructions around, so start over
+		// from the top each time.
+		const unsigned int originalSize = program.size();
+		std::vector<bool> isTarget;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			program.findJumpTargets(isTarget);
+			for (unsigned int i = 0; i < program.size() && !changed; i++) {
+				const Instruction &instruction = program.getInstruction(i);
+				// Jumps to the very next instruction (e.g. left behind by threading) go nowhere.
+				bool jumpsToNext = InstructionFormat::isJump(instruction) && !InstructionFormat::isCall(instruction) &&
+					program.hasTarget(i) && program.getTarget(i) == i + 1;
+				if (doesNothing(instruction) || jumpsToNext) {
+					program.remove(i);
+					changed = true;
+				}
+				else {
+					changed = threadJump(program, i) || mergeAdjustments(program, i, isTarget) ||
+						forwardStore(program, i, isTarget);
+				}
+			}
+		}
+		return originalSize - program.size();
+	}
+}
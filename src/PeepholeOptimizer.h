@@ -0,0 +1,16 @@
+#include "ProgramEditor.h"
+
+#ifndef PEEPHOLE_OPTIMIZER_H
+#define PEEPHOLE_OPTIMIZER_H
+
+// Contains a pass that speeds programs up by looking at a few instructions at a time and rewriting them into fewer
+// (e.g. removing instructions that do nothing, or jumps to jumps). Every instruction takes redstone ticks to run on
+// the real computer, so every one that doesn't need to run is time saved.
+namespace PeepholeOptimizer {
+	// Rewrite program into an equivalent one that runs fewer instructions, and return how many instructions were
+	// removed. Nothing is changed in programs that jump to addresses they worked out themselves, since moving code
+	// around would break them.
+	unsigned int optimize(ProgramEditor &program);
+};
+
+#endif
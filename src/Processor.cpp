@@ -15,6 +15,11 @@ BYTE Processor::inputResultRegID = 0b0;
 // True iff the program has crashed.
 bool Processor::programHasCrashed = false;
 
+// How many times the instruction at each address has run, and how many of those times it jumped somewhere other than
+// the next instruction.
+std::vector<std::uint64_t> Processor::executionCounts;
+std::vector<std::uint64_t> Processor::takenCounts;
+
 // Number we're currently outputting to the screen.
 WORD Processor::currentOutputNumber = 0;
 
@@ -126,6 +131,7 @@ void Processor::runNextTask() {
 
 	// Load our next instruction.
 	Instruction toExecute = Processor::instructionMemory[programCounter];
+	const WORD address = programCounter;
 	
 	// Load the opcode from the instruction.
 	unsigned int opcode = toExecute.getBitsInRange(0, 5);
@@ -147,31 +153,52 @@ void Processor::runNextTask() {
 		return;
 	}
 
+	// Keep count of how often this instruction has run, and whether it jumped.
+	Processor::executionCounts[address]++;
+	if (!Processor::waitingForInput && Processor::programCounter != address) {
+		Processor::takenCounts[address]++;
+	}
+
 	// Increment program counter iff we're not waiting for input.
 	if (!Processor::waitingForInput) {
 		Processor::programCounter++;
 	}
 }
 
-// Load machine code from an assembled source into instruction memory. Requires the input file to be a valid
-// file opened for binary reading.
-void Processor::loadMachineCode(std::ifstream &codeFile) {
-	// Read contents of machine code file.
-	std::vector<char> codeFileBuffer;
-	char byte;
-	while (codeFile.get(byte)) {
-		codeFileBuffer.push_back(byte);
-	}
-
-	// Turn these raw bytes into instructions and append into machine code vector.
-	for (unsigned int i = 0; i < (codeFileBuffer.size() / 4u); i++) {
-		Instruction nextInstruction;
-		nextInstruction.setBitsInRange(0u, 7u, (BYTE)codeFileBuffer[i * 4u]);
-		nextInstruction.setBitsInRange(8u, 15u, (BYTE)codeFileBuffer[i * 4u + 1]);
-		nextInstruction.setBitsInRange(16u, 23u, (BYTE)codeFileBuffer[i * 4u + 2]);
-		nextInstruction.setBitsInRange(24u, 31u, (BYTE)codeFileBuffer[i * 4u + 3]);
-		Processor::instructionMemory.push_back(nextInstruction);
-	}
+// Load machine code that has already been assembled in memory (e.g. by the assembler library) into instruction 
+// memory.
+void Processor::loadInstructions(const std::vector<Instruction> &machineCode) {
+	Processor::instructionMemory.insert(Processor::instructionMemory.end(), machineCode.begin(), 
+		machineCode.end());
+	Processor::executionCounts.resize(Processor::instructionMemory.size(), 0u);
+	Processor::takenCounts.resize(Processor::instructionMemory.size(), 0u);
+}
+
+// Put the whole machine back the way it was before any program was loaded: empty instruction memory, all registers,
+// data memory and displays cleared, and the program counter back at zero.
+void Processor::reset() {
+	Processor::instructionMemory.clear();
+	Processor::executionCounts.clear();
+	Processor::takenCounts.clear();
+	Processor::programCounter = 0;
+	Processor::waitingForInput = false;
+	Processor::inputResultRegID = 0b0;
+	Processor::programHasCrashed = false;
+	Processor::currentOutputNumber = 0;
+	Processor::charDisplay = "                ";
+	RegisterFile::reset();
+	DataMemory::reset();
+	Processor::CLRSCRN(0, 0, 0, 0, 0, 0);
+}
+
+// Return how often every instruction of the loaded program has run so far, and how often each one jumped, for laying
+// the program out to suit the way it runs.
+ExecutionProfile::Profile Processor::getProfile() {
+	ExecutionProfile::Profile profile;
+	profile.programHash = ExecutionProfile::hashProgram(Processor::instructionMemory);
+	profile.executionCounts = Processor::executionCounts;
+	profile.takenCounts = Processor::takenCounts;
+	return profile;
 }
 
 // Functions to execute each of the instructions. Each takes a destination register id, two read registers a 
@@ -7,6 +7,7 @@
 #include <string>
 #include "DataMemory.h"
 #include "PixelScreen.h"
+#include "ExecutionProfile.h"
 
 #ifndef PROCESSOR_H
 #define PROCESSOR_H
@@ -31,9 +32,15 @@ public:
 	// if there's an interrupt in progress, other tasks are also possible (e.g. waiting for a number to be 
 	// entered).
 	static void runNextTask();
-	// Load machine code from an assembled source into instruction memory. Requires the input file to be a valid
-	// file opened for biary reading.
-	static void loadMachineCode(std::ifstream &codeFile);
+	// Load machine code that has already been assembled in memory (e.g. by the assembler library) into 
+	// instruction memory.
+	static void loadInstructions(const std::vector<Instruction> &machineCode);
+	// Put the whole machine back the way it was before any program was loaded: empty instruction memory, all
+	// registers, data memory and displays cleared, and the program counter back at zero.
+	static void reset();
+	// Return how often every instruction of the loaded program has run so far, and how often each one jumped, for
+	// laying the program out to suit the way it runs.
+	static ExecutionProfile::Profile getProfile();
 
 private:
 	// Functions to execute each of the instructions. Each takes a destination register id, two read registers a 
@@ -92,6 +99,10 @@ private:
 	static std::mt19937 mt;
 	// True iff the program has crashed.
 	static bool programHasCrashed;
+	// How many times the instruction at each address has run, and how many of those times it jumped somewhere other
+	// than the next instruction.
+	static std::vector<std::uint64_t> executionCounts;
+	static std::vector<std::uint64_t> takenCounts;
 	// Maps 6 bit opcodes into instruction functions.
 	static const std::map<unsigned int, std::function<void(BYTE, BYTE, BYTE, BYTE, WORD, WORD)> > 
 	opcodeToInstructionMap;
@@ -0,0 +1,288 @@
+#include "ProgramEditor.h"
+#include "InstructionFormat.h"
+
+// Constructs an editor for program, which may be a partly filled in assembler result (e.g. with no source locations).
+// If the program has relocations, jumps are matched up with labels through them, otherwise jump addresses are read
+// straight out of the machine code.
+ProgramEditor::ProgramEditor(const Assembler::Result &program) : hasRelocations(program.relocations.size() > 0) {
+	const unsigned int programSize = (unsigned int)program.machineCode.size();
+
+	// Note which label every jump was written with, if we know.
+	std::vector<std::string> targetLabels(programSize);
+	for (const Assembler::Relocation &relocation : program.relocations) {
+		targetLabels[relocation.address] = relocation.label;
+	}
+
+	for (unsigned int i = 0; i < programSize; i++) {
+		Entry entry;
+		entry.instruction = program.machineCode[i];
+		if (i < program.sourceLocations.size()) {
+			entry.location = program.sourceLocations[i];
+		}
+		entry.id = i;
+		entry.hasTarget = false;
+		entry.targetId = END_ID;
+		entry.targetLabel = targetLabels[i];
+
+		if (InstructionFormat::isJump(entry.instruction)) {
+			// Labels give the real address even for programs too large to fit in instruction memory, whose
+			// addresses got cut short when they were encoded. Jumps to labels defined elsewhere (i.e. in code
+			// still to be linked) have no target we know of.
+			unsigned int target = InstructionFormat::getJumpTarget(entry.instruction);
+			std::map<std::string, unsigned int>::const_iterator label = program.labels.find(entry.targetLabel);
+			if (label != program.labels.end()) {
+				target = label->second;
+			}
+			if (this->hasRelocations && label == program.labels.end()) {
+				target = programSize + 1;
+			}
+			if (target <= programSize) {
+				entry.hasTarget = true;
+				entry.targetId = target == programSize ? END_ID : target;
+			}
+		}
+
+		this->entries.push_back(entry);
+		this->replacementIds.push_back(i);
+	}
+
+	for (const std::pair<const std::string, unsigned int> &label : program.labels) {
+		this->labelIds[label.first] = label.second >= programSize ? END_ID : label.second;
+	}
+}
+
+// Return the number of instructions in the program.
+unsigned int ProgramEditor::size() const {
+	return (unsigned int)this->entries.size();
+}
+
+// Return the instruction at index.
+const Instruction &ProgramEditor::getInstruction(unsigned int index) const {
+	return this->entries[index].instruction;
+}
+
+// Return where the instruction at index came from in the source.
+const Assembler::SourceLocation &ProgramEditor::getSourceLocation(unsigned int index) const {
+	return this->entries[index].location;
+}
+
+// Return true iff the instruction at index is a jump whose target is known, so that getTarget() can be used. Jumps to
+// addresses past the end of the program, which can never be reached, are left alone.
+bool ProgramEditor::hasTarget(unsigned int index) const {
+	return this->entries[index].hasTarget;
+}
+
+// Return the index of the instruction that the jump at index goes to, or size() if it goes to the end of the program.
+// Requires hasTarget(index).
+unsigned int ProgramEditor::getTarget(unsigned int index) {
+	return this->indexOfId(this->entries[index].targetId);
+}
+
+// Return true iff some label points at the instruction at index.
+bool ProgramEditor::isLabeled(unsigned int index) {
+	for (const std::pair<const std::string, unsigned int> &label : this->labelIds) {
+		if (this->indexOfId(label.second) == index) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Overwrite isTarget with whether each instruction is the target of some jump.
+void ProgramEditor::findJumpTargets(std::vector<bool> &isTarget) {
+	isTarget.assign(this->size(), false);
+	for (unsigned int i = 0; i < this->size(); i++) {
+		if (this->hasTarget(i) && this->getTarget(i) < this->size()) {
+			isTarget[this->getTarget(i)] = true;
+		}
+	}
+}
+
+// Return true iff every jump in the program can be followed, i.e. every jump has a known target and returns only ever
+// go back to just after a call. Code can only be moved around safely if this holds, since otherwise the program might
+// jump to addresses it worked out itself (i.e. jr through anything but $ca, or $ca being set by anything but call and
+// lw).
+bool ProgramEditor::canFollowEveryJump() const {
+	const unsigned int caRegister = InstructionFormat::getRegisterId("$ca");
+	std::vector<unsigned int> registers;
+	for (unsigned int i = 0; i < this->size(); i++) {
+		const Instruction &instruction = this->getInstruction(i);
+		if (InstructionFormat::isIndirectJump(instruction)) {
+			if (InstructionFormat::getReadA(instruction) != caRegister) {
+				return false;
+			}
+		}
+		else if (InstructionFormat::isJump(instruction) && !this->hasTarget(i)) {
+			return false;
+		}
+		// Saving $ca on the stack and loading it back is fine, anything else might put any old address in it.
+		else if (!InstructionFormat::isCall(instruction) && !InstructionFormat::is(instruction, "lw")) {
+			InstructionFormat::getWrittenRegisters(instruction, registers);
+			for (unsigned int writtenRegister : registers) {
+				if (writtenRegister == caRegister) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// Return true iff the instruction at index is a lw loading back a word stored by a sw earlier on in the same run of
+// straight line code (isTarget being as found by findJumpTargets()), with nothing in between that could change which
+// word that is or what's in it. If so, storeIndex is overwritten with the index of the sw.
+bool ProgramEditor::findMatchingStore(unsigned int index, const std::vector<bool> &isTarget,
+	unsigned int &storeIndex) const {
+	const Instruction &load = this->getInstruction(index);
+	if (!InstructionFormat::is(load, "lw")) {
+		return false;
+	}
+	const unsigned int baseRegister = InstructionFormat::getReadA(load);
+	const int offset = InstructionFormat::getOffset(load);
+	std::vector<unsigned int> registers;
+	for (unsigned int i = index; i-- > 0;) {
+		// Anything jumping in after i might not have been through it.
+		if (isTarget[i + 1]) {
+			return false;
+		}
+		const Instruction &instruction = this->getInstruction(i);
+		if (InstructionFormat::is(instruction, "sw") && InstructionFormat::getReadA(instruction) == baseRegister) {
+			if (InstructionFormat::getOffset(instruction) == offset) {
+				storeIndex = i;
+				return true;
+			}
+			// Stores to other offsets from the same address can't touch the word.
+			continue;
+		}
+		// Stores through any other register might be to the same word.
+		if (InstructionFormat::is(instruction, "sw") || InstructionFormat::isJump(instruction) ||
+			InstructionFormat::isIndirectJump(instruction)) {
+			return false;
+		}
+		InstructionFormat::getWrittenRegisters(instruction, registers);
+		for (unsigned int writtenRegister : registers) {
+			if (writtenRegister == baseRegister) {
+				return false;
+			}
+		}
+	}
+	return false;
+}
+
+// Replace the instruction at index with instruction, keeping where it came from. If both are jumps, the new one goes
+// to wherever the old one did.
+void ProgramEditor::replaceInstruction(unsigned int index, const Instruction &instruction) {
+	Entry &entry = this->entries[index];
+	entry.instruction = instruction;
+	if (!InstructionFormat::isJump(instruction)) {
+		entry.hasTarget = false;
+		entry.targetLabel.clear();
+	}
+}
+
+// Make the jump at index go to the instruction at target (or size(), for the end of the program).
+void ProgramEditor::setTarget(unsigned int index, unsigned int target) {
+	Entry &entry = this->entries[index];
+	entry.hasTarget = true;
+	entry.targetId = this->idAtIndex(target);
+	// Whatever label the jump was written with may not point there any more.
+	entry.targetLabel.clear();
+	for (const std::pair<const std::string, unsigned int> &label : this->labelIds) {
+		if (this->resolveId(label.second) == entry.targetId) {
+			entry.targetLabel = label.first;
+			break;
+		}
+	}
+}
+
+// Remove the instruction at index. Anything that pointed at it now points at whatever came after it.
+void ProgramEditor::remove(unsigned int index) {
+	this->replacementIds[this->entries[index].id] = this->idAtIndex(index + 1);
+	this->entries.erase(this->entries.begin() + index);
+	this->indicesAreValid = false;
+}
+
+// Insert instruction before the instruction at index (or at the end if index is size()), recording that it came from
+// location. Anything that pointed at the instruction at index still does.
+void ProgramEditor::insert(unsigned int index, const Instruction &instruction,
+	const Assembler::SourceLocation &location) {
+	Entry entry;
+	entry.instruction = instruction;
+	entry.location = location;
+	entry.id = (unsigned int)this->replacementIds.size();
+	entry.hasTarget = false;
+	entry.targetId = END_ID;
+	this->replacementIds.push_back(entry.id);
+	this->entries.insert(this->entries.begin() + index, entry);
+	this->indicesAreValid = false;
+}
+
+// Move every instruction somewhere else, order giving the index of the instruction to put at each index (so it must
+// hold every index exactly once). Jumps and labels go wherever the instructions they point at go, but instructions
+// that fell through into the one after them will fall through into whatever is there now.
+void ProgramEditor::reorder(const std::vector<unsigned int> &order) {
+	std::vector<Entry> reordered;
+	reordered.reserve(this->entries.size());
+	for (unsigned int index : order) {
+		reordered.push_back(this->entries[index]);
+	}
+	this->entries.swap(reordered);
+	this->indicesAreValid = false;
+}
+
+// Write the edited program back into program's machine code, source locations and labels, with every jump address
+// updated. Anything else in program is left as is, except relocations, which are rebuilt for the edited code if
+// program had any.
+void ProgramEditor::writeTo(Assembler::Result &program) {
+	program.machineCode.clear();
+	program.sourceLocations.clear();
+	program.relocations.clear();
+	for (unsigned int i = 0; i < this->size(); i++) {
+		Entry &entry = this->entries[i];
+		if (entry.hasTarget) {
+			InstructionFormat::setJumpTarget(entry.instruction, this->getTarget(i));
+		}
+		if (this->hasRelocations && !entry.targetLabel.empty()) {
+			program.relocations.push_back({i, entry.targetLabel});
+		}
+		program.machineCode.push_back(entry.instruction);
+		program.sourceLocations.push_back(entry.location);
+	}
+
+	program.labels.clear();
+	for (const std::pair<const std::string, unsigned int> &label : this->labelIds) {
+		program.labels[label.first] = this->indexOfId(label.second);
+	}
+}
+
+// Return the id of whatever now stands in for the instruction with the given id, following it on past any
+// instructions that have been removed. END_ID stands for the end of the program.
+unsigned int ProgramEditor::resolveId(unsigned int id) {
+	while (id != END_ID && this->replacementIds[id] != id) {
+		// Skip straight to the end of the chain next time.
+		unsigned int next = this->replacementIds[id];
+		if (next != END_ID && this->replacementIds[next] != next) {
+			this->replacementIds[id] = this->replacementIds[next];
+		}
+		id = next;
+	}
+	return id;
+}
+
+// Return the index of the (not removed) instruction with the given id, or size() for END_ID.
+unsigned int ProgramEditor::indexOfId(unsigned int id) {
+	if (!this->indicesAreValid) {
+		this->idIndices.assign(this->replacementIds.size(), 0u);
+		for (unsigned int i = 0; i < this->size(); i++) {
+			this->idIndices[this->entries[i].id] = i;
+		}
+		this->indicesAreValid = true;
+	}
+	id = this->resolveId(id);
+	return id == END_ID ? this->size() : this->idIndices[id];
+}
+
+// Return the id of the instruction at index, or END_ID if index is size().
+unsigned int ProgramEditor::idAtIndex(unsigned int index) const {
+	return index >= this->size() ? END_ID : this->entries[index].id;
+}
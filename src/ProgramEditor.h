@@ -0,0 +1,105 @@
+#include <string>
+#include <vector>
+#include <map>
+#include "Instruction.h"
+#include "Assembler.h"
+
+#ifndef PROGRAM_EDITOR_H
+#define PROGRAM_EDITOR_H
+
+// Represents an assembled program that's being reworked (e.g. by removing code that can never run), keeping track of
+// where every jump and label should point as instructions are added, removed and moved around. Jumps and labels
+// follow the instruction they point at rather than its address, and anything pointing at a removed instruction moves
+// on to whatever came after it. Once all the editing is done, writeTo() puts everything back at its new address.
+class ProgramEditor {
+public:
+	// Constructs an editor for program, which may be a partly filled in assembler result (e.g. with no source
+	// locations). If the program has relocations, jumps are matched up with labels through them, otherwise jump
+	// addresses are read straight out of the machine code.
+	ProgramEditor(const Assembler::Result &program);
+
+	// Return the number of instructions in the program.
+	unsigned int size() const;
+	// Return the instruction at index.
+	const Instruction &getInstruction(unsigned int index) const;
+	// Return where the instruction at index came from in the source.
+	const Assembler::SourceLocation &getSourceLocation(unsigned int index) const;
+	// Return true iff the instruction at index is a jump whose target is known, so that getTarget() can be used.
+	// Jumps to addresses past the end of the program, which can never be reached, are left alone.
+	bool hasTarget(unsigned int index) const;
+	// Return the index of the instruction that the jump at index goes to, or size() if it goes to the end of the
+	// program. Requires hasTarget(index).
+	unsigned int getTarget(unsigned int index);
+	// Return true iff some label points at the instruction at index.
+	bool isLabeled(unsigned int index);
+	// Overwrite isTarget with whether each instruction is the target of some jump.
+	void findJumpTargets(std::vector<bool> &isTarget);
+	// Return true iff every jump in the program can be followed, i.e. every jump has a known target and returns
+	// only ever go back to just after a call. Code can only be moved around safely if this holds, since otherwise
+	// the program might jump to addresses it worked out itself (i.e. jr through anything but $ca, or $ca being set
+	// by anything but call and lw).
+	bool canFollowEveryJump() const;
+	// Return true iff the instruction at index is a lw loading back a word stored by a sw earlier on in the same
+	// run of straight line code (isTarget being as found by findJumpTargets()), with nothing in between that could
+	// change which word that is or what's in it. If so, storeIndex is overwritten with the index of the sw.
+	bool findMatchingStore(unsigned int index, const std::vector<bool> &isTarget, unsigned int &storeIndex) const;
+
+	// Replace the instruction at index with instruction, keeping where it came from. If both are jumps, the new
+	// one goes to wherever the old one did.
+	void replaceInstruction(unsigned int index, const Instruction &instruction);
+	// Make the jump at index go to the instruction at target (or size(), for the end of the program).
+	void setTarget(unsigned int index, unsigned int target);
+	// Remove the instruction at index. Anything that pointed at it now points at whatever came after it.
+	void remove(unsigned int index);
+	// Insert instruction before the instruction at index (or at the end if index is size()), recording that it
+	// came from location. Anything that pointed at the instruction at index still does.
+	void insert(unsigned int index, const Instruction &instruction, const Assembler::SourceLocation &location);
+	// Move every instruction somewhere else, order giving the index of the instruction to put at each index (so it
+	// must hold every index exactly once). Jumps and labels go wherever the instructions they point at go, but
+	// instructions that fell through into the one after them will fall through into whatever is there now.
+	void reorder(const std::vector<unsigned int> &order);
+
+	// Write the edited program back into program's machine code, source locations and labels, with every jump
+	// address updated. Anything else in program is left as is, except relocations, which are rebuilt for the
+	// edited code if program had any.
+	void writeTo(Assembler::Result &program);
+
+private:
+	// An instruction in the program, along with everything needed to keep track of it as it moves around.
+	struct Entry {
+		Instruction instruction;
+		Assembler::SourceLocation location;
+		// Never changes, no matter where the instruction moves to.
+		unsigned int id;
+		// Whether this is a jump with a known target, and if so the id of the instruction it goes to.
+		bool hasTarget;
+		unsigned int targetId;
+		// The label the jump was written with, if it's known, so relocations can be rebuilt.
+		std::string targetLabel;
+	};
+
+	// Return the id of whatever now stands in for the instruction with the given id, following it on past any
+	// instructions that have been removed. END_ID stands for the end of the program.
+	unsigned int resolveId(unsigned int id);
+	// Return the index of the (not removed) instruction with the given id, or size() for END_ID.
+	unsigned int indexOfId(unsigned int id);
+	// Return the id of the instruction at index, or END_ID if index is size().
+	unsigned int idAtIndex(unsigned int index) const;
+
+	// Id standing for the end of the program.
+	static const unsigned int END_ID = 0xffffffffu;
+	// The program's instructions, in order.
+	std::vector<Entry> entries;
+	// Maps label names onto the ids of the instructions they point at.
+	std::map<std::string, unsigned int> labelIds;
+	// For every id ever handed out, the id of the instruction that took its place when it was removed, or its own
+	// id if it hasn't been removed.
+	std::vector<unsigned int> replacementIds;
+	// Maps ids onto indices into entries. Only valid while indicesAreValid is set, which is cleared by any edit.
+	std::vector<unsigned int> idIndices;
+	bool indicesAreValid = false;
+	// Whether the original program had relocations, so that writeTo() should rebuild them.
+	bool hasRelocations;
+};
+
+#endif
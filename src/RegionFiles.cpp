@@ -0,0 +1,601 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include "RegionFiles.h"
+#include "Nbt.h"
+#include "ThreadPool.h"
+#include "zlib.h"
+
+namespace RegionFiles {
+	// Size of the sectors a region file is split into (every chunk takes up a whole number of them), and the most
+	// sectors a chunk can take up. Every region file starts with two sectors: where each of its chunks is stored,
+	// then when each of them was last saved.
+	static const std::size_t SECTOR_SIZE = 4096u;
+	static const std::size_t MAX_CHUNK_SECTORS = 255u;
+	static const std::size_t HEADER_SIZE = 2u * SECTOR_SIZE;
+	// How many chunks a region file holds along x and along z, and how many blocks a chunk section (a 16 block high
+	// slice of a chunk) holds along each axis and in total.
+	static const int REGION_CHUNKS = 32;
+	static const int SECTION_SIZE = 16;
+	static const unsigned int SECTION_BLOCKS = 4096u;
+	// How a chunk is compressed, as recorded in the byte before it. Chunks stored in a file of their own have
+	// EXTERNAL_CHUNK added on.
+	static const BYTE COMPRESSION_GZIP = 1u;
+	static const BYTE COMPRESSION_ZLIB = 2u;
+	static const BYTE COMPRESSION_NONE = 3u;
+	static const BYTE EXTERNAL_CHUNK = 128u;
+	// Earliest data version (Minecraft 1.16) whose block states are packed the way we read and write them, and the
+	// fewest bits a block state is ever packed into.
+	static const std::int64_t MIN_DATA_VERSION = 2566;
+	static const unsigned int MIN_BITS_PER_BLOCK = 4u;
+	// Furthest a block can be from the middle of a world along x and z, and along y.
+	static const int MAX_HORIZONTAL_POSITION = 30000000;
+	static const int MAX_VERTICAL_POSITION = 20000000;
+
+	// Instruction memory being built into a world: where its north west bottom corner goes, its geometry, every one
+	// of its blocks (in schematic order), and the name of the block for each palette ID in them.
+	struct Build {
+		Position origin;
+		IMemSchematic::Geometry geometry;
+		std::vector<BYTE> blocks;
+		std::vector<std::string> blockNames;
+
+		// Return true iff (x, y, z) in the world is part of the instruction memory.
+		bool contains(std::int64_t x, std::int64_t y, std::int64_t z) const {
+			return x >= origin.x && x < (std::int64_t)origin.x + geometry.getWidth() && y >= origin.y &&
+				y < (std::int64_t)origin.y + geometry.getHeight() && z >= origin.z &&
+				z < (std::int64_t)origin.z + geometry.getLength();
+		}
+	};
+
+	// A chunk to edit: which region file it's in, where it is in the world, and its new contents, ready to be stored
+	// (a 4 byte length, then how it's compressed, then the compressed chunk).
+	struct ChunkEdit {
+		std::size_t region;
+		int chunkX;
+		int chunkZ;
+		std::vector<BYTE> stored;
+	};
+
+	// A region file being edited, and everything in it.
+	struct RegionFile {
+		std::string fileName;
+		std::vector<BYTE> data;
+	};
+
+	// Return value divided by divisor, rounded down (rather than towards zero, as / does).
+	static int floorDivide(int value, int divisor) {
+		return value / divisor - (value % divisor < 0 ? 1 : 0);
+	}
+
+	// Return the position described by text, which is <x>,<y>,<z> (e.g. -929,82,641). Throws an exception if text
+	// isn't in that form.
+	Position parsePosition(const std::string &text) {
+		int coordinates[3] = {0, 0, 0};
+		std::size_t position = 0;
+		for (unsigned int i = 0; i < 3u; i++) {
+			std::size_t end = text.find(',', position);
+			std::string part = text.substr(position, end == std::string::npos ? std::string::npos : end - position);
+			std::size_t used = 0;
+			try {
+				coordinates[i] = std::stoi(part, &used);
+			}
+			catch (std::exception &e) {
+				used = 0;
+			}
+			int limit = i == 1u ? MAX_VERTICAL_POSITION : MAX_HORIZONTAL_POSITION;
+			if (part.empty() || used != part.size() || coordinates[i] < -limit || coordinates[i] > limit ||
+				(end == std::string::npos) != (i == 2u)) {
+				throw std::runtime_error("Invalid world position " + text + ", expected <x>,<y>,<z>!");
+			}
+			position = end + 1u;
+		}
+		Position result;
+		result.x = coordinates[0];
+		result.y = coordinates[1];
+		result.z = coordinates[2];
+		return result;
+	}
+
+	// Return the tag named name in compound, adding an empty one of type if there isn't one.
+	static Nbt::Tag &getOrAddChild(Nbt::Tag &compound, const std::string &name, BYTE type) {
+		Nbt::Tag *child = compound.find(name);
+		if (child == nullptr) {
+			Nbt::Tag tag;
+			tag.type = type;
+			tag.name = name;
+			compound.children.push_back(tag);
+			child = &compound.children.back();
+		}
+		return *child;
+	}
+
+	// Remove the tag named name from compound, if it has one.
+	static void removeChild(Nbt::Tag &compound, const std::string &name) {
+		compound.children.erase(std::remove_if(compound.children.begin(), compound.children.end(),
+			[&name](const Nbt::Tag &child) { return child.name == name; }), compound.children.end());
+	}
+
+	// Return a block state tag (as stored in the palette of a chunk section) for the block named name, which is in
+	// the form getBlockName() gives (e.g. minecraft:repeater[delay=1,facing=east]).
+	static Nbt::Tag makeBlockState(const std::string &name) {
+		Nbt::Tag state;
+		state.type = NBT_COMPOUND;
+		std::size_t bracket = name.find('[');
+		Nbt::Tag &nameTag = getOrAddChild(state, "Name", NBT_STRING);
+		nameTag.text = name.substr(0, bracket);
+		if (bracket == std::string::npos) {
+			return state;
+		}
+
+		Nbt::Tag &properties = getOrAddChild(state, "Properties", NBT_COMPOUND);
+		std::size_t position = bracket + 1u;
+		while (position < name.size()) {
+			std::size_t end = name.find_first_of(",]", position);
+			std::string property = name.substr(position, end - position);
+			std::size_t equals = property.find('=');
+			Nbt::Tag &value = getOrAddChild(properties, property.substr(0, equals), NBT_STRING);
+			value.text = property.substr(equals + 1u);
+			position = end + 1u;
+		}
+		return state;
+	}
+
+	// Return the name of the block a block state tag is for, in the form getBlockName() gives, with its properties
+	// sorted by name so that the same block always has the same name.
+	static std::string getBlockStateName(const Nbt::Tag &state) {
+		const Nbt::Tag *nameTag = state.find("Name");
+		const Nbt::Tag *properties = state.find("Properties");
+		std::string name = nameTag != nullptr ? nameTag->text : "";
+		if (properties == nullptr || properties->children.empty()) {
+			return name;
+		}
+
+		std::vector<std::string> values;
+		for (const Nbt::Tag &property : properties->children) {
+			values.push_back(property.name + "=" + property.text);
+		}
+		std::sort(values.begin(), values.end());
+		for (unsigned int i = 0; i < values.size(); i++) {
+			name += (i == 0 ? "[" : ",") + values[i];
+		}
+		return name + "]";
+	}
+
+	// Return how many bits each block state of a chunk section with paletteSize different blocks is packed into.
+	static unsigned int getBitsPerBlock(std::size_t paletteSize) {
+		unsigned int bits = MIN_BITS_PER_BLOCK;
+		while (((std::size_t)1u << bits) < paletteSize) {
+			bits++;
+		}
+		return bits;
+	}
+
+	// Replace every block of section sectionY of chunk (chunkX, chunkZ) that's part of the instruction memory being
+	// built. Block states are indices into the palette of the section, packed into longs as tightly as they go
+	// without spanning two longs, lowest bits first. The palette is rebuilt with only the blocks still in the
+	// section, and the block states repacked to suit. isModern is set iff the chunk is from Minecraft 1.18 or later,
+	// which keeps the palette and block states in a compound of their own.
+	static void editSection(Nbt::Tag &section, bool isModern, int chunkX, int sectionY, int chunkZ,
+		const Build &build) {
+		Nbt::Tag &container = isModern ? getOrAddChild(section, "block_states", NBT_COMPOUND) : section;
+		const std::string paletteName = isModern ? "palette" : "Palette";
+		const std::string dataName = isModern ? "data" : "BlockStates";
+		const std::string description = "chunk section (" + std::to_string(chunkX) + ", " +
+			std::to_string(sectionY) + ", " + std::to_string(chunkZ) + ")";
+
+		// Sections that have only ever held air may not have a palette yet.
+		std::vector<Nbt::Tag> palette;
+		const Nbt::Tag *paletteTag = container.find(paletteName);
+		if (paletteTag != nullptr && !paletteTag->children.empty()) {
+			palette = paletteTag->children;
+		}
+		else {
+			palette.push_back(makeBlockState("minecraft:air"));
+		}
+		std::vector<std::uint32_t> states(SECTION_BLOCKS, 0u);
+		const Nbt::Tag *data = container.find(dataName);
+		if (palette.size() > 1u || data != nullptr) {
+			const unsigned int bits = getBitsPerBlock(palette.size());
+			const unsigned int statesPerLong = 64u / bits;
+			if (data == nullptr || data->longs.size() < (SECTION_BLOCKS + statesPerLong - 1u) / statesPerLong) {
+				throw std::runtime_error("Block states of " + description + " are missing or too short!");
+			}
+			for (unsigned int i = 0; i < SECTION_BLOCKS; i++) {
+				std::uint64_t packed = (std::uint64_t)data->longs[i / statesPerLong];
+				states[i] = (std::uint32_t)((packed >> ((i % statesPerLong) * bits)) & ((1u << bits) - 1u));
+				if (states[i] >= palette.size()) {
+					throw std::runtime_error("Block states of " + description + " aren't in its palette!");
+				}
+			}
+		}
+
+		// Put in the blocks of the instruction memory, adding each one to the palette the first time it's used.
+		std::map<std::string, std::uint32_t> paletteIndices;
+		for (std::uint32_t i = 0; i < palette.size(); i++) {
+			paletteIndices.insert(std::make_pair(getBlockStateName(palette[i]), i));
+		}
+		std::vector<std::int64_t> idIndices(1u << BYTE_SIZE, -1);
+		const Position &origin = build.origin;
+		const int minX = std::max(chunkX * SECTION_SIZE, origin.x);
+		const int maxX = std::min(chunkX * SECTION_SIZE + SECTION_SIZE, origin.x + (int)build.geometry.getWidth());
+		const int minY = std::max(sectionY * SECTION_SIZE, origin.y);
+		const int maxY = std::min(sectionY * SECTION_SIZE + SECTION_SIZE, origin.y + (int)build.geometry.getHeight());
+		const int minZ = std::max(chunkZ * SECTION_SIZE, origin.z);
+		const int maxZ = std::min(chunkZ * SECTION_SIZE + SECTION_SIZE, origin.z + (int)build.geometry.getLength());
+		for (int y = minY; y < maxY; y++) {
+			for (int z = minZ; z < maxZ; z++) {
+				for (int x = minX; x < maxX; x++) {
+					BYTE id = build.blocks[build.geometry.getBlockIndex(x - origin.x, y - origin.y, z - origin.z)];
+					if (idIndices[id] < 0) {
+						std::map<std::string, std::uint32_t>::const_iterator found =
+							paletteIndices.find(build.blockNames[id]);
+						if (found == paletteIndices.end()) {
+							found = paletteIndices.insert(std::make_pair(build.blockNames[id],
+								(std::uint32_t)palette.size())).first;
+							palette.push_back(makeBlockState(build.blockNames[id]));
+						}
+						idIndices[id] = found->second;
+					}
+					states[((y - sectionY * SECTION_SIZE) * SECTION_SIZE + (z - chunkZ * SECTION_SIZE)) *
+						SECTION_SIZE + (x - chunkX * SECTION_SIZE)] = (std::uint32_t)idIndices[id];
+				}
+			}
+		}
+
+		// Drop whatever the instruction memory replaced from the palette, keeping the rest in the order it's used.
+		std::vector<std::uint32_t> newIndices(palette.size(), UINT32_MAX);
+		std::vector<Nbt::Tag> newPalette;
+		for (std::uint32_t &state : states) {
+			if (newIndices[state] == UINT32_MAX) {
+				newIndices[state] = (std::uint32_t)newPalette.size();
+				newPalette.push_back(palette[state]);
+			}
+			state = newIndices[state];
+		}
+		Nbt::Tag &newPaletteTag = getOrAddChild(container, paletteName, NBT_LIST);
+		newPaletteTag.elementType = NBT_COMPOUND;
+		newPaletteTag.children = newPalette;
+
+		// Since 1.18, a section of a single block has no block states at all.
+		if (isModern && newPalette.size() == 1u) {
+			removeChild(container, dataName);
+			return;
+		}
+		const unsigned int bits = getBitsPerBlock(newPalette.size());
+		const unsigned int statesPerLong = 64u / bits;
+		Nbt::Tag &newData = getOrAddChild(container, dataName, NBT_LONG_ARRAY);
+		newData.type = NBT_LONG_ARRAY;
+		newData.longs.assign((SECTION_BLOCKS + statesPerLong - 1u) / statesPerLong, 0);
+		for (unsigned int i = 0; i < SECTION_BLOCKS; i++) {
+			newData.longs[i / statesPerLong] = (std::int64_t)((std::uint64_t)newData.longs[i / statesPerLong] |
+				((std::uint64_t)states[i] << ((i % statesPerLong) * bits)));
+		}
+	}
+
+	// Build the part of the instruction memory in chunk (chunkX, chunkZ) into the chunk, whose NBT is root. Block
+	// entities and scheduled ticks left inside the instruction memory are removed, and the chunk is marked as needing
+	// its light worked out again when it's next loaded. Throws an exception if the chunk isn't from a version of
+	// Minecraft we understand, or the instruction memory goes above or below the world.
+	static void editChunk(Nbt::Tag &root, int chunkX, int chunkZ, const Build &build) {
+		const std::string description = "chunk (" + std::to_string(chunkX) + ", " + std::to_string(chunkZ) + ")";
+		const Nbt::Tag *dataVersion = root.find("DataVersion");
+		if (dataVersion == nullptr || dataVersion->number < MIN_DATA_VERSION) {
+			throw std::runtime_error("World " + description + " is from a version of Minecraft before 1.16!");
+		}
+
+		// Before 1.18, everything in a chunk was in a compound of its own, under different names.
+		const bool isModern = root.find("sections") != nullptr;
+		Nbt::Tag *level = isModern ? &root : root.find("Level");
+		if (level == nullptr || level->type != NBT_COMPOUND) {
+			throw std::runtime_error("World " + description + " has no level data!");
+		}
+		Nbt::Tag &sections = getOrAddChild(*level, isModern ? "sections" : "Sections", NBT_LIST);
+		if (sections.children.empty()) {
+			sections.elementType = NBT_COMPOUND;
+		}
+		const int minSection = floorDivide(build.origin.y, SECTION_SIZE);
+		const int maxSection = floorDivide(build.origin.y + (int)build.geometry.getHeight() - 1, SECTION_SIZE);
+		for (int sectionY = minSection; sectionY <= maxSection; sectionY++) {
+			Nbt::Tag *section = nullptr;
+			for (Nbt::Tag &candidate : sections.children) {
+				const Nbt::Tag *y = candidate.find("Y");
+				if (y != nullptr && y->number == sectionY) {
+					section = &candidate;
+				}
+			}
+			if (section == nullptr) {
+				// Since 1.18 every section of a chunk is saved, so a missing one is outside the height of the world.
+				// Before that, sections of nothing but air were left out.
+				if (isModern) {
+					throw std::runtime_error("Instruction memory doesn't fit in the height of the world at " +
+						description + "!");
+				}
+				Nbt::Tag newSection;
+				newSection.type = NBT_COMPOUND;
+				getOrAddChild(newSection, "Y", NBT_BYTE).number = sectionY;
+				sections.children.push_back(newSection);
+				section = &sections.children.back();
+			}
+			editSection(*section, isModern, chunkX, sectionY, chunkZ, build);
+		}
+
+		// The game would otherwise attach stale block entities (and ticks) to the blocks we've just put in.
+		const std::vector<std::string> listNames = isModern ?
+			std::vector<std::string>({"block_entities", "block_ticks", "fluid_ticks"}) :
+			std::vector<std::string>({"TileEntities", "TileTicks", "LiquidTicks"});
+		for (const std::string &listName : listNames) {
+			Nbt::Tag *list = level->find(listName);
+			if (list == nullptr) {
+				continue;
+			}
+			list->children.erase(std::remove_if(list->children.begin(), list->children.end(),
+				[&build](const Nbt::Tag &entry) {
+					const Nbt::Tag *x = entry.find("x");
+					const Nbt::Tag *y = entry.find("y");
+					const Nbt::Tag *z = entry.find("z");
+					return x != nullptr && y != nullptr && z != nullptr && build.contains(x->number, y->number,
+						z->number);
+				}), list->children.end());
+		}
+		Nbt::Tag *isLightOn = level->find("isLightOn");
+		if (isLightOn != nullptr) {
+			isLightOn->number = 0;
+		}
+	}
+
+	// Return the uncompressed contents of size bytes of gzip or zlib compressed data. Throws an exception if the
+	// data could not be decompressed.
+	static std::vector<BYTE> decompress(const BYTE *data, std::size_t size, const std::string &description) {
+		// Adding 32 to the window size asks zlib to accept either a gzip or a zlib header.
+		z_stream stream = {};
+		if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+			throw std::runtime_error("Issue setting up decompression of " + description + "!");
+		}
+		std::vector<BYTE> out(std::max(size * 4u, SECTOR_SIZE));
+		stream.next_in = const_cast<BYTE*>(data);
+		stream.avail_in = (uInt)size;
+		std::size_t used = 0;
+		int status = Z_OK;
+		do {
+			if (used == out.size()) {
+				out.resize(out.size() * 2u);
+			}
+			stream.next_out = out.data() + used;
+			stream.avail_out = (uInt)(out.size() - used);
+			status = inflate(&stream, Z_NO_FLUSH);
+			used = out.size() - stream.avail_out;
+		} while (status == Z_OK);
+		inflateEnd(&stream);
+		if (status != Z_STREAM_END) {
+			throw std::runtime_error("Issue decompressing " + description + "!");
+		}
+		out.resize(used);
+		return out;
+	}
+
+	// Return where in a region file the chunk at (chunkX, chunkZ) is listed.
+	static std::size_t getChunkSlot(int chunkX, int chunkZ) {
+		return (std::size_t)((chunkX - floorDivide(chunkX, REGION_CHUNKS) * REGION_CHUNKS) +
+			(chunkZ - floorDivide(chunkZ, REGION_CHUNKS) * REGION_CHUNKS) * REGION_CHUNKS);
+	}
+
+	// Read a big endian number of size bytes from data at position.
+	static std::size_t readNumber(const std::vector<BYTE> &data, std::size_t position, unsigned int size) {
+		std::size_t value = 0;
+		for (unsigned int i = 0; i < size; i++) {
+			value = (value << BYTE_SIZE) | data[position + i];
+		}
+		return value;
+	}
+
+	// Write value as a big endian number of size bytes into data at position.
+	static void writeNumber(std::vector<BYTE> &data, std::size_t position, std::size_t value, unsigned int size) {
+		for (unsigned int i = size; i > 0; i--) {
+			data[position + i - 1u] = (BYTE)(value & 0xffu);
+			value >>= BYTE_SIZE;
+		}
+	}
+
+	// Read chunk edit out of its region file, build the instruction memory into it, then compress it again, ready to
+	// be stored. Throws an exception if the chunk hasn't been generated or can't be understood.
+	static void buildChunk(ChunkEdit &edit, const RegionFile &region, const Build &build) {
+		const std::string description = "chunk (" + std::to_string(edit.chunkX) + ", " +
+			std::to_string(edit.chunkZ) + ") in " + region.fileName;
+		const std::size_t slot = getChunkSlot(edit.chunkX, edit.chunkZ);
+		const std::size_t start = readNumber(region.data, slot * 4u, 3u) * SECTOR_SIZE;
+		if (start == 0) {
+			throw std::runtime_error("World " + description + " hasn't been generated yet!");
+		}
+		if (start < HEADER_SIZE || start + 5u > region.data.size()) {
+			throw std::runtime_error("World " + description + " is stored outside its region file!");
+		}
+		const std::size_t length = readNumber(region.data, start, 4u);
+		const BYTE compression = region.data[start + 4u];
+		if (length == 0 || length > region.data.size() - start - 4u) {
+			throw std::runtime_error("World " + description + " is cut short!");
+		}
+
+		std::vector<BYTE> nbt;
+		if (compression == COMPRESSION_GZIP || compression == COMPRESSION_ZLIB) {
+			nbt = decompress(region.data.data() + start + 5u, length - 1u, description);
+		}
+		else if (compression == COMPRESSION_NONE) {
+			nbt.assign(region.data.begin() + start + 5u, region.data.begin() + start + 4u + length);
+		}
+		else {
+			throw std::runtime_error("World " + description + (compression & EXTERNAL_CHUNK ?
+				" is too large to edit!" : " uses an unsupported compression type!"));
+		}
+
+		Nbt::Tag root = Nbt::readTag(nbt);
+		editChunk(root, edit.chunkX, edit.chunkZ, build);
+		nbt.clear();
+		Nbt::writeTag(nbt, root);
+
+		// Chunks are always stored back zlib compressed, which is what the game itself uses.
+		uLongf compressedSize = compressBound((uLong)nbt.size());
+		edit.stored.resize(5u + compressedSize);
+		if (compress2(edit.stored.data() + 5u, &compressedSize, nbt.data(), (uLong)nbt.size(),
+			Z_DEFAULT_COMPRESSION) != Z_OK) {
+			throw std::runtime_error("Issue compressing " + description + "!");
+		}
+		edit.stored.resize(5u + compressedSize);
+		writeNumber(edit.stored, 0u, compressedSize + 1u, 4u);
+		edit.stored[4] = COMPRESSION_ZLIB;
+	}
+
+	// Store every edited chunk in region back into it, each in the sectors it used to take up if it still fits in
+	// them, or otherwise in new sectors at the end of the file. Throws an exception if a chunk is too large to store.
+	static void storeChunks(RegionFile &region, const std::vector<ChunkEdit> &edits, std::size_t regionIndex) {
+		const std::uint32_t timestamp = (std::uint32_t)std::time(nullptr);
+		region.data.resize((region.data.size() + SECTOR_SIZE - 1u) / SECTOR_SIZE * SECTOR_SIZE);
+		for (const ChunkEdit &edit : edits) {
+			if (edit.region != regionIndex) {
+				continue;
+			}
+			const std::size_t sectorCount = (edit.stored.size() + SECTOR_SIZE - 1u) / SECTOR_SIZE;
+			if (sectorCount > MAX_CHUNK_SECTORS) {
+				throw std::runtime_error("Chunk (" + std::to_string(edit.chunkX) + ", " + std::to_string(edit.chunkZ) +
+					") is too large to store in " + region.fileName + "!");
+			}
+			const std::size_t slot = getChunkSlot(edit.chunkX, edit.chunkZ);
+			std::size_t sector = readNumber(region.data, slot * 4u, 3u);
+			if (sectorCount > region.data[slot * 4u + 3u]) {
+				sector = region.data.size() / SECTOR_SIZE;
+				region.data.resize(region.data.size() + sectorCount * SECTOR_SIZE);
+			}
+			std::copy(edit.stored.begin(), edit.stored.end(), region.data.begin() + sector * SECTOR_SIZE);
+			std::fill(region.data.begin() + sector * SECTOR_SIZE + edit.stored.size(),
+				region.data.begin() + (sector + sectorCount) * SECTOR_SIZE, (BYTE)0u);
+			writeNumber(region.data, slot * 4u, sector, 3u);
+			region.data[slot * 4u + 3u] = (BYTE)sectorCount;
+			writeNumber(region.data, SECTOR_SIZE + slot * 4u, timestamp, 4u);
+		}
+	}
+
+	// Read in the whole of region file fileName. Throws an exception if it could not be opened or isn't a region
+	// file.
+	static std::vector<BYTE> loadRegionFile(const std::string &fileName) {
+		std::ifstream inFile(fileName, std::ios::binary);
+		if (!inFile.good()) {
+			throw std::runtime_error("Issue opening region file " + fileName + "!");
+		}
+		std::vector<char> bytes((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+		if (bytes.size() < HEADER_SIZE) {
+			throw std::runtime_error("File " + fileName + " isn't a region file!");
+		}
+		return std::vector<BYTE>(bytes.begin(), bytes.end());
+	}
+
+	// Replace region file fileName with data, by writing it to a temporary file and renaming that over it, so that
+	// the region file is never left half written. Throws an exception if it could not be written.
+	static void saveRegionFile(const std::string &fileName, const std::vector<BYTE> &data) {
+		const std::string temporaryFileName = fileName + ".tmp";
+		std::ofstream outFile(temporaryFileName, std::ios::binary);
+		if (!outFile.good()) {
+			throw std::runtime_error("Issue opening output file " + temporaryFileName + "!");
+		}
+		outFile.write((const char*)data.data(), (std::streamsize)data.size());
+		outFile.close();
+		if (!outFile.good()) {
+			std::remove(temporaryFileName.c_str());
+			throw std::runtime_error("Issue writing output file " + temporaryFileName + "!");
+		}
+#ifdef _WIN32
+		// Windows refuses to rename over an existing file.
+		std::remove(fileName.c_str());
+#endif
+		if (std::rename(temporaryFileName.c_str(), fileName.c_str()) != 0) {
+			std::remove(temporaryFileName.c_str());
+			throw std::runtime_error("Issue writing region file " + fileName + "!");
+		}
+	}
+
+	// Build instruction memory with geometry holding machine code into the world whose region files are in
+	// regionDirectory (e.g. saves/<world>/region), with its north west bottom corner at origin, block for block the
+	// same as pasting its schematic there would, and return how many chunks were changed. Chunks are edited at the
+	// same time on threadCount threads, and each region file is replaced only once all of its chunks are done. The
+	// world must be from Minecraft 1.16 or later, must not be open in the game, and must already have every chunk the
+	// instruction memory covers generated. Throws an exception if the geometry isn't valid, if the machine code
+	// doesn't fit in the instruction memory, or if a region file could not be read, understood or written.
+	unsigned int saveToWorld(const std::vector<Instruction> &machineCode, const std::string &regionDirectory,
+		const Position &origin, const IMemSchematic::Geometry &geometry, unsigned int threadCount) {
+		IMemSchematic::checkGeometry(geometry);
+		IMemSchematic::checkFits(machineCode, geometry);
+		if (std::abs(origin.x) > MAX_HORIZONTAL_POSITION || std::abs(origin.z) > MAX_HORIZONTAL_POSITION ||
+			std::abs(origin.y) > MAX_VERTICAL_POSITION) {
+			throw std::runtime_error("Instruction memory can't be built outside the world!");
+		}
+
+		// Every block of the instruction memory, with the torches of every zero bit taken out.
+		Build build;
+		build.origin = origin;
+		build.geometry = geometry;
+		build.blocks = IMemSchematic::getParts(geometry)->body;
+		for (unsigned int i = 0; i < geometry.getInstructionCount(); i++) {
+			for (unsigned int b = 0; b < geometry.wordSize; b++) {
+				bool isOne = i < machineCode.size() && machineCode[i].getBitsInRange(b, b) != 0u;
+				build.blocks[geometry.getTorchIndex(i, b)] = isOne ? REDSTONE_TORCH_OFF : AIR;
+			}
+		}
+		std::vector<bool> isUsed(1u << BYTE_SIZE, false);
+		for (BYTE id : build.blocks) {
+			isUsed[id] = true;
+		}
+		build.blockNames.resize(1u << BYTE_SIZE);
+		for (unsigned int id = 0; id < isUsed.size(); id++) {
+			if (isUsed[id]) {
+				build.blockNames[id] = IMemSchematic::getBlockName((BYTE)id);
+			}
+		}
+
+		// Work out every chunk the instruction memory covers, and read in the region files they're in.
+		std::vector<RegionFile> regions;
+		std::map<std::pair<int, int>, std::size_t> regionIndices;
+		std::vector<ChunkEdit> edits;
+		const int minChunkX = floorDivide(origin.x, SECTION_SIZE);
+		const int maxChunkX = floorDivide(origin.x + (int)geometry.getWidth() - 1, SECTION_SIZE);
+		const int minChunkZ = floorDivide(origin.z, SECTION_SIZE);
+		const int maxChunkZ = floorDivide(origin.z + (int)geometry.getLength() - 1, SECTION_SIZE);
+		for (int chunkZ = minChunkZ; chunkZ <= maxChunkZ; chunkZ++) {
+			for (int chunkX = minChunkX; chunkX <= maxChunkX; chunkX++) {
+				std::pair<int, int> regionPosition(floorDivide(chunkX, REGION_CHUNKS),
+					floorDivide(chunkZ, REGION_CHUNKS));
+				std::map<std::pair<int, int>, std::size_t>::const_iterator found = regionIndices.find(regionPosition);
+				if (found == regionIndices.end()) {
+					RegionFile region;
+					region.fileName = regionDirectory + "/r." + std::to_string(regionPosition.first) + "." +
+						std::to_string(regionPosition.second) + ".mca";
+					region.data = loadRegionFile(region.fileName);
+					regions.push_back(std::move(region));
+					found = regionIndices.insert(std::make_pair(regionPosition, regions.size() - 1u)).first;
+				}
+				ChunkEdit edit;
+				edit.region = found->second;
+				edit.chunkX = chunkX;
+				edit.chunkZ = chunkZ;
+				edits.push_back(edit);
+			}
+		}
+
+		// Chunks are edited independently, so they're all done at the same time, but region files are only written
+		// once every chunk has been edited, so that nothing is changed if any of them can't be.
+		ThreadPool::parallelFor((unsigned int)edits.size(), threadCount, [&](unsigned int i) {
+			buildChunk(edits[i], regions[edits[i].region], build);
+		});
+		for (std::size_t i = 0; i < regions.size(); i++) {
+			storeChunks(regions[i], edits, i);
+		}
+		for (const RegionFile &region : regions) {
+			saveRegionFile(region.fileName, region.data);
+		}
+		return (unsigned int)edits.size();
+	}
+}
@@ -0,0 +1,36 @@
+#include <string>
+#include <vector>
+#include "Instruction.h"
+#include "IMemSchematic.h"
+
+#ifndef REGION_FILES_H
+#define REGION_FILES_H
+
+// Writes assembled machine code straight into the region files (.mca, Minecraft's Anvil format) of a saved world, so
+// that a program can be put into in-game instruction memory without WorldEdit or a running server. Only the chunks
+// the instruction memory covers are decompressed, edited and compressed again; the rest of every region file is left
+// as it was.
+namespace RegionFiles {
+	// A block position in a world.
+	struct Position {
+		int x = 0;
+		int y = 0;
+		int z = 0;
+	};
+
+	// Return the position described by text, which is <x>,<y>,<z> (e.g. -929,82,641). Throws an exception if text
+	// isn't in that form.
+	Position parsePosition(const std::string &text);
+	// Build instruction memory with geometry holding machine code into the world whose region files are in
+	// regionDirectory (e.g. saves/<world>/region), with its north west bottom corner at origin, block for block the
+	// same as pasting its schematic there would, and return how many chunks were changed. Chunks are edited at the
+	// same time on threadCount threads, and each region file is replaced only once all of its chunks are done. The
+	// world must be from Minecraft 1.16 or later, must not be open in the game, and must already have every chunk the
+	// instruction memory covers generated. Throws an exception if the geometry isn't valid, if the machine code
+	// doesn't fit in the instruction memory, or if a region file could not be read, understood or written.
+	unsigned int saveToWorld(const std::vector<Instruction> &machineCode, const std::string &regionDirectory,
+		const Position &origin, const IMemSchematic::Geometry &geometry = IMemSchematic::Geometry(),
+		unsigned int threadCount = 1u);
+};
+
+#endif
@@ -41,3 +41,8 @@ void RegisterFile::unsafeWrite(BYTE regID, WORD value) {
 	// Now that we know we're good, set the value.
 	RegisterFile::registers[(unsigned int)regID] = value;
 }
+
+// Set every register back to zero.
+void RegisterFile::reset() {
+	RegisterFile::registers.assign(NUMBER_OF_REGISTERS, 0);
+}
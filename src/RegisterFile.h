@@ -28,6 +28,8 @@ public:
 	// Writes a 16 bit value to the register with regID, regardless of whether or not this register should be 
 	// mutable. 
 	static void unsafeWrite(BYTE regID, WORD value);
+	// Set every register back to zero.
+	static void reset();
 private:
 	// Array of words, where an index i represents the register with id i.
 	static std::vector<WORD> registers;
@@ -20,312 +20,933 @@
 #include <map>
 #include <set>
 #include <functional>
+#include <sstream>
 #include <string.h>
-#include "Parser.h"
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <cstdio>
 #include "Instruction.h"
-#include "InstructionWriter.h"
-#include "zlib.h"
-#include "IMemSchemConstants.h"
-
-// Passes over source code file recording constants and labels as they come up into their respective InstructionWriter
-// static maps. This can be thought of the first pass over the source code. Takes in a ifstream referring to the source
-// code file.
-void findConstantsAndLabels(std::ifstream &sourceFile) {
-	// Keeps track of which instruction we're currently on, starting at zero.
-	unsigned int instructionNumber = 0;
-	// Current line of file.
-	std::string line;
-	// Keeps track of line number.
-	unsigned int lineNumber = 0;
-	while (std::getline(sourceFile, line)) {
-		// Increment line number.
-		lineNumber++;
+#include "Assembler.h"
+#include "ThreadPool.h"
+#include "AssemblyCache.h"
+#include "IncrementalAssembler.h"
+#include "ModuleCache.h"
+#include "Hash.h"
+#include "OutputFiles.h"
+#include "BinaryFile.h"
+#include "Linker.h"
+#include "ProgramEditor.h"
+#include "DataflowOptimizer.h"
+#include "CycleEstimator.h"
+#include "ExecutionProfile.h"
+#include "Listing.h"
+#include "RegionFiles.h"
+
+// How often watch mode checks whether the source file has changed, in milliseconds.
+#define WATCH_POLL_INTERVAL_MS 100u
+
+// Everything needed to assemble one source file, along with everything that came out of doing so. Jobs are filled in
+// by worker threads and only looked at by the main thread once all of them are done.
+struct AssemblyJob {
+	// Name of the source file to assemble.
+	std::string inputFileName;
+	// Name of the shroom16 binary file to write, or empty if we shouldn't write one.
+	std::string binaryFileName;
+	// Name of the schematic file to write, or empty if we shouldn't write one.
+	std::string schematicFileName;
+	// Name of the preview schematic of data memory to write next to the schematic when the program has initial data
+	// (see OutputFiles::saveDataSchematicFile()), or empty if we shouldn't write one.
+	std::string dataSchematicFileName;
+	// Zlib compression level to write the schematic with (0 to 9, or Z_DEFAULT_COMPRESSION).
+	int schematicCompressionLevel = Z_DEFAULT_COMPRESSION;
+	// Number of threads to compress the schematic on.
+	unsigned int schematicThreadCount = 1u;
+	// Shape of the instruction memory to write the schematic for.
+	IMemSchematic::Geometry schematicGeometry;
+	// Name of the object file to write, or empty if we shouldn't write one. When writing an object file, the source
+	// is assembled as relocatable code to be linked later, and nothing else is written.
+	std::string objectFileName;
+	// Name of the listing file to write, or empty if we shouldn't write one.
+	std::string listingFileName;
+	// Name of the .mcfunction file of commands to place the program with, or empty if we shouldn't write one.
+	std::string functionFileName;
+	// Name of the patch file to write, or empty if we shouldn't write one, and the program already deployed in-game
+	// that the patch brings up to date.
+	std::string patchFileName;
+	std::vector<Instruction> deployedCode;
+	// Directory of the region files of the world to build the program into, or empty if we shouldn't, and where in
+	// that world the north west bottom corner of its instruction memory is.
+	std::string worldDirectory;
+	RegionFiles::Position worldOrigin;
+	// Every problem found while assembling or writing this program, already formatted for printing.
+	std::vector<std::string> messages;
+	// Anything else worth telling the user about this program (e.g. how much space was saved), ready for printing.
+	std::vector<std::string> notes;
+	// Binary instruction dump for this program, if one was asked for.
+	std::string instructionDump;
+	// Register liveness of every basic block in this program, if it was asked for.
+	std::string livenessReport;
+	// Estimate of how many ticks every routine in this program takes, if it was asked for.
+	std::string cycleReport;
+	// True iff every output was copied out of the assembly cache rather than assembled.
+	bool wasCached = false;
+};
+
+// Return a short tag describing the options that change what the assembler outputs (e.g. "-strip"), or an empty 
+// string if there aren't any. This keeps outputs assembled with different options apart in the cache.
+std::string describeOptions(const Assembler::Options &options) {
+	std::string tag;
+	if (options.optimizeForSize) {
+		tag += "-Os";
+	}
+	else if (options.optimizationLevel > 0) {
+		tag += "-O" + std::to_string(options.optimizationLevel);
+	}
+	if (options.removeUnreachableCode) {
+		tag += "-strip";
+	}
+	// Outputs laid out using one profile are no good for any other.
+	if (options.profile != nullptr) {
+		std::uint64_t hash = Hash::fnv1a(options.profile->programHash);
+		hash = Hash::fnv1aBytes(options.profile->executionCounts.data(), 
+			options.profile->executionCounts.size() * sizeof(std::uint64_t), hash);
+		hash = Hash::fnv1aBytes(options.profile->takenCounts.data(), 
+			options.profile->takenCounts.size() * sizeof(std::uint64_t), hash);
+		tag += "-profile" + Hash::toHexString(hash);
+	}
+	return tag;
+}
 
-		// Remove comment from line.
-		Parser::stripComment(line);
+// Remove the data schematic of job, if there is one, so that it isn't mistaken for data belonging to its program.
+void removeDataFiles(const AssemblyJob &job) {
+	if (!job.dataSchematicFileName.empty()) {
+		std::remove(job.dataSchematicFileName.c_str());
+	}
+}
+
+// Write the data schematic of job holding dataImage, the initial data memory of its program, or remove it if the
+// program doesn't have any data. The data for the VM goes in the binary itself. Throws an exception if the file
+// could not be written.
+void saveDataFiles(const AssemblyJob &job, const std::vector<std::uint16_t> &dataImage) {
+	if (dataImage.empty()) {
+		removeDataFiles(job);
+		return;
+	}
+	if (!job.dataSchematicFileName.empty()) {
+		OutputFiles::saveDataSchematicFile(dataImage, job.dataSchematicFileName, job.schematicCompressionLevel,
+			job.schematicThreadCount);
+	}
+}
 
-		// Parse line to examine its formatted components.
-		std::vector<std::string> parsedLine;
-		Parser::parseLine(line, parsedLine);
+// Keys every output of a job is cached under.
+struct CacheKeys {
+	std::string binary;
+	std::string schematic;
+	std::string function;
+	std::string object;
+	std::string listing;
+};
+
+// Return the keys the outputs of job, assembled from source with options described by optionsTag, are cached under,
+// given the context (see AssemblyCache::describeContext()) of where the source is and what it included.
+CacheKeys computeCacheKeys(const AssemblyJob &job, const std::string &source, const std::string &optionsTag,
+	const std::string &context) {
+	// Schematics compressed differently have different contents, even though they decompress to the same thing, and
+	// schematics for other shapes of instruction memory are different altogether.
+	const std::string compressionTag = job.schematicCompressionLevel == Z_DEFAULT_COMPRESSION ? "" :
+		"-z" + std::to_string(job.schematicCompressionLevel);
+	const std::string geometryTag = job.schematicGeometry == IMemSchematic::Geometry() ? "" :
+		"-rom" + job.schematicGeometry.describe();
+	CacheKeys keys;
+	keys.binary = AssemblyCache::computeKey(source, optionsTag + ".shroombin", context);
+	keys.schematic = AssemblyCache::computeKey(source, optionsTag + compressionTag + geometryTag + ".schem", context);
+	keys.function = AssemblyCache::computeKey(source, optionsTag + geometryTag + ".mcfunction", context);
+	keys.object = AssemblyCache::computeKey(source, optionsTag + ".shroomobj", context);
+	// Listings are headed by the input file's name as it was given, which is different for every way of naming it.
+	keys.listing = AssemblyCache::computeKey(source, optionsTag + ".lst", context + job.inputFileName + "\n");
+	return keys;
+}
 
-		// If line is empty, move on.
-		if (parsedLine.size() == 0) {
-			continue;
-		}
+// Assemble a single source file with the given options and write all of its outputs, recording any problems in the
+// job rather than halting, so that one bad program doesn't stop the rest of a batch. If cache is not null, outputs
+// are copied straight out of it when the source hasn't changed, and freshly written outputs are added to it. Safe to
+// call on many jobs at once from different threads, all sharing moduleCache so that files included by many programs
+// are only parsed once.
+void runAssemblyJob(AssemblyJob &job, const Assembler::Options &baseOptions, bool doDumpInstructions, 
+	bool doReportLiveness, bool doReportCycles, const AssemblyCache *cache, ModuleCache &moduleCache) {
+	// Attempt to open specified file.
+	std::ifstream sourceFile(job.inputFileName);
+	// Make sure input file is good.
+	if (!sourceFile.good()) {
+		job.messages.push_back("Error: invalid file " + job.inputFileName + "!");
+		return;
+	}
 
-		// Try to add label, if applicable.
+	// Read the whole source file into memory and close it, since the assembler works on in-memory source.
+	std::ostringstream sourceBuffer;
+	sourceBuffer << sourceFile.rdbuf();
+	sourceFile.close();
+	const std::string source = sourceBuffer.str();
+
+	// Key of the list of files the source included, which only depends on the source and where it is. The keys of
+	// our outputs also depend on the options, the kind of output, and the files included.
+	const std::string optionsTag = describeOptions(baseOptions);
+	const std::string includesKey = AssemblyCache::computeKey(source, ".includes",
+		AssemblyCache::describeContext(job.inputFileName, {}));
+	// If every output we need is already cached, all we need to do is copy them out. Instruction dumps, liveness
+	// reports, cycle estimates, patches and worlds need the actual assembled program, so those always skip the cache.
+	// So do data schematics, since programs with one are never stored and we can't tell whether the program has data.
+	std::vector<Assembler::IncludedFile> includedFiles;
+	if (cache != nullptr && !doDumpInstructions && !doReportLiveness && !doReportCycles && job.patchFileName.empty() &&
+		job.worldDirectory.empty() && job.dataSchematicFileName.empty() &&
+		cache->fetchIncludes(includesKey, includedFiles)) {
 		try {
-			// If line is a label (labels start with ':'), add it along with current instruction number to
-			// map, then move on.
-			if (parsedLine[0][0] == ':') {
-				InstructionWriter::defineLabel(parsedLine[0].substr(1, parsedLine[0].size() - 1), 
-					instructionNumber);
-				continue;
+			const CacheKeys keys = computeCacheKeys(job, source, optionsTag,
+				AssemblyCache::describeContext(job.inputFileName, includedFiles));
+			bool binaryCached = job.binaryFileName.empty() || cache->fetch(keys.binary, job.binaryFileName);
+			bool schematicCached = job.schematicFileName.empty() || 
+				cache->fetch(keys.schematic, job.schematicFileName);
+			bool functionCached = job.functionFileName.empty() || cache->fetch(keys.function, job.functionFileName);
+			bool objectCached = job.objectFileName.empty() || cache->fetch(keys.object, job.objectFileName);
+			bool listingCached = job.listingFileName.empty() || cache->fetch(keys.listing, job.listingFileName);
+			if (binaryCached && schematicCached && functionCached && objectCached && listingCached) {
+				job.wasCached = true;
+				return;
 			}
 		}
 		catch (std::exception &e) {
-			// If an excpetion was thrown as we we're trying to handle labels, print error message and 
-			// halt.
-			std::cerr << "Error on line " << lineNumber << ": " << e.what() << std::endl;
-			exit(-1);
+			job.messages.push_back(std::string("Error: ") + e.what());
+			return;
 		}
+	}
 
-		try {
-			// If line is a directive, see if it's a constant definition, add to map if it is, then move on
-			// either way.
-			if (parsedLine[0][0] == ';') {
-				if (parsedLine[0] == ";const") {
-					// Check if complete constant definition was given, if not throw excpetion.
-					if (parsedLine.size() != 3) {
-						throw std::runtime_error("Invalid number of directive arguments.");
-					}
+	// Actually assemble the program. If anything went wrong, record every problem found and move on.
+	Assembler::Options options = baseOptions;
+	options.sourceFileName = job.inputFileName;
+	options.moduleCache = &moduleCache;
+	options.relocatable = !job.objectFileName.empty();
+	Assembler::Result assembled = Assembler::assemble(source, options);
+	if (!assembled.succeeded()) {
+		for (const Assembler::Diagnostic &diagnostic : assembled.diagnostics) {
+			job.messages.push_back(Assembler::formatDiagnostic(diagnostic));
+		}
+		return;
+	}
+	if (assembled.optimizedInstructionCount > 0) {
+		job.notes.push_back("Optimized away " + std::to_string(assembled.optimizedInstructionCount) +
+			" instructions.");
+	}
+	if (assembled.inlinedCallCount > 0) {
+		job.notes.push_back("Inlined " + std::to_string(assembled.inlinedCallCount) + " subroutine calls.");
+	}
+	if (assembled.outlinedSequenceCount > 0) {
+		job.notes.push_back("Moved " + std::to_string(assembled.outlinedSequenceCount) + 
+			" repeated runs of instructions out into subroutines, saving " + 
+			std::to_string(assembled.outlinedInstructionCount) + " instructions (" + 
+			std::to_string(assembled.machineCode.size()) + " of " + std::to_string(INSTRUCTION_MEMORY_SIZE) + 
+			" instruction slots now used). In exchange, " + std::to_string(assembled.outlinedCallCount) + 
+			" places now run a call and a jr more each time.");
+	}
+	if (assembled.profileIsOutdated) {
+		job.notes.push_back("Profile was recorded running a different version of this program, so it was ignored. "
+			"Run the program again with shroomvm -p to update it.");
+	}
+	if (assembled.straightenedJumpCount > 0) {
+		job.notes.push_back("Laid out code to suit the profile, so " + 
+			std::to_string(assembled.straightenedJumpCount) + " jumps now fall through.");
+	}
+	if (assembled.removedInstructionCount > 0) {
+		job.notes.push_back("Removed " + std::to_string(assembled.removedInstructionCount) + 
+			" unreachable instructions (" + std::to_string(assembled.machineCode.size()) + " of " + 
+			std::to_string(INSTRUCTION_MEMORY_SIZE) + " instruction slots now used).");
+	}
 
-					// Attempt to define constant.
-					InstructionWriter::defineConstant(parsedLine[1], parsedLine[2]);
-				}
-				else {
-					// Otherwise, we have an undefined directive.
-					throw std::runtime_error("Unknown directive " + parsedLine[0] + ".");
-				}
-				continue;
+	// If we should dump our instructions, do it.
+	if (doDumpInstructions) {
+		std::ostringstream dump;
+		for (unsigned int i = 0; i < assembled.machineCode.size(); i++) {
+			dump << assembled.sourceLocations[i].text << ":    " 
+				<< assembled.machineCode[i].formattedAsString() << std::endl;
+		}
+		job.instructionDump = dump.str();
+	}
+	// Same for the liveness report, which describes the program as it'll actually run (i.e. after optimizing).
+	if (doReportLiveness) {
+		ProgramEditor editor(assembled);
+		job.livenessReport = DataflowOptimizer::describeLiveness(editor);
+	}
+	// Same for the cycle estimate, which also checks every routine against its ;budget.
+	if (doReportCycles) {
+		std::vector<CycleEstimator::RoutineEstimate> estimates = CycleEstimator::estimateRoutines(assembled);
+		job.cycleReport = CycleEstimator::describeEstimates(estimates);
+		for (const CycleEstimator::RoutineEstimate &estimate : estimates) {
+			if (estimate.isOverBudget()) {
+				job.notes.push_back("Warning: routine " + estimate.name + " might take longer than its budget of " +
+					std::to_string(estimate.budget) + " ticks!");
 			}
 		}
-		catch (std::exception &e) {
-			// If an excpetion was thrown as we we're trying to handle constants, print error message and
-			// halt.
-			std::cerr << "Directive error on line " << lineNumber << ": " << e.what() << std::endl;
-			exit(-1);
+	}
+
+	// Now that we have our machine code, make a shroom16 binary and/or a .schem for use in Minecraft, or an object
+	// file for the linker. The cache only keeps one file per output, so programs with a data schematic alongside their
+	// schematic are never stored in it.
+	if (!assembled.dataImage.empty() && !job.dataSchematicFileName.empty()) {
+		cache = nullptr;
+	}
+	const CacheKeys keys = computeCacheKeys(job, source, optionsTag,
+		AssemblyCache::describeContext(job.inputFileName, assembled.includedFiles));
+	try {
+		saveDataFiles(job, assembled.dataImage);
+		if (cache != nullptr) {
+			cache->storeIncludes(includesKey, assembled.includedFiles);
+		}
+		if (!job.binaryFileName.empty()) {
+			BinaryFile::saveBinary(BinaryFile::makeBinary(assembled), job.binaryFileName);
+			if (cache != nullptr) {
+				cache->store(keys.binary, job.binaryFileName);
+			}
+		}
+		if (!job.schematicFileName.empty()) {
+			// Schematics are the slowest output to write by far, so say how long they took.
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			OutputFiles::saveSchematicFile(assembled.machineCode, job.schematicFileName, 
+				job.schematicCompressionLevel, job.schematicThreadCount, job.schematicGeometry);
+			std::ostringstream milliseconds;
+			milliseconds << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			job.notes.push_back("Wrote " + job.schematicFileName + " in " + milliseconds.str() + " ms.");
+			if (cache != nullptr) {
+				cache->store(keys.schematic, job.schematicFileName);
+			}
+		}
+		if (!job.functionFileName.empty()) {
+			OutputFiles::saveFunctionFile(assembled.machineCode, job.functionFileName, job.schematicGeometry);
+			if (cache != nullptr) {
+				cache->store(keys.function, job.functionFileName);
+			}
+		}
+		if (!job.objectFileName.empty()) {
+			Linker::saveObjectFile(Linker::makeObjectFile(assembled), job.objectFileName);
+			if (cache != nullptr) {
+				cache->store(keys.object, job.objectFileName);
+			}
+		}
+		if (!job.listingFileName.empty()) {
+			Listing::saveListing(assembled, job.inputFileName, job.listingFileName);
+			if (cache != nullptr) {
+				cache->store(keys.listing, job.listingFileName);
+			}
+		}
+		if (!job.patchFileName.empty()) {
+			unsigned int changeCount = OutputFiles::saveSchematicPatch(job.deployedCode, assembled.machineCode,
+				job.patchFileName, job.schematicGeometry);
+			job.notes.push_back("Wrote " + job.patchFileName + ", changing " + std::to_string(changeCount) +
+				" torches from the deployed program.");
+		}
+		if (!job.worldDirectory.empty()) {
+			unsigned int chunkCount = RegionFiles::saveToWorld(assembled.machineCode, job.worldDirectory,
+				job.worldOrigin, job.schematicGeometry, job.schematicThreadCount);
+			job.notes.push_back("Built the program into " + std::to_string(chunkCount) + " chunks of " +
+				job.worldDirectory + ".");
 		}
+	}
+	catch (std::exception &e) {
+		job.messages.push_back(std::string("Error: ") + e.what());
+	}
+}
 
-		// Otherwise, line is a instruction that will make it to instruction memory, and we need to increment 
-		// our position.
-		instructionNumber++;
+// Move the freshly written file temporaryFileName into place as fileName, replacing whatever was there before in one
+// go. Throws an exception if the file could not be moved.
+void replaceFile(const std::string &temporaryFileName, const std::string &fileName) {
+#ifdef _WIN32
+	// Windows refuses to rename over an existing file.
+	std::remove(fileName.c_str());
+#endif
+	if (std::rename(temporaryFileName.c_str(), fileName.c_str()) != 0) {
+		std::remove(temporaryFileName.c_str());
+		throw std::runtime_error("Issue writing output file " + fileName + "!");
 	}
+}
 
-	// Reset source code file stream.
-	sourceFile.clear();
-	sourceFile.seekg(0);
+// Return a snapshot of the current contents of every file in includedFiles, which changes whenever any of them does.
+std::string snapshotIncludedFiles(const std::vector<Assembler::IncludedFile> &includedFiles) {
+	std::string snapshot;
+	for (const Assembler::IncludedFile &includedFile : includedFiles) {
+		std::ifstream file(includedFile.fileName);
+		std::ostringstream contents;
+		if (file.good()) {
+			contents << file.rdbuf();
+		}
+		// Hashing each file keeps the snapshot small, and a missing file hashes differently to any real one.
+		snapshot += (file.good() ? Hash::toHexString(Hash::fnv1a(contents.str())) : "missing") + "\n";
+	}
+	return snapshot;
 }
 
-// Write machine code data to gzip file data buffer one byte at a time (from the zlib library) then, if all goes 
-// according to plan, actually write the data buffer to the file. Requires that the outFile is a valid zlib gzip file.
-// Throws an excpetion if byte of data could not be wirtten or if we cannot flush teh data buffer to the file.
-void saveSchematic(const std::vector<Instruction> &machineCode, gzFile outFile) {
-	// Write header of our schematic file, which sets everything up. This is the same for every program.
-	for (BYTE byte : I_MEM_HEADER) {
-		// Ensure one and only one (onee) byte is written to the file. If not throw an exception.
-		if (gzwrite(outFile, (voidpc)&byte, 1u) != 1u) {	
-			throw std::runtime_error("Issue writing machine code byte to gzip data buffer!");
+// Keep the assembler resident, assembling the job's source file with the given options again every time it or any
+// file it includes changes until the program is killed. Only the lines and instructions affected by each change are
+// redone. Outputs are written to a temporary file and then moved into place, so anything watching them (e.g. 
+// shroomvm -r) never sees a half written file.
+void watchAssemblyJob(const AssemblyJob &job, const Assembler::Options &baseOptions) {
+	Assembler::Options options = baseOptions;
+	options.sourceFileName = job.inputFileName;
+	IncrementalAssembler assembler(options);
+	// Source, the files it included, and a snapshot of those files, as of the last time we assembled it.
+	std::string lastSource;
+	std::vector<Assembler::IncludedFile> includedFiles;
+	std::string lastIncludedFiles;
+	bool haveAssembled = false;
+	std::cout << "Watching " << job.inputFileName << " for changes (press Ctrl+C to stop)." << std::endl;
+	while (true) {
+		// Check if the source has changed. Sources are small enough that just reading them is cheap, and unlike
+		// modification times this can't miss two saves in quick succession.
+		std::ifstream sourceFile(job.inputFileName);
+		if (sourceFile.good()) {
+			std::ostringstream sourceBuffer;
+			sourceBuffer << sourceFile.rdbuf();
+			sourceFile.close();
+			if (!haveAssembled || sourceBuffer.str() != lastSource || 
+				snapshotIncludedFiles(includedFiles) != lastIncludedFiles) {
+				lastSource = sourceBuffer.str();
+				haveAssembled = true;
+
+				// Assemble the new version, only redoing what changed.
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				const Assembler::Result &assembled = assembler.update(lastSource);
+				includedFiles = assembled.includedFiles;
+				lastIncludedFiles = snapshotIncludedFiles(includedFiles);
+				if (!assembled.succeeded()) {
+					for (const Assembler::Diagnostic &diagnostic : assembled.diagnostics) {
+						std::cerr << Assembler::formatDiagnostic(diagnostic) << std::endl;
+					}
+				}
+				else {
+					try {
+						// Data goes first, so the schematic never sits next to data from an older version.
+						saveDataFiles(job, assembled.dataImage);
+						if (!job.binaryFileName.empty()) {
+							BinaryFile::saveBinary(BinaryFile::makeBinary(assembled), job.binaryFileName + ".tmp");
+							replaceFile(job.binaryFileName + ".tmp", job.binaryFileName);
+						}
+						// Schematics are already moved into place in one go by saveSchematicFile() itself.
+						if (!job.schematicFileName.empty()) {
+							OutputFiles::saveSchematicFile(assembled.machineCode, job.schematicFileName,
+								job.schematicCompressionLevel, job.schematicThreadCount, job.schematicGeometry);
+						}
+						if (!job.functionFileName.empty()) {
+							OutputFiles::saveFunctionFile(assembled.machineCode, job.functionFileName + ".tmp",
+								job.schematicGeometry);
+							replaceFile(job.functionFileName + ".tmp", job.functionFileName);
+						}
+						if (!job.listingFileName.empty()) {
+							Listing::saveListing(assembled, job.inputFileName, job.listingFileName + ".tmp");
+							replaceFile(job.listingFileName + ".tmp", job.listingFileName);
+						}
+						if (!job.patchFileName.empty()) {
+							OutputFiles::saveSchematicPatch(job.deployedCode, assembled.machineCode,
+								job.patchFileName + ".tmp", job.schematicGeometry);
+							replaceFile(job.patchFileName + ".tmp", job.patchFileName);
+						}
+						double milliseconds = std::chrono::duration<double, std::milli>(
+							std::chrono::steady_clock::now() - start).count();
+						std::cout << "Assembled " << assembled.machineCode.size() << " instructions ("
+							<< assembler.getRetokenizedLineCount() << " lines parsed, "
+							<< assembler.getReencodedInstructionCount() << " instructions encoded";
+						if (assembled.optimizedInstructionCount > 0) {
+							std::cout << ", " << assembled.optimizedInstructionCount << " optimized away";
+						}
+						if (assembled.inlinedCallCount > 0) {
+							std::cout << ", " << assembled.inlinedCallCount << " calls inlined";
+						}
+						if (assembled.outlinedInstructionCount > 0) {
+							std::cout << ", " << assembled.outlinedInstructionCount << " saved by outlining";
+						}
+						if (assembled.removedInstructionCount > 0) {
+							std::cout << ", " << assembled.removedInstructionCount << " unreachable removed";
+						}
+						if (assembled.straightenedJumpCount > 0) {
+							std::cout << ", " << assembled.straightenedJumpCount << " jumps straightened";
+						}
+						if (assembled.profileIsOutdated) {
+							std::cout << ", profile outdated";
+						}
+						std::cout << ") in " << milliseconds << " ms." << std::endl;
+					}
+					catch (std::exception &e) {
+						std::cerr << "Error: " << e.what() << std::endl;
+					}
+				}
+			}
 		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_POLL_INTERVAL_MS));
 	}
+}
 
-	// Write the block data.
-	// First grab the data from our header file.
-	std::vector<BYTE> body(I_MEM_BODY);
+// Return fileName with its extension (if any) replaced by extension, e.g. ("progs/fib.asm", ".schem") gives 
+// "progs/fib.schem".
+std::string replaceExtension(const std::string &fileName, const std::string &extension) {
+	std::size_t dot = fileName.find_last_of('.');
+	std::size_t slash = fileName.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		return fileName + extension;
+	}
+	return fileName.substr(0, dot) + extension;
+}
 
-	// Now, go through all of our instructions, modifying the block data as we go (in the body). I.e. for each bit,
-	// either place a redstone torch if it's a one, or place air if it's zero.
-	for (unsigned int i = 0; i < machineCode.size(); i++) {
-		for (unsigned int b = 0; b < INSTRUCTION_SIZE; b++) {
-			// Place a torch if bit is one, place air if bit is zero.
-			body[BLOCK_DATA_INDEX_FROM_INSTR(i, b)] = 
-				machineCode[i].getBitState(b) ? REDSTONE_TORCH_OFF : AIR;
-		}
+// Read a manifest file listing source files to assemble, one per line, into inputFileNames. Blank lines and lines
+// starting with '#' are ignored. Relative paths are taken relative to the directory the manifest is in. Throws an
+// exception if the manifest could not be opened.
+void readManifest(const std::string &manifestFileName, std::vector<std::string> &inputFileNames) {
+	std::ifstream manifestFile(manifestFileName);
+	if (!manifestFile.good()) {
+		throw std::runtime_error("invalid manifest file " + manifestFileName + "!");
 	}
 
-	// Now actually write the block data body,
-	for (BYTE byte : body) {
-		// Ensure one and only one (onee) byte is written to the file. If not throw an exception.
-		if (gzwrite(outFile, (voidpc)&byte, 1u) != 1u) {	
-			throw std::runtime_error("Issue writing machine code byte to gzip data buffer!");
+	// Find the directory containing the manifest, including its trailing slash.
+	std::size_t slash = manifestFileName.find_last_of("/\\");
+	std::string manifestDirectory = slash == std::string::npos ? "" : manifestFileName.substr(0, slash + 1);
+
+	std::string line;
+	while (std::getline(manifestFile, line)) {
+		// Trim whitespace from both ends of the line.
+		std::size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#') {
+			continue;
 		}
-	}
+		std::size_t last = line.find_last_not_of(" \t\r");
+		line = line.substr(first, last - first + 1);
 
-	// Write footer of our schematic file. This is the same for every file.
-	for (BYTE byte : I_MEM_FOOTER) {
-		// Ensure one and only one (onee) byte is written to the file. If not throw an exception.
-		if (gzwrite(outFile, (voidpc)&byte, 1u) != 1u) {	
-			throw std::runtime_error("Issue writing machine code byte to gzip data buffer!");
+		// Make relative paths relative to the manifest.
+		if (line[0] != '/' && line[0] != '\\' && (line.size() < 2 || line[1] != ':')) {
+			line = manifestDirectory + line;
 		}
-	}
-	
-	// Actually flush data buffer to gzip file. Throw exception if we fail.
-	if (gzflush(outFile, Z_FINISH) != Z_OK) {
-		throw std::runtime_error("Issue writing gzip data buffer to file!");	
+		inputFileNames.push_back(line);
 	}
 }
 
 int main(int argc, char *argv[]) {
 	// Check proper command line argument format.
-	std::string usagemessage = " <input file> <optional arguments>\nOptional arguments:\n -o <name>       "
-		"Specify output file name.\n -g              Output a .schem file (Sponge ver. 3) to be pasted into "
-		"in-game instruction memory (instead of a shroom16 binary file for use in the"
-		" VM).\n -b              Output binary instructions to stdout before writing to a file (little "
-		"endian).\n";
+	std::string usagemessage = " <input files> <optional arguments>\nOptional arguments:\n -o <name>       "
+		"Specify output file name (only when assembling a single file).\n -g              Output a .schem file "
+		"(Sponge ver. 3) to be pasted into in-game instruction memory (instead of a shroom16 binary file for use "
+		"in the VM).\n -G              Output both a .schem file and a shroom16 binary file.\n"
+		" -f              Output a .mcfunction file of setblock and fill commands that place the program into "
+		"already built in-game instruction memory, for servers without WorldEdit (instead of a shroom16 binary "
+		"file, unless -G is given too). Run it from where the .schem file is pasted.\n -b              "
+		"Output binary instructions to stdout before writing to a file (little endian).\n -l              "
+		"Also write a .lst listing file showing every instruction's address, encoding, decoded fields, jump "
+		"target and tick cost next to its source, followed by every label and constant.\n -m <manifest>   "
+		"Also assemble every source file listed (one per line) in the manifest file.\n -j <threads>    Number "
+		"of programs to assemble at once (defaults to the number of hardware threads).\n --cache <dir>   Reuse "
+		"outputs cached in the directory for programs that haven't changed, and cache new outputs there.\n"
+		" -z <level>      Compression level for .schem files, from 0 (fastest) to 9 (smallest). Defaults to 6.\n"
+		" --rom <geometry> Shape of the instruction memory to output .schem files for, as <layers>x<instructions "
+		"per layer>x<bits>, optionally followed by x<bit spacing>x<instruction spacing>. Defaults to the standard "
+		"8x64x32.\n"
+		" --patch <file>  Also write a .patch.mcfunction file of setblock commands that changes only the torches "
+		"that differ between the program deployed in-game (the shroom16 binary file given) and this one, to be run "
+		"from where the .schem file is pasted.\n"
+		" --world <dir>   Also build the program, along with the rest of its instruction memory, straight into the "
+		"region files in the directory (saves/<world>/region of a world from Minecraft 1.16 or later, which must "
+		"not be open in the game). Needs --origin.\n"
+		" --origin <x,y,z> Where in the world the north west bottom corner of the instruction memory goes.\n"
+		" --watch         Keep running, assembling the input file again every time it changes.\n"
+		" -c              Output a .shroomobj object file to be linked with others by shroomld, instead of a "
+		"program. Jumps to labels defined in other object files are allowed.\n"
+		" --strip         Remove code that can never run (e.g. library subroutines the program never calls) to "
+		"save instruction memory.\n"
+		" -O              Optimize the program once it's assembled (e.g. removing instructions that do nothing and "
+		"jumps to jumps) so that it runs faster.\n"
+		" -O2             Optimize harder, also deciding conditional jumps whose outcome is known in advance and "
+		"removing writes to registers that are never read, and copying small subroutines that don't call anything into "
+		"the places they're called from.\n"
+		" -Os             Optimize for size rather than speed, also moving runs of instructions repeated throughout "
+		"the program out into shared subroutines so that it fits into instruction memory.\n"
+		" --liveness      Output which registers are live going into and out of every basic block of the program.\n"
+		" --cycles        Output an estimate of the worst case and typical redstone ticks taken by every routine of "
+		"the program (needing a ;bound <label> <times> directive for every loop), flagging any that might go over a "
+		";budget <label> <ticks> directive.\n"
+		" --profile <file> Lay the program out so the jumps taken most often in the profile (recorded with "
+		"shroomvm -p) fall through instead.\n"
+		" --data-schem    Also write a .data.schem file next to the .schem file for programs with initial data "
+		"memory. This is only a preview: a torch ROM laid out like instruction memory, with one 16 bit word of data "
+		"memory per slot, which no in-game build reads from yet.\n"
+		"Programs that give initial data memory with ;data <address> and ;word <value> ... directives keep it in "
+		"the shroom16 binary file.\n"
+		"When more than one "
+		"file is assembled, each output is named after its input file.\n";
 	// Check number of arguments.
 	if (argc < 2) {
 		std::cerr << "Error: please specify input file!\n" << "\nUsage: " << argv[0] << usagemessage;
 		return -1;
 	}
-	
-	// Attempt to open specified file.
-	std::ifstream sourceFile(argv[1]);
-	// Make sure input file is good.
-	if (!sourceFile.good()) {
-		std::cerr << "Error: invalid file " << argv[1] << "!\n" << "\nUsage: " << argv[0] << usagemessage;
-		return -1;
-	}
 
-	// Name of output file.
-	std::string outFileName = "out.shroombin";
+	// Name of output file, or empty if none was given.
+	std::string outFileName;
+	// Names of all the source files we've been asked to assemble.
+	std::vector<std::string> inputFileNames;
 
 	// true = output schematic file for use in game, false = output shroom16 binary file for use with vm.
 	bool doOutputSchem = false;
+	// true = output a shroom16 binary file alongside the schematic file.
+	bool doOutputBoth = false;
+	// true = output a .mcfunction file of commands that place the program in game.
+	bool doOutputFunction = false;
 	// true = output binary instructions to stdout before writing them to the file, false = don't do that.
 	bool doDumpInstructions = false;
+	// true = write a listing file alongside the other outputs.
+	bool doOutputListing = false;
+	// true = write a preview schematic of data memory next to the schematic of programs with initial data.
+	bool doOutputDataSchem = false;
+	// true = output which registers are live going into and out of every basic block.
+	bool doReportLiveness = false;
+	bool doReportCycles = false;
+	// Zlib compression level to write schematics with.
+	int compressionLevel = Z_DEFAULT_COMPRESSION;
+	// Shape of the instruction memory to write schematics for.
+	IMemSchematic::Geometry geometry;
+	// Program already deployed in-game to write a patch from, if one was given.
+	bool doOutputPatch = false;
+	std::vector<Instruction> deployedCode;
+	// Region files of the world to build the program into, if one was given, and where in it to build it.
+	std::string worldDirectory;
+	RegionFiles::Position worldOrigin;
+	bool hasWorldOrigin = false;
+	// Number of programs to assemble at once.
+	unsigned int threadCount = ThreadPool::defaultThreadCount();
+	// Directory to cache outputs in, or empty if we shouldn't use a cache.
+	std::string cacheDirectory;
+	// Profile to lay the program out by, if one was given.
+	ExecutionProfile::Profile profile;
+	// true = keep running and assemble the input again whenever it changes.
+	bool doWatch = false;
+	// true = output an object file to be linked later, instead of a program.
+	bool doOutputObject = false;
+	// Settings for every assembly, filled in from the flags.
+	Assembler::Options options;
 	// Check for flags.
-	for (int i = 0; i < argc; i++) {
+	for (int i = 1; i < argc; i++) {
 		// Returns 0 iff inputs are equal.
 		// Check for -g flag.
 		if (!strcmp(argv[i], "-g")) {
 			doOutputSchem = true;
-			if (outFileName == "out.shroombin") {
-				outFileName = "out.schem";
-			}
 		}
-		// Check for -o flag.
-		else if (!strcmp(argv[i], "-o")) {
-			// Make sure name was actually given.
-			if (argc - 1 == i || !strcmp(argv[i + 1], "-g") || !strcmp(argv[i + 1], "-o")) {
-				std::cerr << "Error: -o argument requires output file name!\n" << "\nUsage: " << argv[0]
-					<< usagemessage;
+		// Check for -G flag.
+		else if (!strcmp(argv[i], "-G")) {
+			doOutputSchem = true;
+			doOutputBoth = true;
+		}
+		// Check for -f flag.
+		else if (!strcmp(argv[i], "-f")) {
+			doOutputFunction = true;
+		}
+		// Check for flags that take an argument.
+		else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "-m") || !strcmp(argv[i], "-j") || 
+			!strcmp(argv[i], "-z") || !strcmp(argv[i], "--cache") || !strcmp(argv[i], "--profile") ||
+			!strcmp(argv[i], "--rom") || !strcmp(argv[i], "--patch") || !strcmp(argv[i], "--world") ||
+			!strcmp(argv[i], "--origin")) {
+			// Make sure argument was actually given (positions can start with a minus sign).
+			if (argc - 1 == i || (argv[i + 1][0] == '-' && strcmp(argv[i], "--origin"))) {
+				std::cerr << "Error: " << argv[i] << " flag requires an argument!\n" << "\nUsage: " 
+					<< argv[0] << usagemessage;
 				return -1;
 			}
-			else {
+
+			if (!strcmp(argv[i], "-o")) {
 				// Set new outfile name.
 				outFileName = argv[i + 1];
-				break;
 			}
+			else if (!strcmp(argv[i], "--cache")) {
+				cacheDirectory = argv[i + 1];
+			}
+			else if (!strcmp(argv[i], "--profile")) {
+				try {
+					profile = ExecutionProfile::loadProfile(argv[i + 1]);
+				}
+				catch (std::exception &e) {
+					std::cerr << "Error: " << e.what() << "\n" << "\nUsage: " << argv[0] 
+						<< usagemessage;
+					return -1;
+				}
+				options.profile = &profile;
+			}
+			else if (!strcmp(argv[i], "--patch")) {
+				try {
+					deployedCode = OutputFiles::loadBinary(argv[i + 1]);
+				}
+				catch (std::exception &e) {
+					std::cerr << "Error: " << e.what() << "\n" << "\nUsage: " << argv[0] 
+						<< usagemessage;
+					return -1;
+				}
+				doOutputPatch = true;
+			}
+			else if (!strcmp(argv[i], "--world")) {
+				worldDirectory = argv[i + 1];
+			}
+			else if (!strcmp(argv[i], "--origin")) {
+				try {
+					worldOrigin = RegionFiles::parsePosition(argv[i + 1]);
+				}
+				catch (std::exception &e) {
+					std::cerr << "Error: " << e.what() << "\n" << "\nUsage: " << argv[0] 
+						<< usagemessage;
+					return -1;
+				}
+				hasWorldOrigin = true;
+			}
+			else if (!strcmp(argv[i], "--rom")) {
+				try {
+					geometry = IMemSchematic::parseGeometry(argv[i + 1]);
+				}
+				catch (std::exception &e) {
+					std::cerr << "Error: " << e.what() << "\n" << "\nUsage: " << argv[0] 
+						<< usagemessage;
+					return -1;
+				}
+			}
+			else if (!strcmp(argv[i], "-m")) {
+				try {
+					readManifest(argv[i + 1], inputFileNames);
+				}
+				catch (std::exception &e) {
+					std::cerr << "Error: " << e.what() << "\n" << "\nUsage: " << argv[0] 
+						<< usagemessage;
+					return -1;
+				}
+			}
+			else if (!strcmp(argv[i], "-z")) {
+				if (strlen(argv[i + 1]) != 1 || argv[i + 1][0] < '0' || argv[i + 1][0] > '9') {
+					std::cerr << "Error: -z flag expects a compression level from 0 to 9!\n" 
+						<< "\nUsage: " << argv[0] << usagemessage;
+					return -1;
+				}
+				compressionLevel = argv[i + 1][0] - '0';
+			}
+			else {
+				try {
+					threadCount = (unsigned int)std::stoul(argv[i + 1]);
+				}
+				catch (std::exception &e) {
+					threadCount = 0u;
+				}
+				if (threadCount == 0u) {
+					std::cerr << "Error: -j flag expects a positive number of threads!\n" 
+						<< "\nUsage: " << argv[0] << usagemessage;
+					return -1;
+				}
+			}
+			i++;
 		}
 		// Check for binry output flag.
 		else if (!strcmp(argv[i], "-b")) {
 			doDumpInstructions = true;
 		}
+		// Check for listing flag.
+		else if (!strcmp(argv[i], "-l")) {
+			doOutputListing = true;
+		}
+		else if (!strcmp(argv[i], "--data-schem")) {
+			doOutputDataSchem = true;
+		}
+		// Check for watch mode flag.
+		else if (!strcmp(argv[i], "--watch")) {
+			doWatch = true;
+		}
+		// Check for object file flag.
+		else if (!strcmp(argv[i], "-c")) {
+			doOutputObject = true;
+		}
+		// Check for unreachable code removal flag.
+		else if (!strcmp(argv[i], "--strip")) {
+			options.removeUnreachableCode = true;
+		}
+		// Check for optimization flag.
+		else if (!strcmp(argv[i], "-O")) {
+			options.optimizationLevel = 1u;
+		}
+		else if (!strcmp(argv[i], "-O2")) {
+			options.optimizationLevel = 2u;
+		}
+		else if (!strcmp(argv[i], "-Os")) {
+			options.optimizationLevel = 2u;
+			options.optimizeForSize = true;
+		}
+		// Check for liveness report flag.
+		else if (!strcmp(argv[i], "--liveness")) {
+			doReportLiveness = true;
+		}
+		// Check for cycle estimate flag.
+		else if (!strcmp(argv[i], "--cycles")) {
+			doReportCycles = true;
+		}
 		// Check for invalid flags.
 		else if (argv[i][0] == '-') {
 			std::cerr << "Error: unknown flag " << argv[i] << "!\n" << "\nUsage: " << argv[0] 
 				<< usagemessage;
 			return -1;
 		}
+		// Anything else is a source file to assemble.
+		else {
+			inputFileNames.push_back(argv[i]);
+		}
 	}
 
-	// First pass through file; find and define constants and labels.
-	findConstantsAndLabels(sourceFile);
-
-	// Second pass over file, actually translate insturctions into machine code.
-	std::vector<Instruction> machineCode;
-	// Keeps track of which instruction we're currently on, starting at zero.
-	unsigned int instructionNumber = 0;
-	// Current line of file.
-	std::string line;
-	// Keeps track of line number.
-	unsigned int lineNumber = 0;
-	// List of plaintext instructions which is filled if we do a binary dump.
-	std::vector<std::string> instructionLines;
-	while (getline(sourceFile, line)) {
-		// Increment line number.
-		lineNumber++;
-
-		// If we've translated more instructions than will fit into instruction memory, print error message and 
-		// halt program.
-		if (instructionNumber >= INSTRUCTION_MEMORY_SIZE) {
-			std::cerr << "Error: program too large! Max size is " << INSTRUCTION_MEMORY_SIZE << 
-				" instructions!" << std::endl;
-			exit(-1);
-		}
-
-		// Remove comment from line.
-		Parser::stripComment(line);
-
-		// Parse line to examine its formatted components.
-		std::vector<std::string> parsedLine;
-		Parser::parseLine(line, parsedLine);
-
-		// If line is empty, a label, or a directive, move on.
-		if (parsedLine.size() == 0) {
-			continue;
-		}
-		if (parsedLine[0][0] == ':' || parsedLine[0][0] == ';') {
-			continue;
-		}
+	// Make sure we actually have something to do.
+	if (inputFileNames.size() == 0) {
+		std::cerr << "Error: please specify input file!\n" << "\nUsage: " << argv[0] << usagemessage;
+		return -1;
+	}
+	if (inputFileNames.size() > 1 && !outFileName.empty()) {
+		std::cerr << "Error: -o can only be used when assembling a single file!\n" << "\nUsage: " << argv[0]
+			<< usagemessage;
+		return -1;
+	}
 
-		// Attempt to translate line into machine code. If attempt fails, print error message and halt.
-		Instruction translatedLine;
-		try {
-			InstructionWriter::writeInstruction(translatedLine, parsedLine);
-		}
-		catch (std::exception &e) {
-			std::cerr << "Error on line " << lineNumber << ": " << e.what() << std::endl;
-			exit(-1);
-		}
-		machineCode.push_back(translatedLine);
-		if (doDumpInstructions) {
-			instructionLines.push_back(line);
-		}
+	// Object files are linked into programs later, so they can't be turned into anything else yet.
+	if (doOutputObject && (doOutputSchem || doOutputFunction || doWatch || doOutputPatch ||
+		!worldDirectory.empty())) {
+		std::cerr << "Error: -c can't be used with -g, -G, -f, --patch, --world or --watch!\n"
+			<< "\nUsage: " << argv[0] << usagemessage;
+		return -1;
+	}
+	// Only one program can be deployed at a time, so there's only one to patch.
+	if (doOutputPatch && inputFileNames.size() > 1) {
+		std::cerr << "Error: --patch can only be used when assembling a single file!\n" << "\nUsage: " << argv[0]
+			<< usagemessage;
+		return -1;
+	}
 
-		// If we made it this far, we know we're dealing with a instruction so we should increment.
-		instructionNumber++;
+	if (doOutputDataSchem && !doOutputSchem) {
+		std::cerr << "Error: --data-schem can only be used along with -g or -G!\n" << "\nUsage: " << argv[0]
+			<< usagemessage;
+		return -1;
 	}
 
-	// If we should dump our instructions to stdout, do it.
-	if (doDumpInstructions) {
-		for (unsigned int i = 0; i < machineCode.size(); i++) {
-			std::cout << instructionLines[i] << ":    " << machineCode[i].formattedAsString() << std::endl;
-		}
+	if (worldDirectory.empty() != !hasWorldOrigin) {
+		std::cerr << "Error: --world and --origin must be used together!\n" << "\nUsage: " << argv[0]
+			<< usagemessage;
+		return -1;
+	}
+	// Only one program fits in one place, and the world can't be open in the game while we're watching for changes.
+	if (!worldDirectory.empty() && (inputFileNames.size() > 1 || doWatch)) {
+		std::cerr << "Error: --world can only be used when assembling a single file, without --watch!\n"
+			<< "\nUsage: " << argv[0] << usagemessage;
+		return -1;
 	}
 
-	// Now that we have our machine code, check if we should make a shroom16 binary or a .schem for use in 
-	// Minecraft.
-	// Handle case for virtual machine.
-	if (!doOutputSchem) {
-		// Open output c++ file stream for creating assembled program for the virtual machine.
-		std::ofstream outFile(outFileName, std::ios::binary);
-		if (!outFile.good()) {
-			std::cerr << "Error: Issue opening output file " << outFileName << "!\n";
-			return -1;
+	// Set up a job for each input, working out where each of its outputs should go. A single input keeps the
+	// old out.shroombin/out.schem defaults, while a batch names each output after its input.
+	std::vector<AssemblyJob> jobs(inputFileNames.size());
+	for (unsigned int i = 0; i < jobs.size(); i++) {
+		jobs[i].inputFileName = inputFileNames[i];
+		jobs[i].schematicCompressionLevel = compressionLevel;
+		jobs[i].schematicGeometry = geometry;
+		// A batch already keeps every thread busy with a program each, so only a single program gets them all to
+		// compress its schematic with.
+		jobs[i].schematicThreadCount = jobs.size() == 1 ? threadCount : 1u;
+		std::string baseName = jobs.size() > 1 ? inputFileNames[i] : 
+			(outFileName.empty() ? "out" : outFileName);
+		if (doOutputObject) {
+			jobs[i].objectFileName = (jobs.size() == 1 && !outFileName.empty()) ? outFileName : 
+				replaceExtension(baseName, ".shroomobj");
 		}
-
-		for (Instruction instruction : machineCode) {
-			instruction.writeToFile(outFile);
+		else {
+			// A shroom16 binary is written unless another kind of file was asked for instead. When writing more than
+			// one kind of file, all of them are named after the same base name.
+			const bool doOutputBinary = doOutputBoth || (!doOutputSchem && !doOutputFunction);
+			const bool isOnlyOutput = (doOutputBinary ? 1 : 0) + (doOutputSchem ? 1 : 0) + 
+				(doOutputFunction ? 1 : 0) == 1 && jobs.size() == 1 && !outFileName.empty();
+			if (doOutputBinary) {
+				jobs[i].binaryFileName = isOnlyOutput ? outFileName : replaceExtension(baseName, ".shroombin");
+			}
+			if (doOutputSchem) {
+				jobs[i].schematicFileName = isOnlyOutput ? outFileName : replaceExtension(baseName, ".schem");
+				if (doOutputDataSchem) {
+					jobs[i].dataSchematicFileName = replaceExtension(jobs[i].schematicFileName, ".data.schem");
+				}
+			}
+			if (doOutputFunction) {
+				jobs[i].functionFileName = isOnlyOutput ? outFileName : replaceExtension(baseName, ".mcfunction");
+			}
 		}
-
-		outFile.close();
+		if (doOutputListing) {
+			jobs[i].listingFileName = replaceExtension(baseName, ".lst");
+		}
+		if (doOutputPatch) {
+			jobs[i].patchFileName = replaceExtension(baseName, ".patch.mcfunction");
+			jobs[i].deployedCode = deployedCode;
+		}
+		jobs[i].worldDirectory = worldDirectory;
+		jobs[i].worldOrigin = worldOrigin;
 	}
-	// Handle case for in-game pasting.
-	else {
-		// Open output gzip file for creating schematics.	
-		gzFile outFile = (gzFile)gzopen(outFileName.c_str(), "wb");
-		// Make sure file was successfully opened.
-		if (outFile == NULL) {
-			std::cerr << "Error: Issue opening output file " << outFileName << "!\n";
+
+	// Watch mode never returns, so it gets the one and only job all to itself.
+	if (doWatch) {
+		if (jobs.size() > 1) {
+			std::cerr << "Error: --watch can only be used when assembling a single file!\n" << "\nUsage: " 
+				<< argv[0] << usagemessage;
 			return -1;
 		}
+		watchAssemblyJob(jobs[0], options);
+	}
 
-		// Fill used instructions with zeros.
-		machineCode.resize(INSTRUCTION_MEMORY_SIZE);
+	// Set up the assembly cache, if we were asked to use one.
+	std::unique_ptr<AssemblyCache> cache;
+	if (!cacheDirectory.empty()) {
 		try {
-			// Set up and write schematic file.
-			saveSchematic(machineCode, outFile);
+			cache.reset(new AssemblyCache(cacheDirectory));
 		}
 		catch (std::exception &e) {
 			std::cerr << "Error: " << e.what() << std::endl;
 			return -1;
 		}
-		// Close file handle to gzip file.
-		gzclose(outFile);
 	}
 
-	// Close files.
-	sourceFile.close();
-	return 0;
+	// Assemble everything, spreading the programs over all of our threads.
+	ModuleCache moduleCache;
+	ThreadPool::parallelFor((unsigned int)jobs.size(), threadCount, [&](unsigned int i) {
+		runAssemblyJob(jobs[i], options, doDumpInstructions, doReportLiveness, doReportCycles, cache.get(),
+			moduleCache);
+	});
+
+	// Now that everything is done, report on how it went, in the same order the inputs were given.
+	unsigned int failedJobs = 0;
+	unsigned int cachedJobs = 0;
+	for (const AssemblyJob &job : jobs) {
+		std::cout << job.instructionDump;
+		std::cout << job.livenessReport;
+		std::cout << job.cycleReport;
+		for (const std::string &note : job.notes) {
+			// Only say which file a note is about if there's more than one file.
+			if (jobs.size() > 1) {
+				std::cout << job.inputFileName << ": ";
+			}
+			std::cout << note << std::endl;
+		}
+		if (job.messages.size() > 0) {
+			failedJobs++;
+		}
+		if (job.wasCached) {
+			cachedJobs++;
+		}
+		for (const std::string &message : job.messages) {
+			// Only say which file a problem is in if there's more than one file.
+			if (jobs.size() > 1) {
+				std::cerr << job.inputFileName << ": ";
+			}
+			std::cerr << message << std::endl;
+		}
+	}
+	if (jobs.size() > 1) {
+		std::cerr << "Assembled " << jobs.size() - failedJobs << " of " << jobs.size() << " programs";
+		if (failedJobs > 0 || cachedJobs > 0) {
+			std::cerr << " (" << failedJobs << " failed, " << cachedJobs << " unchanged and copied from cache)";
+		}
+		std::cerr << "." << std::endl;
+	}
+
+	return failedJobs == 0 ? 0 : -1;
 }
@@ -0,0 +1,231 @@
+/*
+
+  ^
+   
+  ...    ^
+ ;   `,  ....
+;       /     `.
+;  ^-^ ;  ^o^   ;  HOWDY FRIEND!
+ ; . . .; . . .    WE LOVE YOU VERY MUSH.
+    ; ;    ; ;     PLEASE MAKE YOURSELF AT HOME;
+     ; ;  / /      MYCELIUM IS YOURCELIUM.
+     ; ; ; ;
+     ; ;/  ;
+ -^------^^---*-
+
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Instruction.h"
+#include "InstructionFormat.h"
+#include "OutputFiles.h"
+#include "BinaryFile.h"
+
+// How wide the instruction column of the disassembly is, so that the address and encoding comments line up.
+#define INSTRUCTION_WIDTH 28
+
+// Return the address instruction jumps to, or -1 if it doesn't jump anywhere (or isn't a real instruction).
+long getTarget(const Instruction &instruction) {
+	try {
+		return InstructionFormat::isJump(instruction) ? (long)InstructionFormat::getJumpTarget(instruction) : -1;
+	}
+	catch (std::exception &e) {
+		return -1;
+	}
+}
+
+// How many words of data go on each ;word line of the disassembly.
+#define WORDS_PER_LINE 8u
+
+// Return machine code, from instruction memory with memorySize slots, written out as assembly that shroomasm can
+// assemble back into the same machine code, preceded by ;word directives giving the initial data memory dataImage.
+// Every jump target gets a label of its own, named after the program's own label for it in symbols if there is one,
+// and every other label in symbols is kept too. Every instruction is followed by a comment with its address and
+// encoding. Throws an exception if any instruction has an opcode that doesn't exist, since there would be no way of
+// writing it out that assembles back into the same machine code.
+std::string disassembleProgram(std::vector<Instruction> machineCode, unsigned int memorySize,
+	const std::string &inFileName, const std::map<std::string, unsigned int> &symbols,
+	const std::vector<std::uint16_t> &dataImage) {
+	// Jumps past the end of the program land in unused slots of instruction memory, which hold zeros (an add that
+	// does nothing), so those slots are written out too to give the jumps somewhere to go. Jumps to a label of the
+	// program's own just past its end can go to that label instead.
+	long lastTarget = -1;
+	for (const Instruction &instruction : machineCode) {
+		long target = getTarget(instruction);
+		bool isToEndLabel = target == (long)machineCode.size() && std::any_of(symbols.begin(), symbols.end(),
+			[&](const std::pair<const std::string, unsigned int> &symbol) { return symbol.second == target; });
+		if (target < (long)memorySize && !isToEndLabel) {
+			lastTarget = std::max(lastTarget, target);
+		}
+	}
+	if (lastTarget >= (long)machineCode.size()) {
+		machineCode.resize((std::size_t)lastTarget + 1u);
+	}
+	// Every address gets all of the program's own labels (the first of which jumps use), or one made up for it if
+	// it's jumped to and has none.
+	std::map<unsigned int, std::vector<std::string> > addressLabels;
+	for (const std::pair<const std::string, unsigned int> &symbol : symbols) {
+		if (symbol.second <= machineCode.size()) {
+			addressLabels[symbol.second].push_back(symbol.first);
+		}
+	}
+	std::map<unsigned int, std::string> labels;
+	for (const Instruction &instruction : machineCode) {
+		long target = getTarget(instruction);
+		if (target >= 0 && target < (long)machineCode.size() && addressLabels.find((unsigned int)target) ==
+			addressLabels.end()) {
+			std::string name = "addr" + std::to_string(target);
+			addressLabels[(unsigned int)target].push_back(symbols.find(name) == symbols.end() ? name : name + "_");
+		}
+	}
+	for (const std::pair<const unsigned int, std::vector<std::string> > &names : addressLabels) {
+		labels[names.first] = names.second.front();
+	}
+
+	std::ostringstream assembly;
+	assembly << "# Disassembled from " << inFileName << " (" << machineCode.size() << " instructions).\n";
+	for (unsigned int i = 0; i < dataImage.size(); i += WORDS_PER_LINE) {
+		assembly << ";word";
+		for (unsigned int j = i; j < dataImage.size() && j < i + WORDS_PER_LINE; j++) {
+			assembly << " 0x" << std::hex << std::setfill('0') << std::setw(4) << dataImage[j] << std::dec
+				<< std::setfill(' ');
+		}
+		assembly << "\n";
+	}
+	for (unsigned int i = 0; i <= machineCode.size(); i++) {
+		std::map<unsigned int, std::vector<std::string> >::const_iterator names = addressLabels.find(i);
+		if (names != addressLabels.end()) {
+			for (const std::string &name : names->second) {
+				assembly << ":" << name << "\n";
+			}
+		}
+		if (i == machineCode.size()) {
+			break;
+		}
+
+		std::string text;
+		try {
+			std::map<unsigned int, std::string>::const_iterator label =
+				labels.find((unsigned int)getTarget(machineCode[i]));
+			text = InstructionFormat::disassemble(machineCode[i], label != labels.end() ? label->second : "");
+		}
+		catch (std::exception &e) {
+			throw std::runtime_error("Instruction " + std::to_string(i) + " of " + inFileName + " has opcode " +
+				std::to_string(InstructionFormat::getOpcode(machineCode[i])) + ", which doesn't exist!");
+		}
+		assembly << "\t" << std::left << std::setw(INSTRUCTION_WIDTH) << text << "# " << std::right << std::setw(3)
+			<< i << "  0x" << std::hex << std::setfill('0') << std::setw(8)
+			<< machineCode[i].getBitsInRange(0, INSTRUCTION_SIZE - 1) << std::dec << std::setfill(' ') << "\n";
+	}
+	return assembly.str();
+}
+
+int main(int argc, char *argv[]) {
+	// Check proper command line argument format.
+	std::string usagemessage = " <program> <optional arguments>\nDisassembles a shroom16 binary file (.shroombin) "
+		"or a .schem file written by shroomasm -g (e.g. to check what's deployed in-game) back into assembly that "
+		"shroomasm can assemble again.\nOptional arguments:\n -o <name>       Write the assembly to a file instead "
+		"of printing it.\n --rom <geometry> Shape of the instruction memory a .schem file was written for (see "
+		"shroomasm --rom). Defaults to the standard 8x64x32.\n";
+	if (argc < 2) {
+		std::cerr << "Error: please specify input file!\n" << "\nUsage: " << argv[0] << usagemessage;
+		return -1;
+	}
+
+	// Name of output file, or empty if the assembly should be printed.
+	std::string outFileName;
+	// Name of the program to disassemble.
+	std::string inputFileName;
+	// Shape of the instruction memory the program's schematic was written for.
+	IMemSchematic::Geometry geometry;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-o")) {
+			// Make sure argument was actually given.
+			if (argc - 1 == i || argv[i + 1][0] == '-') {
+				std::cerr << "Error: -o flag requires an argument!\n" << "\nUsage: " << argv[0] << usagemessage;
+				return -1;
+			}
+			outFileName = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--rom")) {
+			if (argc - 1 == i || argv[i + 1][0] == '-') {
+				std::cerr << "Error: --rom flag requires an argument!\n" << "\nUsage: " << argv[0] << usagemessage;
+				return -1;
+			}
+			try {
+				geometry = IMemSchematic::parseGeometry(argv[++i]);
+			}
+			catch (std::exception &e) {
+				std::cerr << "Error: " << e.what() << "\n" << "\nUsage: " << argv[0] << usagemessage;
+				return -1;
+			}
+		}
+		else if (argv[i][0] == '-') {
+			std::cerr << "Error: unknown flag " << argv[i] << "!\n" << "\nUsage: " << argv[0] << usagemessage;
+			return -1;
+		}
+		else if (inputFileName.empty()) {
+			inputFileName = argv[i];
+		}
+		else {
+			std::cerr << "Error: only one program can be disassembled at a time!\n" << "\nUsage: " << argv[0]
+				<< usagemessage;
+			return -1;
+		}
+	}
+	if (inputFileName.empty()) {
+		std::cerr << "Error: please specify input file!\n" << "\nUsage: " << argv[0] << usagemessage;
+		return -1;
+	}
+
+	try {
+		// Schematics have the program read back out of their torches (and their data out of the data schematic next
+		// to them, if there is one), and anything else is taken to be a binary.
+		BinaryFile::Binary binary;
+		unsigned int memorySize = INSTRUCTION_MEMORY_SIZE;
+		if (inputFileName.size() >= 6u && inputFileName.substr(inputFileName.size() - 6u) == ".schem") {
+			binary.machineCode = OutputFiles::loadSchematicFile(inputFileName, geometry);
+			memorySize = geometry.getInstructionCount();
+			const std::string dataFileName = inputFileName.substr(0, inputFileName.size() - 6u) + ".data.schem";
+			if (std::ifstream(dataFileName).good()) {
+				binary.dataImage = OutputFiles::loadDataSchematicFile(dataFileName);
+			}
+		}
+		else {
+			binary = BinaryFile::loadBinary(inputFileName);
+		}
+
+		std::string assembly = disassembleProgram(binary.machineCode, memorySize, inputFileName, binary.labels,
+			binary.dataImage);
+		if (outFileName.empty()) {
+			std::cout << assembly;
+		}
+		else {
+			std::ofstream outFile(outFileName);
+			if (!outFile.good()) {
+				throw std::runtime_error("Issue opening output file " + outFileName + "!");
+			}
+			outFile << assembly;
+			outFile.close();
+			if (!outFile.good()) {
+				throw std::runtime_error("Issue writing output file " + outFileName + "!");
+			}
+		}
+	}
+	catch (std::exception &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,185 @@
+/*
+
+  ^
+   
+  ...    ^
+ ;   `,  ....
+;       /     `.
+;  ^-^ ;  ^o^   ;  HOWDY FRIEND!
+ ; . . .; . . .    WE LOVE YOU VERY MUSH.
+    ; ;    ; ;     PLEASE MAKE YOURSELF AT HOME;
+     ; ;  / /      MYCELIUM IS YOURCELIUM.
+     ; ; ; ;
+     ; ;/  ;
+ -^------^^---*-
+
+*/
+
+#include <iostream>
+#include <chrono>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Instruction.h"
+#include "Linker.h"
+#include "OutputFiles.h"
+#include "ThreadPool.h"
+
+int main(int argc, char *argv[]) {
+	// Check proper command line argument format.
+	std::string usagemessage = " <object files> <optional arguments>\nLinks object files made by shroomasm -c into "
+		"a single program. Objects are placed in the order given, so the program starts running at the start of "
+		"the first one.\nOptional arguments:\n -o <name>       Specify output file name.\n -g              Output "
+		"a .schem file (Sponge ver. 3) to be pasted into in-game instruction memory (instead of a shroom16 binary "
+		"file for use in the VM).\n -G              Output both a .schem file and a shroom16 binary file.\n"
+		" -f              Output a .mcfunction file of setblock and fill commands that place the program into "
+		"already built in-game instruction memory, for servers without WorldEdit (instead of a shroom16 binary "
+		"file, unless -G is given too). Run it from where the .schem file is pasted.\n"
+		" --strip         Remove code that can never run (e.g. library subroutines the program never calls) to "
+		"save instruction memory.\n -z <level>      Compression level for .schem files, from 0 (fastest) to 9 "
+		"(smallest). Defaults to 6.\n --rom <geometry> Shape of the instruction memory to output the .schem file for, "
+		"as <layers>x<instructions per layer>x<bits>, optionally followed by x<bit spacing>x<instruction spacing>. "
+		"Defaults to the standard 8x64x32.\n";
+	if (argc < 2) {
+		std::cerr << "Error: please specify input files!\n" << "\nUsage: " << argv[0] << usagemessage;
+		return -1;
+	}
+
+	// Name of output file, or empty if none was given.
+	std::string outFileName;
+	// Names of all the object files to link.
+	std::vector<std::string> inputFileNames;
+	// true = output schematic file for use in game, false = output shroom16 binary file for use with vm.
+	bool doOutputSchem = false;
+	// true = output a shroom16 binary file alongside the schematic file.
+	bool doOutputBoth = false;
+	// true = output a .mcfunction file of commands that place the program in game.
+	bool doOutputFunction = false;
+	// true = remove code that can never run from the linked program.
+	bool doRemoveUnreachableCode = false;
+	// Zlib compression level to write schematics with.
+	int compressionLevel = Z_DEFAULT_COMPRESSION;
+	// Shape of the instruction memory to write schematics for.
+	IMemSchematic::Geometry geometry;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-g")) {
+			doOutputSchem = true;
+		}
+		else if (!strcmp(argv[i], "-G")) {
+			doOutputSchem = true;
+			doOutputBoth = true;
+		}
+		else if (!strcmp(argv[i], "-f")) {
+			doOutputFunction = true;
+		}
+		else if (!strcmp(argv[i], "--strip")) {
+			doRemoveUnreachableCode = true;
+		}
+		else if (!strcmp(argv[i], "-o")) {
+			// Make sure argument was actually given.
+			if (argc - 1 == i || argv[i + 1][0] == '-') {
+				std::cerr << "Error: -o flag requires an argument!\n" << "\nUsage: " << argv[0] 
+					<< usagemessage;
+				return -1;
+			}
+			outFileName = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-z")) {
+			if (argc - 1 == i || strlen(argv[i + 1]) != 1 || argv[i + 1][0] < '0' || argv[i + 1][0] > '9') {
+				std::cerr << "Error: -z flag expects a compression level from 0 to 9!\n" << "\nUsage: " << argv[0] 
+					<< usagemessage;
+				return -1;
+			}
+			compressionLevel = argv[++i][0] - '0';
+		}
+		else if (!strcmp(argv[i], "--rom")) {
+			if (argc - 1 == i || argv[i + 1][0] == '-') {
+				std::cerr << "Error: --rom flag requires an argument!\n" << "\nUsage: " << argv[0] << usagemessage;
+				return -1;
+			}
+			try {
+				geometry = IMemSchematic::parseGeometry(argv[++i]);
+			}
+			catch (std::exception &e) {
+				std::cerr << "Error: " << e.what() << "\n" << "\nUsage: " << argv[0] << usagemessage;
+				return -1;
+			}
+		}
+		else if (argv[i][0] == '-') {
+			std::cerr << "Error: unknown flag " << argv[i] << "!\n" << "\nUsage: " << argv[0] << usagemessage;
+			return -1;
+		}
+		else {
+			inputFileNames.push_back(argv[i]);
+		}
+	}
+	if (inputFileNames.size() == 0) {
+		std::cerr << "Error: please specify input files!\n" << "\nUsage: " << argv[0] << usagemessage;
+		return -1;
+	}
+
+	// Read in every object.
+	std::vector<Linker::ObjectFile> objects;
+	try {
+		for (const std::string &inputFileName : inputFileNames) {
+			objects.push_back(Linker::loadObjectFile(inputFileName));
+		}
+	}
+	catch (std::exception &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return -1;
+	}
+
+	// Put them all together, reporting every problem at once.
+	Linker::Result linked = Linker::link(objects, inputFileNames, doRemoveUnreachableCode);
+	if (!linked.succeeded()) {
+		for (const std::string &error : linked.errors) {
+			std::cerr << error << std::endl;
+		}
+		return -1;
+	}
+	if (linked.removedInstructionCount > 0) {
+		std::cout << "Removed " << linked.removedInstructionCount << " unreachable instructions (" 
+			<< linked.machineCode.size() << " of " << INSTRUCTION_MEMORY_SIZE << " instruction slots now used)." 
+			<< std::endl;
+	}
+
+	// Write out the program, named the same way shroomasm would name it.
+	try {
+		// A shroom16 binary is written unless another kind of file was asked for instead. When writing more than one
+		// kind of file, all of them are named after the same base name.
+		const bool doOutputBinary = doOutputBoth || (!doOutputSchem && !doOutputFunction);
+		const bool isOnlyOutput = (doOutputBinary ? 1 : 0) + (doOutputSchem ? 1 : 0) + (doOutputFunction ? 1 : 0) == 1
+			&& !outFileName.empty();
+		std::string baseName = outFileName.empty() ? "out" : outFileName;
+		std::size_t dot = baseName.find_last_of('.');
+		if (dot != std::string::npos && baseName.find_first_of("/\\", dot) == std::string::npos) {
+			baseName = baseName.substr(0, dot);
+		}
+		std::string schematicFileName;
+		if (doOutputBinary) {
+			OutputFiles::saveBinary(linked.machineCode, isOnlyOutput ? outFileName : baseName + ".shroombin");
+		}
+		if (doOutputSchem) {
+			schematicFileName = isOnlyOutput ? outFileName : baseName + ".schem";
+		}
+		if (doOutputFunction) {
+			OutputFiles::saveFunctionFile(linked.machineCode, isOnlyOutput ? outFileName : baseName + ".mcfunction",
+				geometry);
+		}
+		// Schematics are the slowest output to write by far, so say how long they took.
+		if (!schematicFileName.empty()) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			OutputFiles::saveSchematicFile(linked.machineCode, schematicFileName, compressionLevel, 
+				ThreadPool::defaultThreadCount(), geometry);
+			std::cout << "Wrote " << schematicFileName << " in " << std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - start).count() << " ms." << std::endl;
+		}
+	}
+	catch (std::exception &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
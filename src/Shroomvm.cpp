@@ -21,11 +21,21 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
+#include <memory>
 #include "Processor.h"
 #include "Page437OutputScreen.h"
+#include "Assembler.h"
+#include "ExecutionProfile.h"
+#include "OutputFiles.h"
+#include "BinaryFile.h"
+#include "Hash.h"
 
 #define BACKSPACE 8
 
+// How often the program file is checked for changes when hot reloading is turned on, in seconds.
+#define RELOAD_POLL_INTERVAL 0.25f
+
 #define LEFTHELD sf::Keyboard::isKeyPressed(sf::Keyboard::Left)
 #define RIGHTHELD sf::Keyboard::isKeyPressed(sf::Keyboard::Right)
 #define UPHELD sf::Keyboard::isKeyPressed(sf::Keyboard::Up)
@@ -33,9 +43,119 @@
 #define ZHELD sf::Keyboard::isKeyPressed(sf::Keyboard::Z)
 #define XHELD sf::Keyboard::isKeyPressed(sf::Keyboard::X)
 
+// Name of the file to write the program's execution profile to when the VM exits, or empty if we shouldn't.
+std::string profileFileName;
+// Shape of the instruction memory that .schem files being run were written for.
+IMemSchematic::Geometry romGeometry;
+
+// Write the execution profile of the program to profileFileName, if there is one. Runs whenever the VM exits, which
+// includes the program ending itself with ?end.
+void saveProfile() {
+	if (profileFileName.empty()) {
+		return;
+	}
+	try {
+		ExecutionProfile::saveProfile(Processor::getProfile(), profileFileName);
+	}
+	catch (std::exception &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+	}
+}
+
 void runNoGUI(bool doStepMode, float minTimeBetweenInstructions) {
 }
 
+// Map the file fileName into memory, so that the program in it can be read in place. Return nullptr iff the file
+// could not be opened.
+std::unique_ptr<BinaryFile::MappedFile> mapProgramFile(const std::string &fileName) {
+	try {
+		return std::unique_ptr<BinaryFile::MappedFile>(new BinaryFile::MappedFile(fileName));
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+// Return the hash of the contents of file, which tells us whether the program file changed since it was loaded.
+std::uint64_t hashProgramFile(const BinaryFile::MappedFile &file) {
+	return Hash::fnv1aBytes(file.data(), file.size());
+}
+
+// Return fileName with its extension (if any) replaced by extension, e.g. ("progs/fib.shroombin", ".shroomdata") gives
+// "progs/fib.shroomdata".
+std::string replaceExtension(const std::string &fileName, const std::string &extension) {
+	std::size_t dot = fileName.find_last_of('.');
+	std::size_t slash = fileName.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		return fileName + extension;
+	}
+	return fileName.substr(0, dot) + extension;
+}
+
+// Load the initial data memory of the program in the file dataFileName, a data image (.shroomdata) or a schematic of
+// data memory (.schem) written next to it by shroomasm, into data memory. Programs without any data don't have the
+// file at all, so data memory is left as it is if it's missing. Throws an exception if the file could not be read.
+void loadData(const std::string &dataFileName) {
+	if (!std::ifstream(dataFileName).good()) {
+		return;
+	}
+	bool isSchematic = dataFileName.size() >= 6u && dataFileName.substr(dataFileName.size() - 6u) == ".schem";
+	std::vector<std::uint16_t> dataImage = isSchematic ? OutputFiles::loadDataSchematicFile(dataFileName) :
+		OutputFiles::loadDataImage(dataFileName);
+	DataMemory::load(std::vector<WORD>(dataImage.begin(), dataImage.end()));
+}
+
+// Load the program held in file, the mapping of the file fileName, into instruction memory, and its initial data into
+// data memory. Source files (.asm) are assembled in process first, so there's no need to run shroomasm beforehand, and
+// schematics (.schem) have the program read back out of their torches. Binaries hold their own data, and schematics
+// (and binaries from before binaries held data) have it read from the .data.schem or .shroomdata file next to them.
+// Return false iff the program could not be assembled or read, after printing what went wrong.
+bool loadProgram(const std::string &fileName, const BinaryFile::MappedFile &file) {
+	if (fileName.size() >= 4u && fileName.substr(fileName.size() - 4u) == ".asm") {
+		Assembler::Options options;
+		options.sourceFileName = fileName;
+		Assembler::Result assembled = Assembler::assemble(std::string((const char*)file.data(), file.size()), options);
+		if (!assembled.succeeded()) {
+			for (const Assembler::Diagnostic &diagnostic : assembled.diagnostics) {
+				std::cerr << Assembler::formatDiagnostic(diagnostic) << std::endl;
+			}
+			return false;
+		}
+		Processor::loadInstructions(assembled.machineCode);
+		DataMemory::load(std::vector<WORD>(assembled.dataImage.begin(), assembled.dataImage.end()));
+	}
+	else if (fileName.size() >= 6u && fileName.substr(fileName.size() - 6u) == ".schem") {
+		std::istringstream schematicStream(std::string((const char*)file.data(), file.size()));
+		try {
+			Processor::loadInstructions(OutputFiles::loadSchematic(schematicStream, romGeometry));
+			loadData(replaceExtension(fileName, ".data.schem"));
+		}
+		catch (std::exception &e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+			return false;
+		}
+	}
+	else {
+		try {
+			// Binaries are parsed in place, straight out of the mapping of the file. Version 1 binaries only hold code,
+			// so their data (if any) is next to them.
+			BinaryFile::Binary binary = BinaryFile::parseBinary(file.data(), file.size(), fileName);
+			Processor::loadInstructions(binary.machineCode);
+			if (binary.formatVersion == 1u) {
+				loadData(replaceExtension(fileName, ".shroomdata"));
+			}
+			else {
+				DataMemory::load(std::vector<WORD>(binary.dataImage.begin(), binary.dataImage.end()));
+			}
+		}
+		catch (std::exception &e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
 void drawNormalViewLabels(Page437OutputScreen &screen) {
 	screen.drawStringHoriz(0u, 0u, 16u, "CHARACTER-OUT---", sf::Color::Green);
 
@@ -229,7 +349,12 @@ WORD getKeypadState() {
 	return state;
 }
 
-void runGUI(bool doStepMode, float minTimeBetweenInstructions) {
+// Run the program with the display window. If reloadFileName is non-empty, the program file with that name (whose
+// contents hashed to programHash when it was loaded) is checked for changes every so often, and whenever it changes
+// (e.g. because shroomasm --watch wrote a new version), the processor is reset and the new version is run from the
+// start.
+void runGUI(bool doStepMode, float minTimeBetweenInstructions, const std::string &reloadFileName, 
+		std::uint64_t programHash) {
 	// Create window.
 	sf::RenderWindow window(sf::VideoMode(516u, 516u), "Shroom16 Virtual Machine");
 	// Create output screen to storee characters.
@@ -244,7 +369,23 @@ void runGUI(bool doStepMode, float minTimeBetweenInstructions) {
 	sf::Time timeOfLastInstructionExecution = clock.getElapsedTime();
 	// Current num in text.
 	std::string numInText = "";
+	// Time we last checked the program file for changes.
+	sf::Time timeOfLastReloadCheck = clock.getElapsedTime();
 	while (window.isOpen()) {
+		// Hot reload the program if it changed.
+		if (!reloadFileName.empty() && 
+			(clock.getElapsedTime() - timeOfLastReloadCheck).asSeconds() >= RELOAD_POLL_INTERVAL) {
+			timeOfLastReloadCheck = clock.getElapsedTime();
+			// The file is only mapped once, both to see whether it changed and to load the new version from.
+			std::unique_ptr<BinaryFile::MappedFile> programFile = mapProgramFile(reloadFileName);
+			if (programFile != nullptr && hashProgramFile(*programFile) != programHash) {
+				programHash = hashProgramFile(*programFile);
+				Processor::reset();
+				loadProgram(reloadFileName, *programFile);
+				numInText = "";
+			}
+		}
+
 		// Check for events.
 		sf::Event event;
 		while (window.pollEvent(event)) {
@@ -339,9 +480,19 @@ void runGUI(bool doStepMode, float minTimeBetweenInstructions) {
 
 int main(int argc, char *argv[]) {
 	// Ensure we were given at least an input file as an argument, if not end program.
-	std::string usageMessage = " <input program> <optional arguments>\nOptional arguments:\n -t <time>       "
-		"Specify minimum time between instructions (in seconds).\n -n              Run in no-gui mode.\n"
-		" -s              Run in step mode.";
+	std::string usageMessage = " <input program> <optional arguments>\nThe input program may be an assembled "
+		".shroombin file, a .schem file written by shroomasm -g (to run what's deployed in-game), or a .asm source "
+		"file, which is assembled before running. Data memory starts out holding the program's initial data, read from "
+		"the .shroombin file, or the .data.schem file written next to a .schem file by shroomasm --data-schem.\n"
+		"Optional arguments:\n"
+		" -t <time>       Specify minimum time between instructions (in seconds).\n"
+		" -n              Run in no-gui mode.\n -s              Run in step mode.\n"
+		" -r              Reload and restart the program whenever its file changes (e.g. when rewritten by "
+		"shroomasm --watch).\n"
+		" -p <file>       Write a profile of how often every instruction ran to the file on exit, to be used by "
+		"shroomasm --profile.\n"
+		" --rom <geometry> Shape of the instruction memory a .schem input program was written for (see shroomasm "
+		"--rom). Defaults to the standard 8x64x32.";
 	if (argc < 2) {
 		std::cerr << "Error: invalid number of arguments!\nUsage: " << argv[0] << usageMessage << std::endl;
 		return -1;
@@ -353,6 +504,8 @@ int main(int argc, char *argv[]) {
 	// No GUI mode disables the display window such that the only thing shown are register values output with the
 	// ?out interrupt, straight into stdout.
 	bool noGUIMode = false;
+	// Hot reload mode restarts the program whenever its file changes.
+	bool reloadMode = false;
 	float minTimeBetweenInstructions = 0.0;
 	for (int i = 2; i < argc; i++) {
 		if (!strcmp(argv[i], "-s")) {
@@ -361,6 +514,9 @@ int main(int argc, char *argv[]) {
 		else if (!strcmp(argv[i], "-n")) {
 			noGUIMode = true;
 		}
+		else if (!strcmp(argv[i], "-r")) {
+			reloadMode = true;
+		}
 		else if (!strcmp(argv[i], "-t")) {
 			try {
 				if (argc - 1 > i) {
@@ -376,28 +532,56 @@ int main(int argc, char *argv[]) {
 				return -1;
 			}
 		}
-		else if (strcmp(argv[i - 1], "-t")) {
+		else if (!strcmp(argv[i], "-p")) {
+			if (argc - 1 == i) {
+				std::cerr << "Error: -p flag expects a file name.\nUsage: " << argv[0] << usageMessage << std::endl;
+				return -1;
+			}
+			profileFileName = argv[i + 1];
+		}
+		else if (!strcmp(argv[i], "--rom")) {
+			try {
+				if (argc - 1 == i) {
+					throw std::invalid_argument("Not enough arguments!");
+				}
+				romGeometry = IMemSchematic::parseGeometry(argv[i + 1]);
+			}
+			catch (std::exception &e) {
+				std::cerr << "Error: --rom flag expects an instruction memory geometry (e.g. 8x64x32).\nUsage: "
+					<< argv[0] << usageMessage << std::endl;
+				return -1;
+			}
+		}
+		else if (strcmp(argv[i - 1], "-t") && strcmp(argv[i - 1], "-p") && strcmp(argv[i - 1], "--rom")) {
 			std::cerr << "Error: unknown flag " << argv[i] << "\nUsage: " << argv[0] << usageMessage 
 				<< std::endl;
 			return -1;
 		}
 	}
 
-	// Try to open machine code file.
-	std::ifstream codeFile(argv[1], std::ios::in|std::ios::binary);
+	// Try to map machine code file.
+	std::unique_ptr<BinaryFile::MappedFile> programFile = mapProgramFile(argv[1]);
 	// Make sure file was properly opened.
-	if (!codeFile.good()) {
+	if (programFile == nullptr) {
 		std::cerr << "Error: invalid input file " << argv[1] << "\nUsage: " << argv[0] << usageMessage 
 			<< std::endl;
 		return -1;
 	}
 
 	// Now that we know we have a good file, load instructions into instruction memory.
-	Processor::loadMachineCode(codeFile);
+	if (!loadProgram(argv[1], *programFile)) {
+		return -1;
+	}
+	// Once the program is loaded, we only need to remember enough of the file to tell whether it changes.
+	const std::uint64_t programHash = hashProgramFile(*programFile);
+	programFile.reset();
+
+	// The program can end at any time (e.g. with ?end), so make sure the profile gets written whenever it does.
+	std::atexit(saveProfile);
 
 	// Actually run program depending on settings.
 	if (!noGUIMode) {
-		runGUI(stepMode, minTimeBetweenInstructions);
+		runGUI(stepMode, minTimeBetweenInstructions, reloadMode ? argv[1] : "", programHash);
 	}
 	else {
 		runNoGUI(stepMode, minTimeBetweenInstructions);
@@ -0,0 +1,266 @@
+#include <cstdint>
+#include "SubroutineInliner.h"
+#include "ControlFlowGraph.h"
+#include "DataflowOptimizer.h"
+#include "InstructionFormat.h"
+
+namespace SubroutineInliner {
+	// Largest subroutine (not counting its jr) worth copying into every place it's called from.
+	static const unsigned int MAX_INLINED_SIZE = 16u;
+
+	// An instruction of a subroutine being copied, along with where it jumps to relative to the start of the
+	// subroutine, and whether it's the sw or lw the subroutine saves and restores $ca with.
+	struct CopiedInstruction {
+		Instruction instruction;
+		Assembler::SourceLocation location;
+		bool hasTarget;
+		unsigned int targetOffset;
+		bool savesOrRestoresCa;
+	};
+
+	// Where a leaf subroutine found by findLeafSubroutine() returns, and where it saves and restores $ca if it does.
+	struct LeafSubroutine {
+		unsigned int returnIndex;
+		bool savesCa;
+		unsigned int caSaveIndex;
+		unsigned int caRestoreIndex;
+	};
+
+	// Return true iff the subroutine starting at start is a small leaf that can be copied anywhere, in which case
+	// leaf is overwritten with where it returns. That means it has to run through to a single jr without calling
+	// anything, jumping anywhere outside of itself, or touching $ca along the way, other than to save it to memory
+	// and load it straight back (isTarget being as found by ProgramEditor::findJumpTargets()).
+	static bool findLeafSubroutine(ProgramEditor &program, unsigned int start, const std::vector<bool> &isTarget,
+		LeafSubroutine &leaf) {
+		const unsigned int caRegister = InstructionFormat::getRegisterId("$ca");
+		std::vector<unsigned int> registers;
+		std::vector<unsigned int> written;
+		bool foundSave = false;
+		bool foundRestore = false;
+		unsigned int end = start;
+		for (; end < program.size() && !InstructionFormat::isIndirectJump(program.getInstruction(end)); end++) {
+			const Instruction &instruction = program.getInstruction(end);
+			if (end - start >= MAX_INLINED_SIZE || InstructionFormat::isCall(instruction)) {
+				return false;
+			}
+			InstructionFormat::getReadRegisters(instruction, registers);
+			InstructionFormat::getWrittenRegisters(instruction, written);
+			registers.insert(registers.end(), written.begin(), written.end());
+			bool touchesCa = false;
+			for (unsigned int registerId : registers) {
+				touchesCa = touchesCa || registerId == caRegister;
+			}
+			if (!touchesCa) {
+				continue;
+			}
+
+			// The only things allowed to touch $ca are a single sw of it, and a single lw of it after that.
+			const bool addressedByCa = InstructionFormat::getReadA(instruction) == caRegister;
+			if (!foundSave && InstructionFormat::is(instruction, "sw") && !addressedByCa) {
+				foundSave = true;
+				leaf.caSaveIndex = end;
+			}
+			else if (foundSave && !foundRestore && InstructionFormat::is(instruction, "lw") && !addressedByCa) {
+				foundRestore = true;
+				leaf.caRestoreIndex = end;
+			}
+			else {
+				return false;
+			}
+		}
+		if (end == program.size() || foundSave != foundRestore) {
+			return false;
+		}
+		// The lw has to load back exactly the word the sw stored, untouched, so that the pair leaves $ca as it was.
+		unsigned int storeIndex = 0;
+		if (foundSave && (!program.findMatchingStore(leaf.caRestoreIndex, isTarget, storeIndex) ||
+			storeIndex != leaf.caSaveIndex)) {
+			return false;
+		}
+
+		// Jumps back to the start or on to the jr are fine, since the copy has both. The saved $ca can't be read back
+		// into anything else, since the copy doesn't save it.
+		const Instruction *save = foundSave ? &program.getInstruction(leaf.caSaveIndex) : nullptr;
+		for (unsigned int i = start; i < end; i++) {
+			if (program.hasTarget(i) && (program.getTarget(i) < start || program.getTarget(i) > end)) {
+				return false;
+			}
+			const Instruction &instruction = program.getInstruction(i);
+			if (save != nullptr && i != leaf.caRestoreIndex && InstructionFormat::is(instruction, "lw") &&
+				InstructionFormat::getReadA(instruction) == InstructionFormat::getReadA(*save) &&
+				InstructionFormat::getOffset(instruction) == InstructionFormat::getOffset(*save)) {
+				return false;
+			}
+		}
+		leaf.returnIndex = end;
+		leaf.savesCa = foundSave;
+		return true;
+	}
+
+	// If copies (a run of straight line code copied out of a subroutine) sets up a stack frame of its own, moving $sp
+	// and $fp and putting them back by the end, rewrite it to address everything from the caller's $sp instead. Every
+	// word is still read and written at the same address, but the $sp adjustments, setting $fp, and saving and
+	// restoring the caller's $fp all go, as does saving and restoring $ca if it was saved in the frame (there's no
+	// return address any more). Nothing is changed if there's anything that can't be followed, e.g. memory accessed
+	// through other registers, which might be where $fp was saved.
+	static void removeFrame(std::vector<CopiedInstruction> &copies) {
+		const unsigned int spRegister = InstructionFormat::getRegisterId("$sp");
+		const unsigned int fpRegister = InstructionFormat::getRegisterId("$fp");
+		// Where $sp and $fp point, relative to where $sp pointed at the start, and where the caller's $fp was saved.
+		int sp = 0;
+		int fp = 0;
+		int fpSlot = 0;
+		bool fpSaved = false;
+		bool fpMoved = false;
+		bool fpRestored = false;
+		std::vector<CopiedInstruction> rewritten;
+		std::vector<unsigned int> registers;
+		std::vector<unsigned int> written;
+		for (const CopiedInstruction &copy : copies) {
+			const Instruction &instruction = copy.instruction;
+			if (copy.hasTarget) {
+				return;
+			}
+			const bool isFrameAdjustment = InstructionFormat::is(instruction, "addi") &&
+				InstructionFormat::getReadA(instruction) == spRegister;
+			if (isFrameAdjustment && InstructionFormat::getDestination(instruction) == spRegister) {
+				sp += InstructionFormat::getImmediate(instruction);
+				continue;
+			}
+			if (isFrameAdjustment && InstructionFormat::getDestination(instruction) == fpRegister && fpSaved &&
+				!fpRestored) {
+				fp = sp + InstructionFormat::getImmediate(instruction);
+				fpMoved = true;
+				continue;
+			}
+
+			const bool isLoad = InstructionFormat::is(instruction, "lw");
+			const bool isStore = InstructionFormat::is(instruction, "sw");
+			if (isLoad || isStore) {
+				const unsigned int baseRegister = InstructionFormat::getReadA(instruction);
+				if (baseRegister != spRegister && (baseRegister != fpRegister || !fpMoved)) {
+					return;
+				}
+				const int address = (baseRegister == spRegister ? sp : fp) + InstructionFormat::getOffset(instruction);
+				if (isStore && InstructionFormat::getReadB(instruction) == fpRegister && !fpSaved) {
+					fpSaved = true;
+					fpSlot = address;
+					continue;
+				}
+				if (isLoad && InstructionFormat::getDestination(instruction) == fpRegister && fpMoved &&
+					address == fpSlot) {
+					fpMoved = false;
+					fpRestored = true;
+					continue;
+				}
+				// Words at or above the caller's $sp are free again once the subroutine returns, so no one else can
+				// be relying on $ca being saved there.
+				if (copy.savesOrRestoresCa && address >= 0) {
+					continue;
+				}
+				const unsigned int dataRegister = isLoad ? InstructionFormat::getDestination(instruction) :
+					InstructionFormat::getReadB(instruction);
+				if (dataRegister == spRegister || dataRegister == fpRegister || (fpSaved && address == fpSlot) ||
+					address < -128 || address > 127) {
+					return;
+				}
+				Instruction moved = isLoad ? InstructionFormat::makeInstruction("lw", dataRegister, spRegister, 0u) :
+					InstructionFormat::makeInstruction("sw", 0u, spRegister, dataRegister);
+				InstructionFormat::setOffset(moved, address);
+				rewritten.push_back({moved, copy.location, false, 0u, copy.savesOrRestoresCa});
+				continue;
+			}
+
+			// Anything else that uses $sp or $fp would see different values.
+			InstructionFormat::getReadRegisters(instruction, registers);
+			InstructionFormat::getWrittenRegisters(instruction, written);
+			registers.insert(registers.end(), written.begin(), written.end());
+			for (unsigned int registerId : registers) {
+				if (registerId == spRegister || registerId == fpRegister) {
+					return;
+				}
+			}
+			rewritten.push_back(copy);
+		}
+
+		// Both have to end up back where they started, and the caller's $fp has to have been saved at or above its $sp,
+		// where no one looks once the subroutine returns, for leaving it unsaved to make no difference.
+		if (sp != 0 || fpMoved || fpSaved != fpRestored || fpSlot < 0 || rewritten.size() == copies.size()) {
+			return;
+		}
+		copies.swap(rewritten);
+	}
+
+	// Replace the call at callIndex with a copy of the subroutine leaf it calls, up to but not including its jr.
+	// Jumps to the jr in the copy go to just after it instead, which is where the call returned to. The copy leaves
+	// out the subroutine's stack frame if removeFrame() can take it out.
+	static void inlineCall(ProgramEditor &program, unsigned int callIndex, const LeafSubroutine &leaf) {
+		// Copy everything out first, since inserting moves the subroutine if it comes after the call.
+		const unsigned int start = program.getTarget(callIndex);
+		std::vector<CopiedInstruction> copies;
+		for (unsigned int i = start; i < leaf.returnIndex; i++) {
+			bool hasTarget = program.hasTarget(i);
+			copies.push_back({program.getInstruction(i), program.getSourceLocation(i), hasTarget,
+				hasTarget ? program.getTarget(i) - start : 0u,
+				leaf.savesCa && (i == leaf.caSaveIndex || i == leaf.caRestoreIndex)});
+		}
+		removeFrame(copies);
+
+		// Inserting the copy before the call's return address keeps anything else returning or jumping there where
+		// it was, and removing the call leaves anything that jumped to it going to the start of the copy instead.
+		for (unsigned int k = 0; k < copies.size(); k++) {
+			program.insert(callIndex + 1 + k, copies[k].instruction, copies[k].location);
+		}
+		program.remove(callIndex);
+		for (unsigned int k = 0; k < copies.size(); k++) {
+			if (copies[k].hasTarget) {
+				program.setTarget(callIndex + k, callIndex + copies[k].targetOffset);
+			}
+		}
+	}
+
+	// Replace calls to small leaf subroutines in program with copies of the subroutine, as long as the program
+	// still fits into instruction memory, and return how many calls were replaced. The subroutines themselves are
+	// left where they are, for anything else that still calls them (or for removing as unreachable code). Nothing
+	// is changed in programs that jump to addresses they worked out themselves.
+	unsigned int inlineSubroutines(ProgramEditor &program) {
+		if (!program.canFollowEveryJump()) {
+			return 0;
+		}
+
+		// Copies never have calls in them, so every call inlined is one fewer left to look at. Every change moves
+		// instructions around, so start over from the top each time.
+		const std::uint32_t caMask = 1u << InstructionFormat::getRegisterId("$ca");
+		unsigned int inlinedCount = 0;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			ControlFlowGraph graph(program);
+			std::vector<std::uint32_t> liveIn;
+			std::vector<std::uint32_t> liveOut;
+			DataflowOptimizer::findLiveRegisters(program, graph, liveIn, liveOut);
+			std::vector<bool> isTarget;
+			program.findJumpTargets(isTarget);
+			for (unsigned int i = 0; i < program.size() && !changed; i++) {
+				if (!InstructionFormat::isCall(program.getInstruction(i)) || !program.hasTarget(i) ||
+					program.getTarget(i) >= program.size()) {
+					continue;
+				}
+				// The copy leaves $ca as it was rather than setting it to the return address, so only calls
+				// after which $ca is never read (e.g. before the caller loads its own return address back) can go.
+				if (i + 1 < program.size() && (liveIn[graph.getBlockIndex(i + 1)] & caMask) != 0u) {
+					continue;
+				}
+				LeafSubroutine leaf = {0u, false, 0u, 0u};
+				if (!findLeafSubroutine(program, program.getTarget(i), isTarget, leaf) ||
+					program.size() - 1u + (leaf.returnIndex - program.getTarget(i)) > INSTRUCTION_MEMORY_SIZE) {
+					continue;
+				}
+				inlineCall(program, i, leaf);
+				inlinedCount++;
+				changed = true;
+			}
+		}
+		return inlinedCount;
+	}
+}
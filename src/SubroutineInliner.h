@@ -0,0 +1,18 @@
+#include "ProgramEditor.h"
+
+#ifndef SUBROUTINE_INLINER_H
+#define SUBROUTINE_INLINER_H
+
+// Contains a pass that copies small leaf subroutines (ones that don't call anything themselves) into the places
+// they're called from. Every call costs a call and a jr on top of the subroutine itself, and the caller usually has
+// to save $ca around it, so small utility subroutines called in hot code are much quicker inlined. Copies leave out
+// the subroutine's own stack frame (including saving and restoring $ca in it) where it can be followed.
+namespace SubroutineInliner {
+	// Replace calls to small leaf subroutines in program with copies of the subroutine, as long as the program
+	// still fits into instruction memory, and return how many calls were replaced. The subroutines themselves are
+	// left where they are, for anything else that still calls them (or for removing as unreachable code). Nothing
+	// is changed in programs that jump to addresses they worked out themselves.
+	unsigned int inlineSubroutines(ProgramEditor &program);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <exception>
+#include "ThreadPool.h"
+
+namespace ThreadPool {
+	// Return the number of worker threads to use when none was asked for, which is the number of hardware threads
+	// on this machine (or one, if that can't be determined).
+	unsigned int defaultThreadCount() {
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		return hardwareThreads == 0u ? 1u : hardwareThreads;
+	}
+
+	// Call task once for every index from zero up to (but not including) count, spread over threadCount worker 
+	// threads. Indices are handed out one at a time as threads become free, so uneven tasks still balance out.
+	// Blocks until every task is done. If any task throws, the first exception thrown is rethrown here once all
+	// of the threads have finished.
+	void parallelFor(unsigned int count, unsigned int threadCount, const std::function<void(unsigned int)> &task) {
+		// Never start more threads than there is work to do, and always have at least one.
+		if (threadCount > count) {
+			threadCount = count;
+		}
+		if (threadCount == 0u) {
+			threadCount = 1u;
+		}
+
+		// Next index that hasn't been handed out to a thread yet.
+		std::atomic<unsigned int> nextIndex(0u);
+		// First exception thrown by any task, which is rethrown once everyone is done.
+		std::exception_ptr firstException;
+		std::mutex exceptionMutex;
+
+		// Each worker keeps grabbing the next index until there are none left.
+		auto worker = [&]() {
+			for (unsigned int i = nextIndex++; i < count; i = nextIndex++) {
+				try {
+					task(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(exceptionMutex);
+					if (!firstException) {
+						firstException = std::current_exception();
+					}
+				}
+			}
+		};
+
+		// The calling thread does its share of the work too, rather than just sitting around waiting.
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < threadCount; i++) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+
+		if (firstException) {
+			std::rethrow_exception(firstException);
+		}
+	}
+}
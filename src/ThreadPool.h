@@ -0,0 +1,20 @@
+#include <functional>
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Contains utility functions for spreading independent pieces of work (e.g. assembling many programs) over all of the
+// cores of the machine.
+namespace ThreadPool {
+	// Return the number of worker threads to use when none was asked for, which is the number of hardware threads
+	// on this machine (or one, if that can't be determined).
+	unsigned int defaultThreadCount();
+
+	// Call task once for every index from zero up to (but not including) count, spread over threadCount worker 
+	// threads. Indices are handed out one at a time as threads become free, so uneven tasks still balance out.
+	// Blocks until every task is done. If any task throws, the first exception thrown is rethrown here once all
+	// of the threads have finished.
+	void parallelFor(unsigned int count, unsigned int threadCount, const std::function<void(unsigned int)> &task);
+};
+
+#endif
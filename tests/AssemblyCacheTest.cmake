@@ -0,0 +1,58 @@
+# Checks that programs with the same source text in different directories, which include different files, never get
+# each other's outputs out of the cache. Run with:
+#   cmake -DSHROOMASM=<shroomasm executable> -DWORK_DIR=<scratch directory> -P AssemblyCacheTest.cmake
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+foreach(variant a b)
+	file(WRITE "${WORK_DIR}/${variant}/p.asm" ";include \"lib.asm\"\nadd $g1 $g0 $g0\n")
+endforeach()
+file(WRITE "${WORK_DIR}/a/lib.asm" "addi $g0 $zero 1\n")
+file(WRITE "${WORK_DIR}/b/lib.asm" "addi $g0 $zero 2\n")
+
+# Assemble a/p.asm first so that its outputs are cached, then b/p.asm, then a/p.asm again, which should still get
+# its own outputs back.
+foreach(variant a b a)
+	execute_process(
+		COMMAND "${SHROOMASM}" "${WORK_DIR}/${variant}/p.asm" -o "${WORK_DIR}/${variant}/p.shroombin"
+			--cache "${WORK_DIR}/cache"
+		RESULT_VARIABLE result
+	)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "shroomasm failed on ${variant}/p.asm.")
+	endif()
+	file(SHA256 "${WORK_DIR}/${variant}/p.shroombin" hash_${variant})
+endforeach()
+
+if(hash_a STREQUAL hash_b)
+	message(FATAL_ERROR "b/p.asm was given the cached output of a/p.asm, which includes a different lib.asm.")
+endif()
+
+# Changing an included file in place must also be noticed.
+file(WRITE "${WORK_DIR}/a/lib.asm" "addi $g0 $zero 2\n")
+execute_process(
+	COMMAND "${SHROOMASM}" "${WORK_DIR}/a/p.asm" -o "${WORK_DIR}/a/p.shroombin" --cache "${WORK_DIR}/cache"
+	RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "shroomasm failed on a/p.asm.")
+endif()
+file(SHA256 "${WORK_DIR}/a/p.shroombin" hash_changed)
+if(hash_changed STREQUAL hash_a)
+	message(FATAL_ERROR "a/p.asm was given a stale cached output after lib.asm changed.")
+endif()
+
+# Asking for a data schematic must assemble the program even when its other outputs are cached, rather than removing
+# the data schematic it asked for.
+file(WRITE "${WORK_DIR}/d/q.asm" ";word 1\nadd $g1 $g0 $g0\n")
+foreach(flag "" --data-schem)
+	execute_process(
+		COMMAND "${SHROOMASM}" -g "${WORK_DIR}/d/q.asm" -o "${WORK_DIR}/d/q.schem" ${flag} --cache "${WORK_DIR}/cache"
+		RESULT_VARIABLE result
+	)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "shroomasm failed on d/q.asm.")
+	endif()
+endforeach()
+if(NOT EXISTS "${WORK_DIR}/d/q.data.schem")
+	message(FATAL_ERROR "The data schematic of d/q.asm was not written when its schematic was cached.")
+endif()
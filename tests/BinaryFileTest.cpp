@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "Assembler.h"
+#include "BinaryFile.h"
+#include "TestCheck.h"
+
+// Program with initial data, labels (including one just past the end) and code from every line of the source.
+static const std::string PROGRAM =
+	";data 4\n"
+	";word 1 2 0xffff\n"
+	":start\n"
+	"addi $g0 $zero 3\n"
+	":loop\n"
+	"addi $g0 $g0 -1\n"
+	"jgt $g0 loop\n"
+	"jmp end\n"
+	":end\n";
+
+// Return the bytes of the file fileName.
+static std::vector<BYTE> readFile(const std::string &fileName) {
+	std::ifstream inFile(fileName, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+	return std::vector<BYTE>(bytes.begin(), bytes.end());
+}
+
+// Return the binary held in bytes.
+static BinaryFile::Binary parse(const std::vector<BYTE> &bytes) {
+	return BinaryFile::parseBinary(bytes.data(), bytes.size(), "test.shroombin");
+}
+
+// Check that binary holds everything assembled holds.
+static void checkMatches(const BinaryFile::Binary &binary, const Assembler::Result &assembled) {
+	CHECK_EQUAL(binary.formatVersion, BINARY_FILE_VERSION);
+	CHECK_EQUAL(binary.machineCode.size(), assembled.machineCode.size());
+	for (unsigned int i = 0; i < binary.machineCode.size() && i < assembled.machineCode.size(); i++) {
+		CHECK_EQUAL(binary.machineCode[i].getBitsInRange(0, INSTRUCTION_SIZE - 1),
+			assembled.machineCode[i].getBitsInRange(0, INSTRUCTION_SIZE - 1));
+	}
+	CHECK(binary.dataImage == assembled.dataImage);
+	CHECK(binary.labels == assembled.labels);
+	CHECK_EQUAL(binary.sourceLocations.size(), assembled.sourceLocations.size());
+	for (unsigned int i = 0; i < binary.sourceLocations.size() && i < assembled.sourceLocations.size(); i++) {
+		CHECK_EQUAL(binary.sourceLocations[i].lineNumber, assembled.sourceLocations[i].lineNumber);
+		CHECK_EQUAL(binary.sourceLocations[i].text, assembled.sourceLocations[i].text);
+		CHECK_EQUAL(binary.sourceLocations[i].fileName, assembled.sourceLocations[i].fileName);
+	}
+}
+
+int main() {
+	Assembler::Result assembled = Assembler::assemble(PROGRAM);
+	CHECK(assembled.succeeded());
+	CHECK_EQUAL(assembled.dataImage.size(), 7u);
+
+	// Everything comes back out of the file the same, whether it's loaded or parsed from bytes already read.
+	const std::string fileName = "BinaryFileTest.shroombin";
+	BinaryFile::saveBinary(BinaryFile::makeBinary(assembled), fileName);
+	checkMatches(BinaryFile::loadBinary(fileName), assembled);
+	const std::vector<BYTE> bytes = readFile(fileName);
+	{
+		// Mapping the file gives exactly the bytes in it.
+		BinaryFile::MappedFile file(fileName);
+		CHECK(std::vector<BYTE>(file.data(), file.data() + file.size()) == bytes);
+	}
+	std::remove(fileName.c_str());
+	CHECK_THROWS(BinaryFile::MappedFile missing(fileName), "Issue opening");
+	checkMatches(parse(bytes), assembled);
+
+	// Changing any byte past the 24 byte header, or cutting the file short, is caught by the checksum.
+	for (std::size_t i = 24u; i < bytes.size(); i++) {
+		std::vector<BYTE> corrupted = bytes;
+		corrupted[i] ^= 0x10u;
+		CHECK_THROWS(parse(corrupted), "is corrupt");
+	}
+	std::vector<BYTE> truncated(bytes.begin(), bytes.end() - 4);
+	CHECK_THROWS(parse(truncated), "is corrupt");
+
+	// Binaries from other versions of the format or instruction set are refused rather than misread.
+	std::vector<BYTE> otherVersion = bytes;
+	otherVersion[4]++;
+	CHECK_THROWS(parse(otherVersion), "different version");
+	std::vector<BYTE> otherRevision = bytes;
+	otherRevision[8]++;
+	CHECK_THROWS(parse(otherRevision), "different revision");
+
+	// Files without the magic number are version 1 binaries, a bare run of instructions.
+	std::vector<BYTE> version1 = {0x0cu, 0x01u, 0x03u, 0x00u};
+	BinaryFile::Binary binary = parse(version1);
+	CHECK_EQUAL(binary.formatVersion, 1u);
+	CHECK_EQUAL(binary.machineCode.size(), 1u);
+	CHECK_EQUAL(binary.machineCode[0].getBitsInRange(0, INSTRUCTION_SIZE - 1), 0x0003010cu);
+	version1.pop_back();
+	CHECK_THROWS(parse(version1), "isn't a shroom16 binary");
+	return TestCheck::finish();
+}
@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <string>
+#include "ConstantExpression.h"
+#include "TestCheck.h"
+
+// Return the value of expression, in which the only name defined is BASE (which is 1).
+static std::int64_t evaluate(const std::string &expression) {
+	return ConstantExpression::evaluate(expression, [](const std::string &name, std::int64_t &value) {
+		value = 1;
+		return name == "BASE";
+	});
+}
+
+int main() {
+	// Values work out the same as they would in C, right up to the ends of the 32 bit range.
+	CHECK_EQUAL(evaluate("(BASE + 4) << 2"), 20);
+	CHECK_EQUAL(evaluate("7/2*2+7%2"), 7);
+	CHECK_EQUAL(evaluate("~0"), -1);
+	CHECK_EQUAL(evaluate("0xffffffff"), 0xffffffff);
+	CHECK_EQUAL(evaluate("-0x80000000"), -(std::int64_t)0x80000000);
+	CHECK_EQUAL(evaluate("1<<31"), (std::int64_t)1 << 31);
+	CHECK_EQUAL(evaluate("0xffffffff>>31"), 1);
+
+	// Anything that doesn't fit in 32 bits along the way is an error, even if it would fit again by the end.
+	CHECK_THROWS(evaluate("0xffffffff+1"), "doesn't fit in 32 bits");
+	CHECK_THROWS(evaluate("0x100000000"), "doesn't fit in 32 bits");
+	CHECK_THROWS(evaluate("-0x80000000-1"), "doesn't fit in 32 bits");
+	CHECK_THROWS(evaluate("0x10000*0x10000"), "doesn't fit in 32 bits");
+	CHECK_THROWS(evaluate("0x10000*0x10000/2"), "doesn't fit in 32 bits");
+	CHECK_THROWS(evaluate("0x80000000<<1"), "doesn't fit in 32 bits");
+	CHECK_THROWS(evaluate("99999999999999999999999"), "doesn't fit in 32 bits");
+
+	// Dividing by zero, however it's written.
+	CHECK_THROWS(evaluate("5/0"), "Division by zero");
+	CHECK_THROWS(evaluate("5%0"), "Division by zero");
+	CHECK_THROWS(evaluate("5/(BASE-1)"), "Division by zero");
+
+	// Shifting by a negative amount or by the whole width or more.
+	CHECK_THROWS(evaluate("1<<32"), "Shift amount out of range");
+	CHECK_THROWS(evaluate("1>>32"), "Shift amount out of range");
+	CHECK_THROWS(evaluate("1<<(BASE-2)"), "Shift amount out of range");
+	CHECK_THROWS(evaluate("1>>-1"), "Shift amount out of range");
+
+	// Names that aren't defined, and things that aren't expressions at all.
+	CHECK_THROWS(evaluate("BASE+TOP"), "Undefined constant TOP");
+	CHECK_THROWS(evaluate("(1+2"), "Missing )");
+	CHECK_THROWS(evaluate("1+"), "Invalid expression");
+	CHECK_THROWS(evaluate("0x1g"), "Invalid number");
+	return TestCheck::finish();
+}
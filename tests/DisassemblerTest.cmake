@@ -0,0 +1,55 @@
+# Checks that disassembling a program with shroomdis and assembling the result with shroomasm gives back exactly the
+# same program, for every example and for a program with initial data and labels. Run with:
+#   cmake -DSHROOMASM=<shroomasm executable> -DSHROOMDIS=<shroomdis executable> -DEXAMPLES_DIR=<examples directory>
+#     -DWORK_DIR=<scratch directory> -P DisassemblerTest.cmake
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+file(WRITE "${WORK_DIR}/DataTest.asm"
+	";data 4\n;word 1 2 0xffff\n:start\naddi $g0 $zero 3\n:loop\naddi $g0 $g0 -1\njgt $g0 loop\njmp end\n:end\n")
+file(GLOB programs "${EXAMPLES_DIR}/*.asm")
+list(APPEND programs "${WORK_DIR}/DataTest.asm")
+
+# Run the command given as arguments, failing the test if it fails.
+function(run)
+	execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "Failed to run ${ARGN}.")
+	endif()
+endfunction()
+
+# Set variable to the lines of the disassembly in the file disassemblyFile, besides the first (which names the file it
+# was disassembled from).
+function(read_disassembly disassemblyFile variable)
+	file(STRINGS "${disassemblyFile}" lines)
+	list(REMOVE_AT lines 0)
+	set(${variable} "${lines}" PARENT_SCOPE)
+endfunction()
+
+foreach(program ${programs})
+	get_filename_component(name "${program}" NAME_WE)
+	set(base "${WORK_DIR}/${name}")
+
+	# Binaries keep the data and labels, so the disassembly of the reassembled binary must match the original's.
+	run("${SHROOMASM}" "${program}" -o "${base}.shroombin")
+	run("${SHROOMDIS}" "${base}.shroombin" -o "${base}.dis.asm")
+	run("${SHROOMASM}" "${base}.dis.asm" -o "${base}.re.shroombin")
+	run("${SHROOMDIS}" "${base}.re.shroombin" -o "${base}.re.dis.asm")
+	read_disassembly("${base}.dis.asm" original)
+	read_disassembly("${base}.re.dis.asm" reassembled)
+	if(NOT original STREQUAL reassembled)
+		message(FATAL_ERROR "${name} changed when disassembled and assembled again.")
+	endif()
+
+	# Schematics only hold the code, which must come back torch for torch.
+	if(NOT name STREQUAL "DataTest")
+		run("${SHROOMASM}" "${program}" -g -o "${base}.schem")
+		run("${SHROOMDIS}" "${base}.schem" -o "${base}.schem.asm")
+		run("${SHROOMASM}" "${base}.schem.asm" -g -o "${base}.re.schem")
+		file(SHA256 "${base}.schem" originalHash)
+		file(SHA256 "${base}.re.schem" reassembledHash)
+		if(NOT originalHash STREQUAL reassembledHash)
+			message(FATAL_ERROR "${name}.schem changed when disassembled and assembled again.")
+		endif()
+	endif()
+endforeach()
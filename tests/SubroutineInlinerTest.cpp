@@ -0,0 +1,113 @@
+#include <string>
+#include "Assembler.h"
+#include "InstructionFormat.h"
+#include "ProgramEditor.h"
+#include "SubroutineInliner.h"
+#include "TestCheck.h"
+
+// Leaf subroutine in the style of examples/FibTest.asm, which sets up a stack frame and saves $ca (and $g1) in it,
+// squaring the argument passed in right below the top of the stack in place.
+static const std::string SQUARE_SUBROUTINE =
+	"jmp main\n"
+	":square\n"
+	"addi $sp $sp 1\n"
+	"sw $fp $sp -1\n"
+	"addi $fp $sp 0\n"
+	"addi $sp $sp 2\n"
+	"sw $ca $fp 0\n"
+	"sw $g1 $fp 1\n"
+	"lw $g0 $fp -2\n"
+	"mul $g1 $g0 $g0\n"
+	"sw $g1 $fp -2\n"
+	"%s"
+	"lw $g1 $fp 1\n"
+	"lw $ca $fp 0\n"
+	"addi $sp $sp -2\n"
+	"lw $fp $sp -1\n"
+	"addi $sp $sp -1\n"
+	"jr $ca\n"
+	":main\n"
+	"addi $g0 $zero 7\n"
+	"addi $sp $sp 1\n"
+	"sw $g0 $sp -1\n"
+	"call square\n"
+	"lw $g0 $sp -1\n"
+	"addi $sp $sp -1\n"
+	"?out $g0\n";
+
+// Return source assembled and passed through the inliner, written out as one instruction per line starting from
+// main, and set inlinedCount to how many calls were inlined.
+static std::string inlineProgram(const std::string &source, unsigned int &inlinedCount) {
+	Assembler::Result result = Assembler::assemble(source);
+	CHECK(result.succeeded());
+	const unsigned int mainIndex = result.labels.at("main");
+	ProgramEditor editor(result);
+	inlinedCount = SubroutineInliner::inlineSubroutines(editor);
+	editor.writeTo(result);
+
+	std::string text;
+	for (unsigned int i = mainIndex; i < result.machineCode.size(); i++) {
+		text += InstructionFormat::disassemble(result.machineCode[i], "") + "\n";
+	}
+	return text;
+}
+
+// Return the square subroutine with extra inserted in its body, passed through inlineProgram().
+static std::string inlineSquare(const std::string &extra, unsigned int &inlinedCount) {
+	std::string source = SQUARE_SUBROUTINE;
+	source.replace(source.find("%s"), 2, extra);
+	return inlineProgram(source, inlinedCount);
+}
+
+int main() {
+	// The call goes, and with it saving $ca and the frame, with everything addressed from the caller's $sp instead.
+	unsigned int inlinedCount = 0;
+	std::string inlined = inlineSquare("", inlinedCount);
+	CHECK_EQUAL(inlinedCount, 1u);
+	CHECK_EQUAL(inlined,
+		"addi $g0 $zero 7\n"
+		"addi $sp $sp 1\n"
+		"sw $g0 $sp -1\n"
+		"sw $g1 $sp 2\n"
+		"lw $g0 $sp -1\n"
+		"mul $g1 $g0 $g0\n"
+		"sw $g1 $sp -1\n"
+		"lw $g1 $sp 2\n"
+		"lw $g0 $sp -1\n"
+		"addi $sp $sp -1\n"
+		"?out $g0\n");
+
+	// Subroutines that change where they return to can't be copied, since the copy would carry on after the call.
+	inlined = inlineSquare("sw $g1 $fp 0\n", inlinedCount);
+	CHECK_EQUAL(inlinedCount, 0u);
+	// Nor can ones that read their return address into anything else.
+	inlined = inlineSquare("lw $g2 $fp 0\n", inlinedCount);
+	CHECK_EQUAL(inlinedCount, 0u);
+
+	// Frames that can't be followed (here, $fp read as a value) stay, along with saving $ca in them.
+	inlined = inlineSquare("add $g2 $fp $zero\n", inlinedCount);
+	CHECK_EQUAL(inlinedCount, 1u);
+	CHECK(inlined.find("sw $ca $fp 0") != std::string::npos);
+	CHECK(inlined.find("sw $fp $sp -1") != std::string::npos);
+
+	// $ca saved somewhere other than the stack frame might be read after the call, so it's still saved there.
+	inlined = inlineProgram(
+		"jmp main\n"
+		":get\n"
+		"sw $ca $zero 5\n"
+		"addi $g0 $zero 9\n"
+		"lw $ca $zero 5\n"
+		"jr $ca\n"
+		":main\n"
+		"call get\n"
+		"lw $g1 $zero 5\n"
+		"?out $g1\n", inlinedCount);
+	CHECK_EQUAL(inlinedCount, 1u);
+	CHECK_EQUAL(inlined,
+		"sw $ca $zero 5\n"
+		"addi $g0 $zero 9\n"
+		"lw $ca $zero 5\n"
+		"lw $g1 $zero 5\n"
+		"?out $g1\n");
+	return TestCheck::finish();
+}
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+// Contains the checks used by the regression tests, each of which is a plain executable run by ctest. A failed check
+// prints where it was and what went wrong, and makes the test exit with a failure once everything has been checked.
+namespace TestCheck {
+	// Return the number of checks that have failed so far.
+	inline int &getFailureCount() {
+		static int failureCount = 0;
+		return failureCount;
+	}
+
+	// Record a failed check at the given line, with a description of what went wrong.
+	inline void fail(int line, const std::string &description) {
+		std::cerr << "Check failed on line " << line << ": " << description << std::endl;
+		getFailureCount()++;
+	}
+
+	// Return what the test should exit with, given every check made.
+	inline int finish() {
+		return getFailureCount() == 0 ? 0 : 1;
+	}
+};
+
+// Check that condition holds.
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			TestCheck::fail(__LINE__, #condition); \
+		} \
+	} while (false)
+
+// Check that actual (printable with <<) equals expected.
+#define CHECK_EQUAL(actual, expected) \
+	do { \
+		if (!((actual) == (expected))) { \
+			std::cerr << "Expected: " << (expected) << "\nActual: " << (actual) << std::endl; \
+			TestCheck::fail(__LINE__, #actual " == " #expected); \
+		} \
+	} while (false)
+
+// Check that statement throws an exception whose message contains the text message.
+#define CHECK_THROWS(statement, message) \
+	do { \
+		try { \
+			statement; \
+			TestCheck::fail(__LINE__, #statement " throws"); \
+		} \
+		catch (const std::exception &exception) { \
+			if (std::string(exception.what()).find(message) == std::string::npos) { \
+				TestCheck::fail(__LINE__, std::string(#statement " throws \"") + message + "\", not \"" + \
+					exception.what() + "\""); \
+			} \
+		} \
+	} while (false)
+
+#endif